@@ -0,0 +1,90 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "EmulatedDevice.h"
+
+EmulatedDevice::EmulatedDevice(uint32_t uid, uint16_t deviceIdentifier, uint32_t connectedUid, char position,
+                               Version hardwareVersion, Version firmwareVersion)
+    : m_uid(uid), m_deviceIdentifier(deviceIdentifier), m_connectedUid(connectedUid), m_position(position),
+      m_hardwareVersion(hardwareVersion), m_firmwareVersion(firmwareVersion)
+{
+}
+
+void EmulatedDevice::writeEnumerate(std::vector<uint8_t>& buffer, uint8_t enumerationType) const
+{
+    protocol::PacketWriter packet(buffer, m_uid, protocol::CALLBACK_ENUMERATE);
+    writeIdentity(packet);
+    packet.writeUint8(enumerationType);
+}
+
+void EmulatedDevice::handleRequest(const protocol::Header& header, const uint8_t *payload,
+                                   std::vector<uint8_t>& buffer, Clock::time_point now)
+{
+    const size_t start = buffer.size();
+    const size_t length = header.length - protocol::HEADER_SIZE;
+    uint8_t errorCode;
+
+    {
+        protocol::PacketWriter response(buffer, m_uid, header.functionId, header.sequenceNumber, header.responseExpected);
+
+        if (header.functionId == protocol::FUNCTION_GET_IDENTITY)
+        {
+            writeIdentity(response);
+            errorCode = protocol::ERROR_CODE_OK;
+        }
+        else
+        {
+            errorCode = handleFunction(header.functionId, payload, length, response, now);
+        }
+    }
+
+    if (!header.responseExpected)
+    {
+        buffer.resize(start);
+    }
+    else if (errorCode != protocol::ERROR_CODE_OK)
+    {
+        buffer.resize(start);
+        protocol::PacketWriter(buffer, m_uid, header.functionId, header.sequenceNumber, true, errorCode);
+    }
+}
+
+void EmulatedDevice::poll(Clock::time_point, std::vector<uint8_t>&)
+{
+}
+
+EmulatedDevice::Clock::time_point EmulatedDevice::nextDue() const
+{
+    return Clock::time_point::max();
+}
+
+uint8_t EmulatedDevice::handleFunction(uint8_t, const uint8_t *, size_t, protocol::PacketWriter&, Clock::time_point)
+{
+    return protocol::ERROR_CODE_FUNCTION_NOT_SUPPORTED;
+}
+
+void EmulatedDevice::writeIdentity(protocol::PacketWriter& packet) const
+{
+    packet.writeString(protocol::base58Encode(m_uid), 8);
+    packet.writeString(m_connectedUid != 0 ? protocol::base58Encode(m_connectedUid) : "0", 8);
+    packet.writeChar(m_position);
+    packet.writeBytes(m_hardwareVersion.data(), m_hardwareVersion.size());
+    packet.writeBytes(m_firmwareVersion.data(), m_firmwareVersion.size());
+    packet.writeUint16(m_deviceIdentifier);
+}
@@ -0,0 +1,78 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EMULATEDDEVICE_H
+#define EMULATEDDEVICE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "Protocol.h"
+
+/**
+ * Base class of all simulated bricks and bricklets. It answers the identity
+ * request and the enumeration; derived classes add their own functions and
+ * callbacks.
+ */
+class EmulatedDevice
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Version = std::array<uint8_t, 3>;
+
+    EmulatedDevice(uint32_t uid, uint16_t deviceIdentifier, uint32_t connectedUid, char position,
+                   Version hardwareVersion = {{1, 0, 0}}, Version firmwareVersion = {{2, 0, 0}});
+    virtual ~EmulatedDevice() = default;
+
+    uint32_t uid() const { return m_uid; }
+    uint16_t deviceIdentifier() const { return m_deviceIdentifier; }
+
+    void writeEnumerate(std::vector<uint8_t>& buffer, uint8_t enumerationType) const;
+
+    // Handles a request addressed to this device. The response is appended
+    // to the buffer if the request asks for one.
+    void handleRequest(const protocol::Header& header, const uint8_t *payload,
+                       std::vector<uint8_t>& buffer, Clock::time_point now);
+
+    // Appends all callbacks that are due at the given time to the buffer.
+    virtual void poll(Clock::time_point now, std::vector<uint8_t>& buffer);
+
+    // Time at which poll() has to be called next, Clock::time_point::max() if
+    // the device has no active callbacks.
+    virtual Clock::time_point nextDue() const;
+
+protected:
+    // Returns an error code. The response payload is only used on success.
+    virtual uint8_t handleFunction(uint8_t functionId, const uint8_t *payload, size_t length,
+                                   protocol::PacketWriter& response, Clock::time_point now);
+
+private:
+    void writeIdentity(protocol::PacketWriter& packet) const;
+
+    uint32_t m_uid;
+    uint16_t m_deviceIdentifier;
+    uint32_t m_connectedUid;
+    char     m_position;
+    Version  m_hardwareVersion;
+    Version  m_firmwareVersion;
+};
+
+#endif // EMULATEDDEVICE_H
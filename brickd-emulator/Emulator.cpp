@@ -0,0 +1,501 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Emulator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+
+constexpr int    MAX_EVENTS   = 64;
+constexpr size_t READ_SIZE    = 64 * 1024;
+
+// Reserved epoll tokens, client sockets use their descriptor as token.
+constexpr uint64_t TOKEN_SERVER = UINT64_MAX;
+constexpr uint64_t TOKEN_STOP   = UINT64_MAX - 1;
+
+std::shared_ptr<spdlog::logger> logger()
+{
+    return spdlog::get("main");
+}
+
+} // namespace
+
+Emulator::Emulator(const Configuration& configuration, std::vector<std::unique_ptr<EmulatedDevice>> devices)
+    : m_configuration(configuration), m_devices(std::move(devices))
+{
+    for (const auto& device : m_devices)
+    {
+        m_devicesByUid[device->uid()] = device.get();
+    }
+
+    m_stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+Emulator::~Emulator()
+{
+    for (const auto& client : m_clients)
+    {
+        close(client.first);
+    }
+
+    if (m_server >= 0)
+    {
+        close(m_server);
+    }
+
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+    }
+
+    if (m_stopEvent >= 0)
+    {
+        close(m_stopEvent);
+    }
+}
+
+bool Emulator::run()
+{
+    if (!listen())
+    {
+        return false;
+    }
+
+    for (const auto& device : m_devices)
+    {
+        schedule(*device);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    m_running = true;
+
+    while (m_running)
+    {
+        const int count = epoll_wait(m_epoll, events, MAX_EVENTS, pollTimeout(Clock::now()));
+        if (count < 0 && errno != EINTR)
+        {
+            if (logger())
+            {
+                logger()->error("Waiting for events failed: {}", strerror(errno));
+            }
+            return false;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            const uint64_t token = events[i].data.u64;
+
+            if (token == TOKEN_STOP)
+            {
+                m_running = false;
+            }
+            else if (token == TOKEN_SERVER)
+            {
+                accept();
+            }
+            else
+            {
+                const int socket = int(token);
+                auto client = m_clients.find(socket);
+                if (client == m_clients.end())
+                {
+                    continue;
+                }
+
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    disconnect(socket);
+                    continue;
+                }
+
+                if (events[i].events & EPOLLOUT)
+                {
+                    flush(client->second);
+                }
+
+                // flush() may have disconnected the client.
+                client = m_clients.find(socket);
+                if (client != m_clients.end() && (events[i].events & EPOLLIN))
+                {
+                    receive(client->second);
+                }
+            }
+        }
+
+        dispatchCallbacks(Clock::now());
+    }
+
+    return true;
+}
+
+void Emulator::stop()
+{
+    m_running = false;
+
+    const uint64_t value = 1;
+    if (write(m_stopEvent, &value, sizeof(value)) < 0)
+    {
+        // The event counter can only overflow if stop() is called 2^64 times.
+    }
+}
+
+bool Emulator::listen()
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_server = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (m_epoll < 0 || m_server < 0 || m_stopEvent < 0)
+    {
+        if (logger())
+        {
+            logger()->error("Could not create the server socket: {}", strerror(errno));
+        }
+        return false;
+    }
+
+    const int enable = 1;
+    setsockopt(m_server, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_configuration.port);
+
+    if (inet_pton(AF_INET, m_configuration.address.c_str(), &address.sin_addr) != 1)
+    {
+        if (logger())
+        {
+            logger()->error("Invalid listen address '{}'", m_configuration.address);
+        }
+        return false;
+    }
+
+    if (bind(m_server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::listen(m_server, SOMAXCONN) < 0)
+    {
+        if (logger())
+        {
+            logger()->error("Could not listen on {}:{}: {}", m_configuration.address, m_configuration.port, strerror(errno));
+        }
+        return false;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = TOKEN_SERVER;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_server, &event);
+
+    event.data.u64 = TOKEN_STOP;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_stopEvent, &event);
+
+    if (logger())
+    {
+        logger()->info("Emulating {} devices on {}:{}", m_devices.size(), m_configuration.address, m_configuration.port);
+    }
+
+    return true;
+}
+
+void Emulator::accept()
+{
+    for (;;)
+    {
+        sockaddr_in address;
+        socklen_t addressLength = sizeof(address);
+        const int socket = accept4(m_server, reinterpret_cast<sockaddr *>(&address), &addressLength,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0)
+        {
+            return;
+        }
+
+        const int enable = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = uint64_t(socket);
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, socket, &event);
+
+        char name[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &address.sin_addr, name, sizeof(name));
+
+        Client& client = m_clients[socket];
+        client.socket = socket;
+        client.address = std::string(name) + ":" + std::to_string(ntohs(address.sin_port));
+
+        if (logger())
+        {
+            logger()->info("Client {} connected", client.address);
+        }
+    }
+}
+
+void Emulator::receive(Client& client)
+{
+    const int socket = client.socket;
+    const Clock::time_point now = Clock::now();
+
+    for (;;)
+    {
+        const size_t used = client.input.size();
+        client.input.resize(used + READ_SIZE);
+
+        const ssize_t length = recv(socket, client.input.data() + used, READ_SIZE, 0);
+        client.input.resize(used + size_t(std::max<ssize_t>(length, 0)));
+
+        if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            disconnect(socket);
+            return;
+        }
+
+        if (length < 0)
+        {
+            break;
+        }
+    }
+
+    size_t offset = 0;
+    while (client.input.size() - offset >= protocol::HEADER_SIZE)
+    {
+        const uint8_t length = client.input[offset + 4];
+        if (length < protocol::HEADER_SIZE || length > protocol::MAX_PACKET_SIZE)
+        {
+            if (logger())
+            {
+                logger()->warn("Client {} sent a packet with invalid length {}, disconnecting", client.address, length);
+            }
+            disconnect(socket);
+            return;
+        }
+
+        if (client.input.size() - offset < length)
+        {
+            break;
+        }
+
+        handlePacket(client, client.input.data() + offset, now);
+        offset += length;
+    }
+
+    client.input.erase(client.input.begin(), client.input.begin() + offset);
+    flush(client);
+}
+
+void Emulator::handlePacket(Client& client, const uint8_t *packet, Clock::time_point now)
+{
+    const protocol::Header header = protocol::parseHeader(packet);
+
+    if (header.uid == 0)
+    {
+        // Broadcasts: the enumeration is answered to the requesting client
+        // only, the disconnect probe and everything else is ignored.
+        if (header.functionId == protocol::FUNCTION_ENUMERATE)
+        {
+            for (const auto& device : m_devices)
+            {
+                device->writeEnumerate(client.output, protocol::ENUMERATION_TYPE_AVAILABLE);
+            }
+        }
+        return;
+    }
+
+    auto device = m_devicesByUid.find(header.uid);
+    if (device == m_devicesByUid.end())
+    {
+        // brickd can't route the request, so the client runs into its timeout.
+        return;
+    }
+
+    device->second->handleRequest(header, packet + protocol::HEADER_SIZE, client.output, now);
+    schedule(*device->second);
+}
+
+void Emulator::flush(Client& client)
+{
+    while (client.outputOffset < client.output.size())
+    {
+        const ssize_t length = send(client.socket, client.output.data() + client.outputOffset,
+                                    client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+        if (length < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                disconnect(client.socket);
+                return;
+            }
+
+            break;
+        }
+
+        client.outputOffset += size_t(length);
+    }
+
+    if (client.outputOffset == client.output.size())
+    {
+        client.output.clear();
+        client.outputOffset = 0;
+    }
+    else if (client.outputOffset > client.output.size() / 2)
+    {
+        client.output.erase(client.output.begin(), client.output.begin() + client.outputOffset);
+        client.outputOffset = 0;
+    }
+
+    const bool waitsForWrite = !client.output.empty();
+    if (waitsForWrite != client.waitsForWrite)
+    {
+        epoll_event event;
+        event.events = waitsForWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.u64 = uint64_t(client.socket);
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, client.socket, &event);
+        client.waitsForWrite = waitsForWrite;
+    }
+}
+
+void Emulator::disconnect(int socket)
+{
+    auto client = m_clients.find(socket);
+    if (client == m_clients.end())
+    {
+        return;
+    }
+
+    if (logger())
+    {
+        if (client->second.droppedBytes > 0)
+        {
+            logger()->info("Client {} disconnected, {} bytes of callbacks were dropped because it didn't keep up",
+                           client->second.address, client->second.droppedBytes);
+        }
+        else
+        {
+            logger()->info("Client {} disconnected", client->second.address);
+        }
+    }
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, nullptr);
+    close(socket);
+    m_clients.erase(client);
+}
+
+void Emulator::schedule(EmulatedDevice& device)
+{
+    // Every device has at most one valid timer, the one matching its entry in
+    // m_scheduled. Entries that were superseded are skipped when they expire.
+    const Clock::time_point due = device.nextDue();
+    Clock::time_point& scheduled = m_scheduled[&device];
+
+    if (due != scheduled)
+    {
+        scheduled = due;
+        if (due != Clock::time_point::max())
+        {
+            m_timers.push({due, &device});
+        }
+    }
+}
+
+void Emulator::dispatchCallbacks(Clock::time_point now)
+{
+    m_callbacks.clear();
+
+    while (!m_timers.empty() && m_timers.top().due <= now)
+    {
+        const Timer timer = m_timers.top();
+        m_timers.pop();
+
+        Clock::time_point& scheduled = m_scheduled[timer.device];
+        if (scheduled != timer.due)
+        {
+            continue;
+        }
+
+        timer.device->poll(now, m_callbacks);
+        scheduled = Clock::time_point::max();
+        schedule(*timer.device);
+    }
+
+    if (m_callbacks.empty())
+    {
+        return;
+    }
+
+    std::vector<int> sockets;
+    for (auto& client : m_clients)
+    {
+        // Like brickd, callbacks are dropped for clients that don't read them
+        // fast enough, instead of buffering without bound.
+        if (client.second.output.size() - client.second.outputOffset + m_callbacks.size() > m_configuration.maxClientQueue)
+        {
+            client.second.droppedBytes += m_callbacks.size();
+            continue;
+        }
+
+        client.second.output.insert(client.second.output.end(), m_callbacks.begin(), m_callbacks.end());
+        sockets.push_back(client.first);
+    }
+
+    // flush() may disconnect a client, which invalidates the iteration above.
+    for (int socket : sockets)
+    {
+        auto client = m_clients.find(socket);
+        if (client != m_clients.end())
+        {
+            flush(client->second);
+        }
+    }
+}
+
+int Emulator::pollTimeout(Clock::time_point now) const
+{
+    if (m_timers.empty())
+    {
+        return -1;
+    }
+
+    const auto due = m_timers.top().due;
+    if (due <= now)
+    {
+        return 0;
+    }
+
+    // Round up, so that a timer isn't polled a fraction of a millisecond early.
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(due - now + std::chrono::microseconds(999)).count());
+}
@@ -0,0 +1,104 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EmulatedDevice.h"
+
+/**
+ * Single threaded TCP server speaking the brick daemon protocol for a set of
+ * simulated devices. Requests are answered to the requesting client only,
+ * callbacks are sent to all connected clients like brickd does.
+ */
+class Emulator
+{
+public:
+    struct Configuration {
+        std::string address        {"0.0.0.0"};
+        uint16_t    port           {4223};
+        size_t      maxClientQueue {4 * 1024 * 1024};
+    };
+
+    Emulator(const Configuration& configuration, std::vector<std::unique_ptr<EmulatedDevice>> devices);
+    ~Emulator();
+
+    Emulator(const Emulator&) = delete;
+    Emulator& operator=(const Emulator&) = delete;
+
+    // Serves clients until stop() is called. Returns false if the server
+    // socket could not be set up.
+    bool run();
+
+    // Can be called from any thread and from signal handlers.
+    void stop();
+
+private:
+    using Clock = EmulatedDevice::Clock;
+
+    struct Client {
+        int                  socket;
+        std::string          address;
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> output;
+        size_t               outputOffset  {0};
+        bool                 waitsForWrite {false};
+        uint64_t             droppedBytes  {0};
+    };
+
+    struct Timer {
+        Clock::time_point due;
+        EmulatedDevice   *device;
+
+        bool operator>(const Timer& other) const { return due > other.due; }
+    };
+
+    bool listen();
+    void accept();
+    void receive(Client& client);
+    void handlePacket(Client& client, const uint8_t *packet, Clock::time_point now);
+    void flush(Client& client);
+    void disconnect(int socket);
+    void schedule(EmulatedDevice& device);
+    void dispatchCallbacks(Clock::time_point now);
+    int pollTimeout(Clock::time_point now) const;
+
+    Configuration                                                  m_configuration;
+    std::vector<std::unique_ptr<EmulatedDevice>>                   m_devices;
+    std::unordered_map<uint32_t, EmulatedDevice *>                 m_devicesByUid;
+    std::unordered_map<int, Client>                                m_clients;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+    std::unordered_map<EmulatedDevice *, Clock::time_point>        m_scheduled;
+    std::vector<uint8_t>                                           m_callbacks;
+
+    int                                                            m_epoll    {-1};
+    int                                                            m_server   {-1};
+    int                                                            m_stopEvent {-1};
+    std::atomic<bool>                                              m_running  {false};
+};
+
+#endif // EMULATOR_H
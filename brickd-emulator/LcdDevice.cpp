@@ -0,0 +1,227 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LcdDevice.h"
+
+#include <algorithm>
+
+namespace {
+
+enum Function : uint8_t {
+    WRITE_LINE                 = 1,
+    CLEAR_DISPLAY              = 2,
+    BACKLIGHT_ON               = 3,
+    BACKLIGHT_OFF              = 4,
+    IS_BACKLIGHT_ON            = 5,
+    SET_CONFIG                 = 6,
+    GET_CONFIG                 = 7,
+    IS_BUTTON_PRESSED          = 8,
+    CALLBACK_BUTTON_PRESSED    = 9,
+    CALLBACK_BUTTON_RELEASED   = 10,
+    SET_CUSTOM_CHARACTER       = 11,
+    GET_CUSTOM_CHARACTER       = 12,
+    SET_DEFAULT_TEXT           = 13,
+    GET_DEFAULT_TEXT           = 14,
+    SET_DEFAULT_TEXT_COUNTER   = 15,
+    GET_DEFAULT_TEXT_COUNTER   = 16
+};
+
+constexpr std::chrono::milliseconds BUTTON_HOLD {100};
+
+} // namespace
+
+constexpr uint16_t LcdDevice::DEVICE_IDENTIFIER;
+constexpr size_t LcdDevice::LINES;
+constexpr size_t LcdDevice::COLUMNS;
+constexpr size_t LcdDevice::BUTTONS;
+
+LcdDevice::LcdDevice(uint32_t uid, uint32_t connectedUid, char position,
+                     std::chrono::milliseconds buttonInterval, uint32_t seed)
+    : EmulatedDevice(uid, DEVICE_IDENTIFIER, connectedUid, position, {{1, 2, 0}}, {{2, 0, 6}}),
+      m_buttonInterval(buttonInterval), m_random(seed)
+{
+    for (auto& line : m_text)
+    {
+        line.fill(' ');
+    }
+
+    for (auto& line : m_defaultText)
+    {
+        line.fill(' ');
+    }
+
+    for (auto& character : m_customCharacters)
+    {
+        character.fill(0);
+    }
+
+    m_pressed.fill(false);
+
+    if (m_buttonInterval.count() > 0)
+    {
+        m_pressDue = nextPress(Clock::now());
+    }
+}
+
+void LcdDevice::poll(Clock::time_point now, std::vector<uint8_t>& buffer)
+{
+    if (m_releaseDue <= now)
+    {
+        protocol::PacketWriter packet(buffer, uid(), CALLBACK_BUTTON_RELEASED);
+        packet.writeUint8(m_pressedButton);
+        m_pressed[m_pressedButton] = false;
+        m_releaseDue = Clock::time_point::max();
+    }
+
+    if (m_pressDue <= now && m_releaseDue == Clock::time_point::max())
+    {
+        m_pressedButton = uint8_t(m_random() % BUTTONS);
+        protocol::PacketWriter packet(buffer, uid(), CALLBACK_BUTTON_PRESSED);
+        packet.writeUint8(m_pressedButton);
+        m_pressed[m_pressedButton] = true;
+        m_releaseDue = now + BUTTON_HOLD;
+        m_pressDue = nextPress(now);
+    }
+}
+
+EmulatedDevice::Clock::time_point LcdDevice::nextDue() const
+{
+    // A press that falls due while a button is held waits for the release.
+    return m_releaseDue != Clock::time_point::max() ? m_releaseDue : m_pressDue;
+}
+
+uint8_t LcdDevice::handleFunction(uint8_t functionId, const uint8_t *payload, size_t length,
+                                  protocol::PacketWriter& response, Clock::time_point)
+{
+    switch (functionId)
+    {
+    case WRITE_LINE:
+        if (length < 2 + COLUMNS || payload[0] >= LINES || payload[1] >= COLUMNS)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        for (size_t i = 0; payload[1] + i < COLUMNS && payload[2 + i] != '\0'; ++i)
+        {
+            m_text[payload[0]][payload[1] + i] = char(payload[2 + i]);
+        }
+        break;
+
+    case CLEAR_DISPLAY:
+        for (auto& line : m_text)
+        {
+            line.fill(' ');
+        }
+        break;
+
+    case BACKLIGHT_ON:
+    case BACKLIGHT_OFF:
+        m_backlight = functionId == BACKLIGHT_ON;
+        break;
+
+    case IS_BACKLIGHT_ON:
+        response.writeBool(m_backlight);
+        break;
+
+    case SET_CONFIG:
+        if (length < 2)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        m_cursor = payload[0] != 0;
+        m_blinking = payload[1] != 0;
+        break;
+
+    case GET_CONFIG:
+        response.writeBool(m_cursor);
+        response.writeBool(m_blinking);
+        break;
+
+    case IS_BUTTON_PRESSED:
+        if (length < 1 || payload[0] >= BUTTONS)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        response.writeBool(m_pressed[payload[0]]);
+        break;
+
+    case SET_CUSTOM_CHARACTER:
+        if (length < 9 || payload[0] >= m_customCharacters.size())
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        std::copy(payload + 1, payload + 9, m_customCharacters[payload[0]].begin());
+        break;
+
+    case GET_CUSTOM_CHARACTER:
+        if (length < 1 || payload[0] >= m_customCharacters.size())
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        response.writeBytes(m_customCharacters[payload[0]].data(), m_customCharacters[payload[0]].size());
+        break;
+
+    case SET_DEFAULT_TEXT:
+        if (length < 1 + COLUMNS || payload[0] >= LINES)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        std::copy(payload + 1, payload + 1 + COLUMNS, m_defaultText[payload[0]].begin());
+        break;
+
+    case GET_DEFAULT_TEXT:
+        if (length < 1 || payload[0] >= LINES)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        response.writeString(std::string(m_defaultText[payload[0]].data(), COLUMNS), COLUMNS);
+        break;
+
+    case SET_DEFAULT_TEXT_COUNTER:
+        if (length < 4)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        m_defaultTextCounter = int32_t(protocol::readUint32(payload));
+        break;
+
+    case GET_DEFAULT_TEXT_COUNTER:
+        response.writeInt32(m_defaultTextCounter);
+        break;
+
+    default:
+        return protocol::ERROR_CODE_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return protocol::ERROR_CODE_OK;
+}
+
+LcdDevice::Clock::time_point LcdDevice::nextPress(Clock::time_point now)
+{
+    // Exponentially distributed gaps, so that presses of many displays don't line up.
+    std::exponential_distribution<double> distribution(1.0 / double(m_buttonInterval.count()));
+    return now + std::chrono::milliseconds(1 + int64_t(distribution(m_random)));
+}
@@ -0,0 +1,69 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LCDDEVICE_H
+#define LCDDEVICE_H
+
+#include <random>
+
+#include "EmulatedDevice.h"
+
+/**
+ * Simulated LCD 20x4 Bricklet. The display content is only stored, button
+ * presses can be generated at random to load the callback path.
+ */
+class LcdDevice : public EmulatedDevice
+{
+public:
+    static constexpr uint16_t DEVICE_IDENTIFIER = 212;
+
+    LcdDevice(uint32_t uid, uint32_t connectedUid, char position,
+              std::chrono::milliseconds buttonInterval, uint32_t seed);
+
+    void poll(Clock::time_point now, std::vector<uint8_t>& buffer) override;
+    Clock::time_point nextDue() const override;
+
+protected:
+    uint8_t handleFunction(uint8_t functionId, const uint8_t *payload, size_t length,
+                           protocol::PacketWriter& response, Clock::time_point now) override;
+
+private:
+    static constexpr size_t LINES   = 4;
+    static constexpr size_t COLUMNS = 20;
+    static constexpr size_t BUTTONS = 4;
+
+    Clock::time_point nextPress(Clock::time_point now);
+
+    std::array<std::array<char, COLUMNS>, LINES>     m_text;
+    std::array<std::array<char, COLUMNS>, LINES>     m_defaultText;
+    std::array<std::array<uint8_t, 8>, 8>            m_customCharacters;
+    int32_t                                          m_defaultTextCounter {-1};
+    bool                                             m_backlight          {false};
+    bool                                             m_cursor             {false};
+    bool                                             m_blinking           {false};
+
+    std::chrono::milliseconds                        m_buttonInterval;
+    std::minstd_rand                                 m_random;
+    std::array<bool, BUTTONS>                        m_pressed;
+    uint8_t                                          m_pressedButton      {0};
+    Clock::time_point                                m_pressDue           {Clock::time_point::max()};
+    Clock::time_point                                m_releaseDue         {Clock::time_point::max()};
+};
+
+#endif // LCDDEVICE_H
@@ -0,0 +1,153 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Constants and little endian helpers for the TCP/IP protocol spoken by the
+ * brick daemon, as implemented by libtinkerforge/bindings/ip_connection.c.
+ */
+namespace protocol {
+
+constexpr size_t  HEADER_SIZE     = 8;
+constexpr size_t  MAX_PACKET_SIZE = 80;
+
+constexpr uint8_t FUNCTION_DISCONNECT_PROBE = 128;
+constexpr uint8_t FUNCTION_ENUMERATE        = 254;
+constexpr uint8_t CALLBACK_ENUMERATE        = 253;
+constexpr uint8_t FUNCTION_GET_IDENTITY     = 255;
+
+constexpr uint8_t ENUMERATION_TYPE_AVAILABLE    = 0;
+constexpr uint8_t ENUMERATION_TYPE_CONNECTED    = 1;
+constexpr uint8_t ENUMERATION_TYPE_DISCONNECTED = 2;
+
+constexpr uint8_t ERROR_CODE_OK                     = 0;
+constexpr uint8_t ERROR_CODE_INVALID_PARAMETER      = 1;
+constexpr uint8_t ERROR_CODE_FUNCTION_NOT_SUPPORTED = 2;
+
+struct Header
+{
+    uint32_t uid;
+    uint8_t  length;
+    uint8_t  functionId;
+    uint8_t  sequenceNumber;
+    bool     responseExpected;
+};
+
+inline Header parseHeader(const uint8_t *data)
+{
+    Header header;
+    header.uid              = uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+    header.length           = data[4];
+    header.functionId       = data[5];
+    header.sequenceNumber   = data[6] >> 4;
+    header.responseExpected = (data[6] >> 3) & 1;
+    return header;
+}
+
+inline int16_t readInt16(const uint8_t *data)
+{
+    return int16_t(uint16_t(data[0]) | uint16_t(data[1]) << 8);
+}
+
+inline uint16_t readUint16(const uint8_t *data)
+{
+    return uint16_t(data[0]) | uint16_t(data[1]) << 8;
+}
+
+inline uint32_t readUint32(const uint8_t *data)
+{
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+std::string base58Encode(uint32_t value);
+
+/**
+ * Appends one packet to a byte buffer. The length byte of the header is
+ * patched when the writer goes out of scope, so the payload can be written
+ * field by field without computing its size up front.
+ */
+class PacketWriter
+{
+public:
+    PacketWriter(std::vector<uint8_t>& buffer, uint32_t uid, uint8_t functionId,
+                 uint8_t sequenceNumber = 0, bool responseExpected = false, uint8_t errorCode = ERROR_CODE_OK)
+        : m_buffer(buffer), m_start(buffer.size())
+    {
+        writeUint32(uid);
+        writeUint8(HEADER_SIZE);
+        writeUint8(functionId);
+        writeUint8(uint8_t(sequenceNumber << 4 | (responseExpected ? 1 : 0) << 3));
+        writeUint8(uint8_t(errorCode << 6));
+    }
+
+    ~PacketWriter()
+    {
+        m_buffer[m_start + 4] = uint8_t(m_buffer.size() - m_start);
+    }
+
+    PacketWriter(const PacketWriter&) = delete;
+    PacketWriter& operator=(const PacketWriter&) = delete;
+
+    void writeUint8(uint8_t value)   { m_buffer.push_back(value); }
+    void writeBool(bool value)       { writeUint8(value ? 1 : 0); }
+    void writeChar(char value)       { writeUint8(uint8_t(value)); }
+    void writeInt16(int16_t value)   { writeUint16(uint16_t(value)); }
+    void writeInt32(int32_t value)   { writeUint32(uint32_t(value)); }
+
+    void writeUint16(uint16_t value)
+    {
+        writeUint8(uint8_t(value));
+        writeUint8(uint8_t(value >> 8));
+    }
+
+    void writeUint32(uint32_t value)
+    {
+        writeUint16(uint16_t(value));
+        writeUint16(uint16_t(value >> 16));
+    }
+
+    void writeBytes(const uint8_t *data, size_t length)
+    {
+        m_buffer.insert(m_buffer.end(), data, data + length);
+    }
+
+    // Writes a fixed size string field, padded with '\0' like the bindings expect.
+    void writeString(const std::string& value, size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            writeChar(i < value.size() ? value[i] : '\0');
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_buffer;
+    size_t                m_start;
+};
+
+} // namespace protocol
+
+#endif // PROTOCOL_H
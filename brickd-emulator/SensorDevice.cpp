@@ -0,0 +1,290 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SensorDevice.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+// How often an armed threshold is compared against the current value while
+// it isn't reached. The bricklet firmware samples in about the same interval.
+constexpr std::chrono::milliseconds THRESHOLD_SAMPLE_INTERVAL {10};
+
+} // namespace
+
+const SensorSpec TEMPERATURE_SPEC {
+    "Temperature", 216,
+    {{1, 2, 3, 4, 5, 8, 9, true, -2000, 4000}},
+    6, 7,
+    {{10, 11, 0, 1}}
+};
+
+const SensorSpec HUMIDITY_SPEC {
+    "Humidity", 27,
+    {{1, 3, 4, 7, 8, 13, 15, false, 200, 800},
+     {2, 5, 6, 9, 10, 14, 16, false, 0, 4095}},
+    11, 12,
+    {}
+};
+
+const SensorSpec AMBIENT_LIGHT_SPEC {
+    "Ambient Light", 21,
+    {{1, 3, 4, 7, 8, 13, 15, false, 0, 9000},
+     {2, 5, 6, 9, 10, 14, 16, false, 0, 4095}},
+    11, 12,
+    {}
+};
+
+const SensorSpec DISTANCE_IR_SPEC {
+    "Distance IR", 25,
+    {{1, 5, 6, 9, 10, 15, 17, false, 100, 800},
+     {2, 7, 8, 11, 12, 16, 18, false, 0, 4095}},
+    13, 14,
+    {{3, 4, 1, 2}}
+};
+
+SensorDevice::SensorDevice(const SensorSpec& spec, uint32_t uid, uint32_t connectedUid, char position,
+                           const Configuration& configuration, uint32_t seed)
+    : EmulatedDevice(uid, spec.deviceIdentifier, connectedUid, position), m_spec(spec)
+{
+    std::minstd_rand random(seed);
+    const double phase = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+
+    // All channels of a device share the phase, so that the analog value
+    // follows the calibrated one like on real hardware.
+    for (const auto& channelSpec : spec.channels)
+    {
+        m_channels.push_back({&channelSpec,
+                              Waveform(configuration.shape, channelSpec.minimum, channelSpec.maximum,
+                                       configuration.waveformPeriod, phase, random())});
+    }
+
+    if (configuration.callbackPeriod.count() > 0 && !m_channels.empty())
+    {
+        m_channels.front().period = uint32_t(configuration.callbackPeriod.count());
+        m_channels.front().periodDue = Clock::now() + configuration.callbackPeriod;
+    }
+}
+
+void SensorDevice::poll(Clock::time_point now, std::vector<uint8_t>& buffer)
+{
+    for (auto& channel : m_channels)
+    {
+        if (channel.periodDue <= now)
+        {
+            const int32_t value = channel.waveform.value(now);
+            if (!channel.hasLastValue || value != channel.lastValue)
+            {
+                protocol::PacketWriter packet(buffer, uid(), channel.spec->callback);
+                writeValue(channel, packet, value);
+                channel.hasLastValue = true;
+                channel.lastValue = value;
+            }
+
+            // Don't try to catch up with missed periods, the firmware doesn't either.
+            channel.periodDue += std::chrono::milliseconds(channel.period);
+            if (channel.periodDue <= now)
+            {
+                channel.periodDue = now + std::chrono::milliseconds(channel.period);
+            }
+        }
+
+        if (channel.thresholdDue <= now)
+        {
+            const int32_t value = channel.waveform.value(now);
+            if (thresholdReached(channel, value))
+            {
+                protocol::PacketWriter packet(buffer, uid(), channel.spec->reachedCallback);
+                writeValue(channel, packet, value);
+                channel.thresholdDue = now + std::chrono::milliseconds(m_debounce);
+            }
+            else
+            {
+                channel.thresholdDue = now + THRESHOLD_SAMPLE_INTERVAL;
+            }
+        }
+    }
+}
+
+EmulatedDevice::Clock::time_point SensorDevice::nextDue() const
+{
+    Clock::time_point due = Clock::time_point::max();
+
+    for (const auto& channel : m_channels)
+    {
+        due = std::min({due, channel.periodDue, channel.thresholdDue});
+    }
+
+    return due;
+}
+
+uint8_t SensorDevice::handleFunction(uint8_t functionId, const uint8_t *payload, size_t length,
+                                     protocol::PacketWriter& response, Clock::time_point now)
+{
+    if (functionId == m_spec.setDebounce)
+    {
+        if (length < 4)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        m_debounce = protocol::readUint32(payload);
+        return protocol::ERROR_CODE_OK;
+    }
+
+    if (functionId == m_spec.getDebounce)
+    {
+        response.writeUint32(m_debounce);
+        return protocol::ERROR_CODE_OK;
+    }
+
+    for (auto& channel : m_channels)
+    {
+        const uint8_t errorCode = handleChannelFunction(channel, functionId, payload, length, response, now);
+        if (errorCode != protocol::ERROR_CODE_FUNCTION_NOT_SUPPORTED)
+        {
+            return errorCode;
+        }
+    }
+
+    for (const auto& setting : m_spec.settings)
+    {
+        if (functionId == setting.set || functionId == setting.get)
+        {
+            return handleSetting(setting, functionId, payload, length, response);
+        }
+    }
+
+    return protocol::ERROR_CODE_FUNCTION_NOT_SUPPORTED;
+}
+
+uint8_t SensorDevice::handleChannelFunction(Channel& channel, uint8_t functionId, const uint8_t *payload, size_t length,
+                                            protocol::PacketWriter& response, Clock::time_point now)
+{
+    const SensorChannelSpec& spec = *channel.spec;
+
+    if (functionId == spec.getValue)
+    {
+        writeValue(channel, response, channel.waveform.value(now));
+    }
+    else if (functionId == spec.setPeriod)
+    {
+        if (length < 4)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        channel.period = protocol::readUint32(payload);
+        channel.periodDue = channel.period > 0 ? now + std::chrono::milliseconds(channel.period) : Clock::time_point::max();
+    }
+    else if (functionId == spec.getPeriod)
+    {
+        response.writeUint32(channel.period);
+    }
+    else if (functionId == spec.setThreshold)
+    {
+        if (length < 5)
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        const char option = char(payload[0]);
+        if (option != 'x' && option != 'o' && option != 'i' && option != '<' && option != '>')
+        {
+            return protocol::ERROR_CODE_INVALID_PARAMETER;
+        }
+
+        channel.option = option;
+        channel.thresholdMin = readValue(channel, payload + 1);
+        channel.thresholdMax = readValue(channel, payload + 3);
+        channel.thresholdDue = option != 'x' ? now : Clock::time_point::max();
+    }
+    else if (functionId == spec.getThreshold)
+    {
+        response.writeChar(channel.option);
+        writeValue(channel, response, channel.thresholdMin);
+        writeValue(channel, response, channel.thresholdMax);
+    }
+    else
+    {
+        return protocol::ERROR_CODE_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return protocol::ERROR_CODE_OK;
+}
+
+uint8_t SensorDevice::handleSetting(const SensorSettingSpec& setting, uint8_t functionId, const uint8_t *payload, size_t length,
+                                    protocol::PacketWriter& response)
+{
+    if (length < size_t(setting.keySize + (functionId == setting.set ? setting.valueSize : 0)))
+    {
+        return protocol::ERROR_CODE_INVALID_PARAMETER;
+    }
+
+    const uint16_t key = uint16_t(setting.set << 8 | (setting.keySize > 0 ? payload[0] : 0));
+    auto& value = m_settings[key];
+    value.resize(setting.valueSize);
+
+    if (functionId == setting.set)
+    {
+        std::copy(payload + setting.keySize, payload + setting.keySize + setting.valueSize, value.begin());
+    }
+    else
+    {
+        response.writeBytes(value.data(), value.size());
+    }
+
+    return protocol::ERROR_CODE_OK;
+}
+
+void SensorDevice::writeValue(const Channel& channel, protocol::PacketWriter& packet, int32_t value) const
+{
+    if (channel.spec->isSigned)
+    {
+        packet.writeInt16(int16_t(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, value))));
+    }
+    else
+    {
+        packet.writeUint16(uint16_t(std::max<int32_t>(0, std::min<int32_t>(UINT16_MAX, value))));
+    }
+}
+
+int32_t SensorDevice::readValue(const Channel& channel, const uint8_t *data) const
+{
+    return channel.spec->isSigned ? protocol::readInt16(data) : protocol::readUint16(data);
+}
+
+bool SensorDevice::thresholdReached(const Channel& channel, int32_t value) const
+{
+    switch (channel.option)
+    {
+    case 'o':
+        return value < channel.thresholdMin || value > channel.thresholdMax;
+    case 'i':
+        return value >= channel.thresholdMin && value <= channel.thresholdMax;
+    case '<':
+        return value < channel.thresholdMin;
+    case '>':
+        return value > channel.thresholdMin;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SENSORDEVICE_H
+#define SENSORDEVICE_H
+
+#include <map>
+#include <vector>
+
+#include "EmulatedDevice.h"
+#include "Waveform.h"
+
+/**
+ * Function ids of one measured quantity of a bricklet, e.g. the humidity or
+ * the analog value of the Humidity Bricklet.
+ */
+struct SensorChannelSpec
+{
+    uint8_t getValue;
+    uint8_t setPeriod;
+    uint8_t getPeriod;
+    uint8_t setThreshold;
+    uint8_t getThreshold;
+    uint8_t callback;
+    uint8_t reachedCallback;
+    bool    isSigned;
+    int32_t minimum;
+    int32_t maximum;
+};
+
+/**
+ * Setting without any side effect in the simulation, which is only stored so
+ * that it can be read back (like the I2C mode of the Temperature Bricklet).
+ * The getter takes the first keySize bytes of the setter payload as argument.
+ */
+struct SensorSettingSpec
+{
+    uint8_t set;
+    uint8_t get;
+    uint8_t keySize;
+    uint8_t valueSize;
+};
+
+struct SensorSpec
+{
+    const char                    *name;
+    uint16_t                       deviceIdentifier;
+    std::vector<SensorChannelSpec> channels;
+    uint8_t                        setDebounce;
+    uint8_t                        getDebounce;
+    std::vector<SensorSettingSpec> settings;
+};
+
+extern const SensorSpec TEMPERATURE_SPEC;
+extern const SensorSpec HUMIDITY_SPEC;
+extern const SensorSpec AMBIENT_LIGHT_SPEC;
+extern const SensorSpec DISTANCE_IR_SPEC;
+
+/**
+ * Simulated sensor bricklet with getters, period callbacks and threshold
+ * callbacks for each of its channels. The first channel is the calibrated
+ * value, all others are 12 bit analog values.
+ */
+class SensorDevice : public EmulatedDevice
+{
+public:
+    struct Configuration {
+        Waveform::Shape           shape          {Waveform::Shape::Sine};
+        std::chrono::milliseconds waveformPeriod {60000};
+        std::chrono::milliseconds callbackPeriod {0};
+    };
+
+    SensorDevice(const SensorSpec& spec, uint32_t uid, uint32_t connectedUid, char position,
+                 const Configuration& configuration, uint32_t seed);
+
+    void poll(Clock::time_point now, std::vector<uint8_t>& buffer) override;
+    Clock::time_point nextDue() const override;
+
+protected:
+    uint8_t handleFunction(uint8_t functionId, const uint8_t *payload, size_t length,
+                           protocol::PacketWriter& response, Clock::time_point now) override;
+
+private:
+    struct Channel {
+        const SensorChannelSpec *spec;
+        Waveform                 waveform;
+
+        uint32_t                 period        {0};
+        Clock::time_point        periodDue     {Clock::time_point::max()};
+        bool                     hasLastValue  {false};
+        int32_t                  lastValue     {0};
+
+        char                     option        {'x'};
+        int32_t                  thresholdMin  {0};
+        int32_t                  thresholdMax  {0};
+        Clock::time_point        thresholdDue  {Clock::time_point::max()};
+    };
+
+    uint8_t handleChannelFunction(Channel& channel, uint8_t functionId, const uint8_t *payload, size_t length,
+                                  protocol::PacketWriter& response, Clock::time_point now);
+    uint8_t handleSetting(const SensorSettingSpec& setting, uint8_t functionId, const uint8_t *payload, size_t length,
+                          protocol::PacketWriter& response);
+    void writeValue(const Channel& channel, protocol::PacketWriter& packet, int32_t value) const;
+    int32_t readValue(const Channel& channel, const uint8_t *data) const;
+    bool thresholdReached(const Channel& channel, int32_t value) const;
+
+    const SensorSpec&                        m_spec;
+    std::vector<Channel>                     m_channels;
+    uint32_t                                 m_debounce {100};
+    std::map<uint16_t, std::vector<uint8_t>> m_settings;
+};
+
+#endif // SENSORDEVICE_H
@@ -0,0 +1,118 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Waveform.h"
+
+#include <cmath>
+
+namespace {
+
+// Noise samples are held for this long, so that period callbacks see
+// changing values without every single sample being different.
+constexpr std::chrono::milliseconds NOISE_HOLD {10};
+
+uint32_t hash(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352d;
+    value ^= value >> 15;
+    value *= 0x846ca68b;
+    value ^= value >> 16;
+    return value;
+}
+
+} // namespace
+
+Waveform::Waveform(Shape shape, int32_t minimum, int32_t maximum,
+                   std::chrono::milliseconds period, double phase, uint32_t seed)
+    : m_shape(shape), m_minimum(minimum), m_maximum(maximum),
+      m_period(period.count() > 0 ? period : std::chrono::milliseconds(1)),
+      m_phase(phase - std::floor(phase)), m_seed(seed)
+{
+}
+
+int32_t Waveform::value(Clock::time_point time) const
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch());
+    const double position = std::fmod(double(elapsed.count()) / double(m_period.count()) + m_phase, 1.0);
+    double level = 0.0; // in the range [0, 1]
+
+    switch (m_shape)
+    {
+    case Shape::Constant:
+        level = 0.5;
+        break;
+
+    case Shape::Sine:
+        level = 0.5 + 0.5 * std::sin(2.0 * M_PI * position);
+        break;
+
+    case Shape::Square:
+        level = position < 0.5 ? 1.0 : 0.0;
+        break;
+
+    case Shape::Triangle:
+        level = position < 0.5 ? 2.0 * position : 2.0 - 2.0 * position;
+        break;
+
+    case Shape::Sawtooth:
+        level = position;
+        break;
+
+    case Shape::Noise:
+        level = double(hash(m_seed ^ uint32_t(elapsed.count() / NOISE_HOLD.count()))) / double(UINT32_MAX);
+        break;
+    }
+
+    return m_minimum + int32_t(std::lround(level * double(m_maximum - m_minimum)));
+}
+
+bool Waveform::parseShape(const std::string& name, Shape& shape)
+{
+    if (name == "constant")
+    {
+        shape = Shape::Constant;
+    }
+    else if (name == "sine")
+    {
+        shape = Shape::Sine;
+    }
+    else if (name == "square")
+    {
+        shape = Shape::Square;
+    }
+    else if (name == "triangle")
+    {
+        shape = Shape::Triangle;
+    }
+    else if (name == "sawtooth")
+    {
+        shape = Shape::Sawtooth;
+    }
+    else if (name == "noise")
+    {
+        shape = Shape::Noise;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,63 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Deterministic value generator for simulated sensors. The value is a pure
+ * function of time, so a device can be sampled at arbitrary moments without
+ * keeping any history.
+ */
+class Waveform
+{
+public:
+    enum class Shape
+    {
+        Constant,
+        Sine,
+        Square,
+        Triangle,
+        Sawtooth,
+        Noise
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    Waveform(Shape shape, int32_t minimum, int32_t maximum,
+             std::chrono::milliseconds period, double phase = 0.0, uint32_t seed = 0);
+
+    int32_t value(Clock::time_point time) const;
+
+    static bool parseShape(const std::string& name, Shape& shape);
+
+private:
+    Shape                     m_shape;
+    int32_t                   m_minimum;
+    int32_t                   m_maximum;
+    std::chrono::milliseconds m_period;
+    double                    m_phase;
+    uint32_t                  m_seed;
+};
+
+#endif // WAVEFORM_H
@@ -0,0 +1,177 @@
+/*
+ * Tinkerforge Brickd Emulator - Simulated brick daemon for load tests
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Emulator.h"
+#include "LcdDevice.h"
+#include "SensorDevice.h"
+
+#include <csignal>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace {
+
+// Number of bricklet ports of a simulated master brick.
+constexpr unsigned BRICKLETS_PER_MASTER = 4;
+constexpr uint16_t MASTER_DEVICE_IDENTIFIER = 13;
+
+Emulator *runningEmulator = nullptr;
+
+void stopEmulator(int)
+{
+    if (runningEmulator)
+    {
+        runningEmulator->stop();
+    }
+}
+
+struct DeviceCounts {
+    unsigned temperature  {1};
+    unsigned humidity     {1};
+    unsigned ambientLight {1};
+    unsigned distanceIr   {1};
+    unsigned lcd          {1};
+};
+
+/**
+ * Creates the simulated devices as a flat set of master bricks, each with
+ * four bricklets attached.
+ */
+std::vector<std::unique_ptr<EmulatedDevice>> createDevices(const DeviceCounts& counts, uint32_t uidBase,
+                                                           const SensorDevice::Configuration& sensorConfig,
+                                                           std::chrono::milliseconds buttonInterval, uint32_t seed)
+{
+    std::vector<std::unique_ptr<EmulatedDevice>> devices;
+    uint32_t nextUid = uidBase;
+    uint32_t masterUid = 0;
+    unsigned port = BRICKLETS_PER_MASTER;
+
+    auto attach = [&](std::function<EmulatedDevice *(uint32_t uid, uint32_t connectedUid, char position)> create) {
+        if (port == BRICKLETS_PER_MASTER)
+        {
+            masterUid = nextUid++;
+            devices.emplace_back(new EmulatedDevice(masterUid, MASTER_DEVICE_IDENTIFIER, 0, '0', {{2, 1, 0}}, {{2, 4, 0}}));
+            port = 0;
+        }
+
+        const uint32_t uid = nextUid++;
+        devices.emplace_back(create(uid, masterUid, char('a' + port++)));
+    };
+
+    const std::pair<const SensorSpec *, unsigned> sensors[] = {
+        {&TEMPERATURE_SPEC, counts.temperature},
+        {&HUMIDITY_SPEC, counts.humidity},
+        {&AMBIENT_LIGHT_SPEC, counts.ambientLight},
+        {&DISTANCE_IR_SPEC, counts.distanceIr}
+    };
+
+    for (const auto& sensor : sensors)
+    {
+        for (unsigned i = 0; i < sensor.second; ++i)
+        {
+            attach([&](uint32_t uid, uint32_t connectedUid, char position) {
+                return new SensorDevice(*sensor.first, uid, connectedUid, position, sensorConfig, seed ^ uid);
+            });
+        }
+    }
+
+    for (unsigned i = 0; i < counts.lcd; ++i)
+    {
+        attach([&](uint32_t uid, uint32_t connectedUid, char position) {
+            return new LcdDevice(uid, connectedUid, position, buttonInterval, seed ^ uid);
+        });
+    }
+
+    return devices;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Emulator::Configuration emulatorConfig;
+    SensorDevice::Configuration sensorConfig;
+    DeviceCounts counts;
+    std::string waveform {"sine"};
+    unsigned waveformPeriod = 60000;
+    unsigned callbackPeriod = 0;
+    unsigned buttonInterval = 0;
+    uint32_t uidBase = 100000;
+    uint32_t seed = 1;
+
+    // Declare the supported command line options.
+    po::options_description desc("Command line options");
+    desc.add_options()
+        ("help", "Shows this help message")
+        ("quiet,q", "Don't print to the standard output")
+        ("address,a", po::value<std::string>(&emulatorConfig.address), "Address to listen on (default 0.0.0.0)")
+        ("port,p", po::value<uint16_t>(&emulatorConfig.port), "Port to listen on (default 4223)")
+        ("temperature", po::value<unsigned>(&counts.temperature), "Number of Temperature Bricklets")
+        ("humidity", po::value<unsigned>(&counts.humidity), "Number of Humidity Bricklets")
+        ("ambient-light", po::value<unsigned>(&counts.ambientLight), "Number of Ambient Light Bricklets")
+        ("distance-ir", po::value<unsigned>(&counts.distanceIr), "Number of Distance IR Bricklets")
+        ("lcd", po::value<unsigned>(&counts.lcd), "Number of LCD 20x4 Bricklets")
+        ("waveform", po::value<std::string>(&waveform), "Shape of the sensor values: constant, sine (default), square, triangle, sawtooth or noise")
+        ("waveform-period", po::value<unsigned>(&waveformPeriod), "Period of the sensor values in milliseconds (default 60000)")
+        ("callback-period", po::value<unsigned>(&callbackPeriod), "Initial value callback period of all sensors in milliseconds (default 0, disabled until set by a client)")
+        ("button-interval", po::value<unsigned>(&buttonInterval), "Average time between simulated LCD button presses in milliseconds (default 0, never)")
+        ("uid-base", po::value<uint32_t>(&uidBase), "Numeric UID of the first simulated device (default 100000)")
+        ("seed", po::value<uint32_t>(&seed), "Seed for the phases and noise of the sensor values")
+        ("max-client-queue", po::value<size_t>(&emulatorConfig.maxClientQueue), "Bytes queued per client before callbacks are dropped (default 4 MiB)")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    if (!Waveform::parseShape(waveform, sensorConfig.shape) || uidBase == 0)
+    {
+        std::cout << "Wrong command line parameters used (" << (uidBase == 0 ? "uid base must not be 0" : "unknown waveform '" + waveform + "'") << ").\n" << std::endl;
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    sensorConfig.waveformPeriod = std::chrono::milliseconds(waveformPeriod);
+    sensorConfig.callbackPeriod = std::chrono::milliseconds(callbackPeriod);
+
+    auto logger = spdlog::stdout_logger_mt("main");
+    if (vm.count("quiet"))
+    {
+        logger->set_level(spdlog::level::warn);
+    }
+
+    Emulator emulator(emulatorConfig, createDevices(counts, uidBase, sensorConfig, std::chrono::milliseconds(buttonInterval), seed));
+
+    runningEmulator = &emulator;
+    std::signal(SIGINT, stopEmulator);
+    std::signal(SIGTERM, stopEmulator);
+
+    const bool success = emulator.run();
+    runningEmulator = nullptr;
+    return success ? 0 : 1;
+}
@@ -21,8 +21,9 @@
 
 namespace tinkerforge {
 
-  AbstractSensor::AbstractSensor (const char* uid)
+  AbstractSensor::AbstractSensor (const char* uid, ConnectionHandler& connection)
       : m_uid(uid)
+      , m_ipcon(connection.getConnection())
   {
 
   }
@@ -32,6 +33,66 @@ namespace tinkerforge {
     return m_uid;
   }
 
+  uint32_t AbstractSensor::numericUid() const
+  {
+    return m_uid.value();
+  }
+
+  void AbstractSensor::registerEventCallback(EventCallback callback)
+  {
+    m_callback = std::move(callback);
+    enableValueCallback();
+  }
+
+  void AbstractSensor::rearm()
+  {
+    if (m_callback) { enableValueCallback(); }
+  }
+
+  void AbstractSensor::enableHistory(size_t capacity, std::chrono::milliseconds window)
+  {
+    m_history.reset(new SampleHistory(capacity, window));
+  }
+
+  const SampleHistory* AbstractSensor::history() const
+  {
+    return m_history.get();
+  }
+
+  void AbstractSensor::registerCallback(ValueChangedCallback callback)
+  {
+    registerEventCallback([this, callback](const SensorEvent& event) {
+        callback(type(), event.value);
+    });
+  }
+
+  void AbstractSensor::registerTimedCallback(TimedValueChangedCallback callback)
+  {
+    registerEventCallback([this, callback](const SensorEvent& event) {
+        callback(type(), event.value, event.time);
+    });
+  }
+
+  void AbstractSensor::valueChanged(const SensorEvent& event) const
+  {
+    if (m_history) { m_history->push(event.time, event.value); }
+    if (m_callback) { m_callback(event); }
+  }
+
+  AbstractSensor::SampleTime AbstractSensor::sampleTime() const
+  {
+    uint64_t monotonic;
+    uint64_t realtime;
+
+    if (ipcon_get_callback_timestamp(m_ipcon, &monotonic, &realtime) < 0)
+    {
+        return SampleTime::now();
+    }
+
+    return SampleTime{std::chrono::steady_clock::time_point(std::chrono::microseconds(monotonic)),
+                      std::chrono::system_clock::time_point(std::chrono::microseconds(realtime))};
+  }
+
   bool operator==(const AbstractSensor& bricket, const AbstractSensor::UID& uid)
   {
       return bricket.getUid() == uid;
@@ -19,66 +19,8 @@
 
 #include <tinkerforge/BrickletTemperature.h>
 
-extern "C" {
-#include "bindings/bricklet_temperature.h"
-}
-
 namespace tinkerforge {
 
-void temperatureCallback(int16_t curTemperature, void* object)
-{
-    static_cast<BrickletTemperature*>(object)->temperatureUpdated(curTemperature);
-}
-
-BrickletTemperature::BrickletTemperature(const char* uid, ConnectionHandler &connection)
-    : AbstractSensor(uid)
-    , m_tolerance(10)
-{
-    temperature_create(&m_temperature, uid, connection.getConnection());
-}
-
-BrickletTemperature::~BrickletTemperature ()
-{
-    temperature_destroy(&m_temperature);
-}
-
-uint32_t BrickletTemperature::DeviceIdentifier()
-{
-    return TEMPERATURE_DEVICE_IDENTIFIER;
-}
-
-const std::string& BrickletTemperature::type() const
-{
-    static std::string type("temperature");
-    return type;
-}
-
-int16_t BrickletTemperature::getTemperature() {
-	int16_t temperatureValue;
-    temperature_get_temperature(&m_temperature, &temperatureValue);
-	return temperatureValue;
-}
-
-void BrickletTemperature::registerCallback(ValueChangedCallback callback)
-{
-    m_callback = std::move(callback);
-
-    temperature_register_callback(&m_temperature,
-			TEMPERATURE_CALLBACK_TEMPERATURE_REACHED,
-            reinterpret_cast<void*>(temperatureCallback), this);
-
-    // already update the temperature with the current value after registering the callback
-    temperatureUpdated(getTemperature());
-}
-
-void BrickletTemperature::temperatureUpdated(int16_t newTemperature)
-{
-    // update callback threshold to trigger again, when outside of current temperature +/- tolerance
-    temperature_set_temperature_callback_threshold(&m_temperature, 'o',
-                newTemperature - m_tolerance,
-                newTemperature + m_tolerance);
-
-    if (m_callback) { m_callback(type(), newTemperature); }
-}
+  template class Sensor<TemperatureTraits>;
 
 } /* namespace tinkerforge */
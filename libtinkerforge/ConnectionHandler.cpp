@@ -20,8 +20,8 @@
 #include <tinkerforge/ConnectionHandler.h>
 #include <spdlog/spdlog.h>
 
-#include <chrono>
-#include <thread>
+#include <algorithm>
+#include <random>
 
 #include <iostream>
 
@@ -30,17 +30,125 @@ namespace tinkerforge {
 void enumerateCallback(const char* uid, const char*, char, uint8_t*, uint8_t*, uint16_t deviceIdentifier, uint8_t enumerationType, void* object)
 {
     auto connectionHandler = static_cast<ConnectionHandler*>(object);
-    if (connectionHandler->m_callback)
+    ConnectionHandler::EnumerateCallback callback;
+
     {
-        connectionHandler->m_callback(uid, deviceIdentifier, enumerationType);
+        std::lock_guard<std::mutex> lock(connectionHandler->m_mutex);
+        callback = connectionHandler->m_callback;
     }
+
+    if (callback)
+    {
+        callback(uid, deviceIdentifier, enumerationType);
+    }
+}
+
+void connectedCallback(uint8_t, void* object)
+{
+    static_cast<ConnectionHandler*>(object)->connectionChanged(true, false);
+}
+
+void disconnectedCallback(uint8_t disconnectReason, void* object)
+{
+    static_cast<ConnectionHandler*>(object)->connectionChanged(false, disconnectReason != IPCON_DISCONNECT_REASON_REQUEST);
 }
 
+static void latencyHistogramCallback(const char* uid, uint8_t functionId, uint8_t kind, const LatencyHistogram* histogram, void* object)
+{
+    static_cast<std::vector<ConnectionHandler::LatencyStatistics>*>(object)->push_back(
+        {uid, functionId, static_cast<ConnectionHandler::LatencyStatistics::Kind>(kind), *histogram});
+}
+
+  std::chrono::microseconds ConnectionHandler::LatencyStatistics::percentile (double percentile) const
+  {
+    return std::chrono::microseconds(ipcon_get_latency_percentile(&histogram, percentile));
+  }
+
+  std::chrono::microseconds ConnectionHandler::LatencyStatistics::mean () const
+  {
+    return std::chrono::microseconds(histogram.count > 0 ? histogram.sum / histogram.count : 0);
+  }
+
+  std::chrono::microseconds ConnectionHandler::LatencyStatistics::max () const
+  {
+    return std::chrono::microseconds(histogram.max);
+  }
+
+  const char* ConnectionHandler::LatencyStatistics::kindName () const
+  {
+    switch (kind)
+    {
+    case Kind::RoundTrip: return "round trip";
+    case Kind::QueueWait: return "queue wait";
+    case Kind::Execution: return "execution";
+    }
+
+    return "unknown";
+  }
+
+  double ConnectionHandler::SendStatistics::sendCallsPerRequest () const
+  {
+    return requests > 0 ? static_cast<double>(sendCalls) / requests : 0.0;
+  }
+
   ConnectionHandler::ConnectionHandler (const char* host, uint16_t port)
+      : ConnectionHandler(Configuration{host, port})
+  {
+
+  }
+
+  ConnectionHandler::ConnectionHandler (const Configuration& configuration)
+      : m_configuration(configuration)
   {  
+    const char* host = m_configuration.host.c_str();
+    const uint16_t port = m_configuration.port;
+
     // Create ip connection to brickd.
     ipcon_create(&m_ipcon);
 
+    if (configuration.reactor && ipcon_set_reactor(&m_ipcon, true) < 0 && spdlog::get("main"))
+    {
+        spdlog::get("main")->warn("Reactor mode is not supported on this platform, using dedicated threads.");
+    }
+
+    ipcon_set_send_batching(&m_ipcon, configuration.sendBatching);
+    ipcon_set_callback_workers(&m_ipcon, static_cast<uint8_t>(std::min(configuration.callbackWorkers, 255u)));
+    ipcon_set_callback_queue_capacity(&m_ipcon, configuration.queueCapacity, configuration.queuePolicy);
+    ipcon_set_latency_tracking(&m_ipcon, configuration.latencyTracking || configuration.latencyReportInterval.count() > 0);
+
+    ipcon_register_callback(&m_ipcon, IPCON_CALLBACK_CONNECTED,
+                            reinterpret_cast<void*>(connectedCallback), this);
+    ipcon_register_callback(&m_ipcon, IPCON_CALLBACK_DISCONNECTED,
+                            reinterpret_cast<void*>(disconnectedCallback), this);
+
+    if (!configuration.captureFile.empty() &&
+        ipcon_start_capture(&m_ipcon, configuration.captureFile.c_str()) < 0 && spdlog::get("main"))
+    {
+        spdlog::get("main")->error("Could not open capture file '{}'.", configuration.captureFile);
+    }
+
+    // The replay is started by replay(), once the callbacks are registered.
+    if (!configuration.replayFile.empty())
+    {
+        return;
+    }
+
+    if (configuration.latencyReportInterval.count() > 0)
+    {
+        m_reportThread = std::thread(&ConnectionHandler::reportLoop, this);
+    }
+
+    if (configuration.asyncConnect)
+    {
+        // The connect thread also does the reconnects, with a backoff
+        // instead of the fixed retry interval of the ip connection.
+        ipcon_set_auto_reconnect(&m_ipcon, false);
+
+        m_connectRequested = true;
+        m_connectThread = std::thread(&ConnectionHandler::connectLoop, this);
+        return;
+    }
+
     // Try to connect until it is connected to the brick daemon.
     uint8_t connectionTries = 0;
     while(ipcon_connect(&m_ipcon, host, port) < 0) {
@@ -60,6 +168,24 @@ void enumerateCallback(const char* uid, const char*, char, uint8_t*, uint8_t*, u
 
   ConnectionHandler::~ConnectionHandler ()
   {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_connectionCallback = nullptr;
+    }
+
+    m_condition.notify_all();
+
+    if (m_connectThread.joinable())
+    {
+        m_connectThread.join();
+    }
+
+    if (m_reportThread.joinable())
+    {
+        m_reportThread.join();
+    }
+
     ipcon_destroy(&m_ipcon);
   }
 
@@ -68,13 +194,239 @@ void enumerateCallback(const char* uid, const char*, char, uint8_t*, uint8_t*, u
     return &m_ipcon;
   }
 
+  const ConnectionHandler::Configuration& ConnectionHandler::getConfiguration () const
+  {
+    return m_configuration;
+  }
+
+  bool ConnectionHandler::isConnected ()
+  {
+    return ipcon_get_connection_state(&m_ipcon) == IPCON_CONNECTION_STATE_CONNECTED;
+  }
+
+  bool ConnectionHandler::isReplay () const
+  {
+    return !m_configuration.replayFile.empty();
+  }
+
+  bool ConnectionHandler::replay ()
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const int result = ipcon_replay(&m_ipcon, m_configuration.replayFile.c_str(), m_configuration.replaySpeed);
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    if (result < 0)
+    {
+        if (spdlog::get("main"))
+        {
+            spdlog::get("main")->error("Replay of '{}' failed ({}).", m_configuration.replayFile,
+                                       result == E_CAPTURE_FILE ? "unreadable capture" : "already connected");
+        }
+        return false;
+    }
+
+    // The callback threads outlive the replay, so their statistics cover all of it.
+    uint64_t dispatched = 0;
+    uint64_t latencySum = 0;
+    uint32_t latencyMax = 0;
+    for (uint8_t worker = 0; worker < ipcon_get_callback_workers(&m_ipcon); ++worker)
+    {
+        uint32_t depth, averageLatency, maximumLatency;
+        uint64_t count;
+        if (ipcon_get_callback_worker_statistics(&m_ipcon, worker, &depth, &count, &averageLatency, &maximumLatency) == E_OK)
+        {
+            dispatched += count;
+            latencySum += count * averageLatency;
+            latencyMax = std::max(latencyMax, maximumLatency);
+        }
+    }
+
+    if (spdlog::get("main"))
+    {
+        spdlog::get("main")->info("Replayed '{}' in {} ms: {} callbacks ({}/s), latency average {} us, maximum {} us.",
+                                  m_configuration.replayFile, duration.count(), dispatched,
+                                  duration.count() > 0 ? dispatched * 1000 / duration.count() : dispatched,
+                                  dispatched > 0 ? latencySum / dispatched : 0, latencyMax);
+    }
+
+    if (ipcon_get_latency_tracking(&m_ipcon))
+    {
+        logLatencyStatistics(m_configuration.latencyReportLimit);
+    }
+
+    return true;
+  }
+
+  std::vector<ConnectionHandler::LatencyStatistics> ConnectionHandler::latencyStatistics ()
+  {
+    std::vector<LatencyStatistics> statistics;
+
+    ipcon_get_latency_histograms(&m_ipcon, latencyHistogramCallback, &statistics);
+
+    return statistics;
+  }
+
+  void ConnectionHandler::resetLatencyStatistics ()
+  {
+    ipcon_reset_latency_histograms(&m_ipcon);
+  }
+
+  void ConnectionHandler::logLatencyStatistics (size_t limit)
+  {
+    if (!spdlog::get("main"))
+    {
+        return;
+    }
+
+    auto statistics = latencyStatistics();
+
+    // Functions that time out are the most interesting ones, then the slow tail.
+    std::sort(statistics.begin(), statistics.end(), [](const LatencyStatistics& a, const LatencyStatistics& b) {
+        if (a.histogram.timeouts != b.histogram.timeouts) { return a.histogram.timeouts > b.histogram.timeouts; }
+        return a.percentile(99.0) > b.percentile(99.0);
+    });
+
+    if (statistics.size() > limit)
+    {
+        statistics.resize(limit);
+    }
+
+    for (const auto& entry : statistics)
+    {
+        spdlog::get("main")->info("Latency of '{}' function {} ({}): {} samples, p50 {} us, p99 {} us, max {} us, {} timeouts.",
+                                  entry.uid, static_cast<unsigned>(entry.functionId), entry.kindName(), entry.histogram.count,
+                                  entry.percentile(50.0).count(), entry.percentile(99.0).count(),
+                                  entry.max().count(), entry.histogram.timeouts);
+    }
+  }
+
+  ConnectionHandler::SendStatistics ConnectionHandler::sendStatistics ()
+  {
+    SendStatistics statistics {};
+
+    ipcon_get_send_statistics(&m_ipcon, &statistics.requests, &statistics.sendCalls);
+
+    return statistics;
+  }
+
+  void ConnectionHandler::logSendStatistics ()
+  {
+    if (!spdlog::get("main"))
+    {
+        return;
+    }
+
+    const auto statistics = sendStatistics();
+
+    spdlog::get("main")->info("Sent {} requests in {} send calls ({:.2f} send calls per request, batching {}).",
+                              statistics.requests, statistics.sendCalls, statistics.sendCallsPerRequest(),
+                              ipcon_get_send_batching(&m_ipcon) ? "on" : "off");
+  }
+
   void ConnectionHandler::setEnumerateCallback (EnumerateCallback callback)
   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
       m_callback = std::move(callback);
 
       ipcon_register_callback(&m_ipcon, IPCON_CALLBACK_ENUMERATE,
                               reinterpret_cast<void*>(enumerateCallback), this);
-      ipcon_enumerate(&m_ipcon);
+
+      // Otherwise the connected callback enumerates, once it is called.
+      if (m_connected)
+      {
+          ipcon_enumerate(&m_ipcon);
+      }
+  }
+
+  void ConnectionHandler::setConnectionCallback (ConnectionCallback callback)
+  {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_connectionCallback = std::move(callback);
+  }
+
+  void ConnectionHandler::connectionChanged (bool connected, bool reconnect)
+  {
+      ConnectionCallback callback;
+
+      {
+          std::lock_guard<std::mutex> lock(m_mutex);
+
+          m_connected = connected;
+          callback = m_connectionCallback;
+
+          // Bring up the devices on every new connection, the brick daemon
+          // or the devices might have been restarted meanwhile.
+          if (connected && m_callback)
+          {
+              ipcon_enumerate(&m_ipcon);
+          }
+
+          if (reconnect && m_connectThread.joinable())
+          {
+              m_connectRequested = true;
+              m_condition.notify_all();
+          }
+      }
+
+      if (callback)
+      {
+          callback(connected);
+      }
+  }
+
+  void ConnectionHandler::connectLoop ()
+  {
+      const char* host = m_configuration.host.c_str();
+      const uint16_t port = m_configuration.port;
+      std::minstd_rand random(std::random_device{}());
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      while (!m_stopping)
+      {
+          m_condition.wait(lock, [this]{ return m_stopping || m_connectRequested; });
+
+          auto delay = m_configuration.reconnectDelay;
+          while (!m_stopping && m_connectRequested)
+          {
+              lock.unlock();
+              const int result = ipcon_connect(&m_ipcon, host, port);
+              lock.lock();
+
+              if (result == E_OK || result == E_ALREADY_CONNECTED)
+              {
+                  m_connectRequested = false;
+                  break;
+              }
+
+              // Wait between half and the full delay, so that several clients
+              // don't retry in lockstep after the brick daemon restarted.
+              std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(delay.count() / 2, delay.count());
+              const std::chrono::milliseconds wait {jitter(random)};
+
+              if (spdlog::get("main"))
+              {
+                  spdlog::get("main")->error("Connection to brick deamon on '{}' (port {}) failed. Will try again in {} ms.", host, port, wait.count());
+              }
+
+              m_condition.wait_for(lock, wait, [this]{ return m_stopping; });
+              delay = std::min(delay * 2, m_configuration.reconnectMaxDelay);
+          }
+      }
+  }
+
+  void ConnectionHandler::reportLoop ()
+  {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      while (!m_condition.wait_for(lock, m_configuration.latencyReportInterval, [this]{ return m_stopping; }))
+      {
+          lock.unlock();
+          logLatencyStatistics(m_configuration.latencyReportLimit);
+          logSendStatistics();
+          lock.lock();
+      }
   }
 
   void ConnectionHandler::joinThread ()
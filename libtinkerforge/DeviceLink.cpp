@@ -0,0 +1,254 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define IPCON_EXPOSE_INTERNALS
+
+#include <tinkerforge/DeviceLink.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+
+namespace tinkerforge {
+
+  // A response callback is kept in a slot of the device until its response
+  // arrived, so sending a request doesn't allocate. More requests than
+  // sequence numbers can't be in flight, the slots of completed ones might
+  // still be in use by the callback threads though.
+  struct DeviceLink::Completion
+  {
+      RawResponse               response;
+      std::shared_ptr<Liveness> liveness; // keeps the slots alive while the request is in flight
+  };
+
+  struct DeviceLink::Liveness
+  {
+      std::mutex              mutex;
+      std::condition_variable condition;
+      bool                    attached {true};
+      unsigned                running  {0}; // responses that are handled right now
+
+      std::array<Completion, 2 * IPCON_NUM_SEQUENCE_NUMBERS> completions;
+      uint32_t                                               used {0}; // a bit per completion, protected by the mutex
+  };
+
+  static_assert(2 * IPCON_NUM_SEQUENCE_NUMBERS <= 32, "a bit per completion");
+
+static void dispatchCallback(DevicePrivate* device_p, Packet* packet)
+{
+    auto callback = static_cast<DeviceLink::RawCallback*>(
+        device_p->registered_callbacks[DEVICE_NUM_FUNCTION_IDS + packet->header.function_id]);
+
+    if (callback)
+    {
+        (*callback)(reinterpret_cast<const uint8_t*>(packet));
+    }
+}
+
+void completeResponse(void* userData, int errorCode, const uint8_t* packet)
+{
+    auto completion = static_cast<DeviceLink::Completion*>(userData);
+
+    // released after the lock below, it might be the last reference
+    std::shared_ptr<DeviceLink::Liveness> liveness = std::move(completion->liveness);
+    bool attached;
+
+    {
+        std::lock_guard<std::mutex> lock(liveness->mutex);
+
+        attached = liveness->attached;
+        if (attached) { ++liveness->running; }
+    }
+
+    if (attached)
+    {
+        completion->response(errorCode, packet);
+    }
+
+    std::lock_guard<std::mutex> lock(liveness->mutex);
+
+    completion->response = nullptr;
+    liveness->used &= ~(1u << (completion - liveness->completions.data()));
+
+    if (attached)
+    {
+        --liveness->running;
+        liveness->condition.notify_all();
+    }
+}
+
+static void dispatchResponse(int errorCode, Packet* response, void*, void* userData)
+{
+    // A short response decodes as zeros instead of reading past its end.
+    Packet packet;
+    std::memset(&packet, 0, sizeof(packet));
+
+    if (response)
+    {
+        std::memcpy(&packet, response, std::min<size_t>(response->header.length, sizeof(packet)));
+    }
+
+    completeResponse(userData, errorCode, reinterpret_cast<const uint8_t*>(&packet));
+}
+
+  DeviceLink::DeviceLink (const char* uid, IPConnection* ipcon, std::array<uint8_t, 3> apiVersion)
+      : m_liveness(std::make_shared<Liveness>())
+  {
+    device_create(&m_device, uid, ipcon->p, apiVersion[0], apiVersion[1], apiVersion[2]);
+  }
+
+  DeviceLink::~DeviceLink ()
+  {
+    detach();
+    device_release(m_device.p);
+  }
+
+  void DeviceLink::detach ()
+  {
+    // the callbacks are called by the callback thread of the device, which
+    // is not necessarily the calling one
+    device_stop_callbacks(m_device.p);
+
+    std::unique_lock<std::mutex> lock(m_liveness->mutex);
+
+    m_liveness->attached = false;
+    m_liveness->condition.wait(lock, [this] { return m_liveness->running == 0; });
+  }
+
+  Device* DeviceLink::getDevice ()
+  {
+    return &m_device;
+  }
+
+  void DeviceLink::declareFunction (uint8_t functionId, bool isGetter, bool responseExpected)
+  {
+    m_device.p->response_expected[functionId] = isGetter ? DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE
+                                              : responseExpected ? DEVICE_RESPONSE_EXPECTED_TRUE
+                                                                 : DEVICE_RESPONSE_EXPECTED_FALSE;
+  }
+
+  int DeviceLink::send (uint8_t* request, uint8_t functionId, uint8_t length, uint8_t* response, uint8_t responseLength)
+  {
+    DevicePrivate* device_p = m_device.p;
+    const int ret = packet_header_create(reinterpret_cast<PacketHeader*>(request), length, functionId,
+                                         device_p->ipcon_p, device_p);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (response == nullptr)
+    {
+        return device_send_request(device_p, reinterpret_cast<Packet*>(request), nullptr);
+    }
+
+    Packet packet;
+    std::memset(&packet, 0, sizeof(packet));
+
+    const int result = device_send_request(device_p, reinterpret_cast<Packet*>(request), &packet);
+
+    if (result == E_OK)
+    {
+        std::memcpy(response, &packet, responseLength);
+    }
+
+    return result;
+  }
+
+  int DeviceLink::sendConfirmed (uint8_t* request, uint8_t functionId, uint8_t length)
+  {
+    DevicePrivate* device_p = m_device.p;
+    const int ret = packet_header_create(reinterpret_cast<PacketHeader*>(request), length, functionId,
+                                         device_p->ipcon_p, device_p);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    packet_header_set_response_expected(reinterpret_cast<PacketHeader*>(request), 1);
+
+    return device_send_request(device_p, reinterpret_cast<Packet*>(request), nullptr);
+  }
+
+  int DeviceLink::sendAsync (uint8_t* request, uint8_t functionId, uint8_t length, RawResponse response)
+  {
+    DevicePrivate* device_p = m_device.p;
+    const int ret = packet_header_create(reinterpret_cast<PacketHeader*>(request), length, functionId,
+                                         device_p->ipcon_p, device_p);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    Completion* completion = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_liveness->mutex);
+
+        for (size_t index = 0; index < m_liveness->completions.size(); ++index)
+        {
+            if ((m_liveness->used & (1u << index)) == 0)
+            {
+                m_liveness->used |= 1u << index;
+                completion = &m_liveness->completions[index];
+                break;
+            }
+        }
+    }
+
+    if (completion == nullptr)
+    {
+        return E_WOULD_BLOCK;
+    }
+
+    // a response can arrive after the owner of the callback is gone, the
+    // liveness outlives both
+    completion->response = std::move(response);
+    completion->liveness = m_liveness;
+
+    const int result = device_send_request_async(device_p, reinterpret_cast<Packet*>(request),
+                                                 dispatchResponse, nullptr, completion);
+
+    if (result < 0)
+    {
+        completion->liveness = nullptr;
+
+        std::lock_guard<std::mutex> lock(m_liveness->mutex);
+
+        completion->response = nullptr;
+        m_liveness->used &= ~(1u << (completion - m_liveness->completions.data()));
+    }
+
+    return result;
+  }
+
+  void DeviceLink::registerRawCallback (uint8_t callbackId, RawCallback callback)
+  {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+
+    m_callbacks.push_back(std::unique_ptr<RawCallback>(new RawCallback(std::move(callback))));
+
+    m_device.p->callback_wrappers[callbackId] = dispatchCallback;
+    device_register_callback(m_device.p, callbackId, m_callbacks.back().get(), nullptr);
+  }
+
+} /* namespace tinkerforge */
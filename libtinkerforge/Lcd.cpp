@@ -23,11 +23,42 @@
 
 namespace tinkerforge {
 
+  namespace {
+
+    // LCD 20x4 Bricklet, API version 2.0.0
+    struct Protocol
+    {
+      using WriteLine             = codec::Function<1, void(uint8_t, uint8_t, codec::String<20>), false>;
+      using ClearDisplay          = codec::Function<2, void(), false>;
+      using BacklightOn           = codec::Function<3, void(), false>;
+      using BacklightOff          = codec::Function<4, void(), false>;
+      using IsBacklightOn         = codec::Function<5, bool()>;
+      using SetConfig             = codec::Function<6, void(bool, bool), false>;
+      using GetConfig             = codec::Function<7, std::tuple<bool, bool>()>;
+      using IsButtonPressed       = codec::Function<8, bool(uint8_t)>;
+      using SetCustomCharacter    = codec::Function<11, void(uint8_t, std::array<uint8_t, 8>), false>;
+      using GetCustomCharacter    = codec::Function<12, std::array<uint8_t, 8>(uint8_t)>;
+      using SetDefaultText        = codec::Function<13, void(uint8_t, codec::String<20>), false>;
+      using GetDefaultText        = codec::Function<14, codec::String<20>(uint8_t)>;
+      using SetDefaultTextCounter = codec::Function<15, void(int32_t), false>;
+      using GetDefaultTextCounter = codec::Function<16, int32_t()>;
+
+      using ButtonPressed  = codec::Callback<9, uint8_t>;
+      using ButtonReleased = codec::Callback<10, uint8_t>;
+
+      using Functions = codec::FunctionList<WriteLine, ClearDisplay, BacklightOn, BacklightOff, IsBacklightOn,
+                                            SetConfig, GetConfig, IsButtonPressed,
+                                            SetCustomCharacter, GetCustomCharacter,
+                                            SetDefaultText, GetDefaultText,
+                                            SetDefaultTextCounter, GetDefaultTextCounter, codec::GetIdentity>;
+    };
+
+  } /* namespace */
+
   Lcd::Lcd(const char* uid, ConnectionHandler &connection, bool statusbar)
       : Bricklet(uid)
   {
-    m_lcd = new LCD20x4();
-    lcd_20x4_create(m_lcd, uid, connection.getConnection());
+    m_lcd = new DeviceLink(uid, connection.getConnection(), {{2, 0, 0}}, Protocol::Functions());
 
     if (statusbar)
       {
@@ -51,21 +82,21 @@ namespace tinkerforge {
   }
 
   Device* Lcd::getDevice() const {
-    return m_lcd;
+    return m_lcd->getDevice();
   }
 
   int Lcd::setBacklight(const bool backlight) {
-    bool backlightOn;
-    lcd_20x4_is_backlight_on(m_lcd, &backlightOn);
+    bool backlightOn = false;
+    m_lcd->get<Protocol::IsBacklightOn>(backlightOn);
 
     int success = true;
     if (!backlight && backlightOn)
       {
-        success = lcd_20x4_backlight_off(m_lcd);
+        success = m_lcd->call<Protocol::BacklightOff>();
       }
     else if (backlight && !backlightOn)
       {
-        success = lcd_20x4_backlight_on(m_lcd);
+        success = m_lcd->call<Protocol::BacklightOn>();
       }
 
     return success;
@@ -92,14 +123,16 @@ namespace tinkerforge {
   }
 
   int Lcd::writeLine(uint8_t line, uint8_t position, const char *text) {
-    return lcd_20x4_write_line(m_lcd, line, position, text);
+    return m_lcd->call<Protocol::WriteLine>(line, position, codec::String<20>(text));
   }
 
   int Lcd::writeStatusbar(uint8_t position, char symbol) {
     if (m_statusbar == 0) return -11;
 
     m_statusbar[position] = symbol;
-    return lcd_20x4_write_line(m_lcd, position, m_linewidth, &symbol);
+
+    const char text[2] = {symbol, '\0'};
+    return writeLine(position, m_linewidth, text);
   }
 
   int Lcd::writeTextToLine(uint8_t line, const std::string text) {
@@ -111,7 +144,7 @@ namespace tinkerforge {
   }
 
   int Lcd::clearDisplay(bool preserveStatusbar) {
-    int returnValue = lcd_20x4_clear_display(m_lcd);
+    int returnValue = m_lcd->call<Protocol::ClearDisplay>();
 
     if (preserveStatusbar && m_statusbar != 0)
       {
@@ -0,0 +1,213 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <tinkerforge/SampleHistory.h>
+
+namespace tinkerforge {
+
+namespace {
+
+  template<typename Clock>
+  int64_t toNanoseconds (typename Clock::time_point time)
+  {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+  }
+
+  template<typename Clock>
+  typename Clock::time_point fromNanoseconds (int64_t nanoseconds)
+  {
+      return typename Clock::time_point(std::chrono::duration_cast<typename Clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+  }
+
+} // namespace
+
+  SampleHistory::SampleHistory (std::size_t capacity, std::chrono::milliseconds window)
+      : m_capacity(capacity > 0 ? capacity : 1)
+      , m_window(window)
+      , m_slots(new Slot[m_capacity])
+  {
+    m_minimum.indices.reset(new uint64_t[m_capacity]);
+    m_maximum.indices.reset(new uint64_t[m_capacity]);
+  }
+
+  std::size_t SampleHistory::capacity () const
+  {
+    return m_capacity;
+  }
+
+  std::chrono::milliseconds SampleHistory::window () const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(m_window);
+  }
+
+  void SampleHistory::push (const SampleTime& time, int32_t value)
+  {
+    const uint64_t index = m_written.load(std::memory_order_relaxed);
+
+    // the slot is taken over from the oldest sample, which has to leave the
+    // window before it is gone
+    if (index >= m_capacity && m_windowBegin <= index - m_capacity) { evict(m_windowBegin); }
+
+    Slot& written = slot(index);
+    written.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    written.received.store(toNanoseconds<std::chrono::steady_clock>(time.received), std::memory_order_relaxed);
+    written.wallClock.store(toNanoseconds<std::chrono::system_clock>(time.wallClock), std::memory_order_relaxed);
+    written.value.store(value, std::memory_order_relaxed);
+    written.sequence.store(2 * index + 2, std::memory_order_release);
+
+    m_written.store(index + 1, std::memory_order_release);
+
+    m_windowSum += value;
+    add(m_minimum, index, value, true);
+    add(m_maximum, index, value, false);
+
+    const int64_t windowStart = toNanoseconds<std::chrono::steady_clock>(time.received) - m_window.count();
+    while (m_windowBegin < index && slot(m_windowBegin).received.load(std::memory_order_relaxed) < windowStart)
+    {
+        evict(m_windowBegin);
+    }
+
+    publishAggregate(time);
+  }
+
+  std::size_t SampleHistory::snapshot (Sample* samples, std::size_t maximum) const
+  {
+    const uint64_t written = m_written.load(std::memory_order_acquire);
+    std::size_t count = 0;
+
+    for (uint64_t index = written; index > 0 && count < maximum && written - index < m_capacity; )
+    {
+        --index;
+
+        const Slot& read = slot(index);
+        const uint64_t sequence = read.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) { break; } // overwritten already, so are all older ones
+
+        const int64_t received = read.received.load(std::memory_order_relaxed);
+        const int64_t wallClock = read.wallClock.load(std::memory_order_relaxed);
+        const int32_t value = read.value.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (read.sequence.load(std::memory_order_relaxed) != sequence) { break; }
+
+        samples[count++] = Sample{SampleTime{fromNanoseconds<std::chrono::steady_clock>(received),
+                                             fromNanoseconds<std::chrono::system_clock>(wallClock)},
+                                  value};
+    }
+
+    return count;
+  }
+
+  bool SampleHistory::aggregate (Aggregate& aggregate) const
+  {
+    uint64_t sequence;
+    uint64_t count;
+    int32_t minimum;
+    int32_t maximum;
+    int64_t sum;
+    int64_t received;
+    int64_t wallClock;
+
+    do
+    {
+        sequence = m_aggregateSequence.load(std::memory_order_acquire);
+        if (sequence == 0) { return false; }
+        if (sequence % 2 != 0) { continue; }
+
+        count = m_aggregateCount.load(std::memory_order_relaxed);
+        minimum = m_aggregateMinimum.load(std::memory_order_relaxed);
+        maximum = m_aggregateMaximum.load(std::memory_order_relaxed);
+        sum = m_aggregateSum.load(std::memory_order_relaxed);
+        received = m_aggregateReceived.load(std::memory_order_relaxed);
+        wallClock = m_aggregateWallClock.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (sequence % 2 != 0 || m_aggregateSequence.load(std::memory_order_relaxed) != sequence);
+
+    aggregate.count = static_cast<std::size_t>(count);
+    aggregate.minimum = minimum;
+    aggregate.maximum = maximum;
+    aggregate.mean = static_cast<double>(sum) / static_cast<double>(count);
+    aggregate.newest = SampleTime{fromNanoseconds<std::chrono::steady_clock>(received),
+                                  fromNanoseconds<std::chrono::system_clock>(wallClock)};
+    return true;
+  }
+
+  SampleHistory::Slot& SampleHistory::slot (uint64_t index) const
+  {
+    return m_slots[index % m_capacity];
+  }
+
+  int32_t SampleHistory::writtenValue (uint64_t index) const
+  {
+    return slot(index).value.load(std::memory_order_relaxed);
+  }
+
+  // The candidates are a queue of increasing values for the minimum and of
+  // decreasing values for the maximum, the front is the extreme of the
+  // window. A new sample drops all candidates it beats, they are older and
+  // can never become the extreme anymore. Every sample enters and leaves the
+  // queue at most once.
+  void SampleHistory::add (Candidates& candidates, uint64_t index, int32_t value, bool minimum)
+  {
+    while (candidates.back > candidates.front)
+    {
+        const int32_t last = writtenValue(candidates.indices[(candidates.back - 1) % m_capacity]);
+        if (minimum ? last < value : last > value) { break; }
+        --candidates.back;
+    }
+
+    candidates.indices[candidates.back % m_capacity] = index;
+    ++candidates.back;
+  }
+
+  void SampleHistory::evict (uint64_t index)
+  {
+    m_windowSum -= writtenValue(index);
+
+    for (Candidates* candidates : {&m_minimum, &m_maximum})
+    {
+        if (candidates->back > candidates->front && candidates->indices[candidates->front % m_capacity] == index)
+        {
+            ++candidates->front;
+        }
+    }
+
+    ++m_windowBegin;
+  }
+
+  void SampleHistory::publishAggregate (const SampleTime& newest)
+  {
+    const uint64_t sequence = m_aggregateSequence.load(std::memory_order_relaxed);
+
+    m_aggregateSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_aggregateCount.store(m_written.load(std::memory_order_relaxed) - m_windowBegin, std::memory_order_relaxed);
+    m_aggregateMinimum.store(writtenValue(m_minimum.indices[m_minimum.front % m_capacity]), std::memory_order_relaxed);
+    m_aggregateMaximum.store(writtenValue(m_maximum.indices[m_maximum.front % m_capacity]), std::memory_order_relaxed);
+    m_aggregateSum.store(m_windowSum, std::memory_order_relaxed);
+    m_aggregateReceived.store(toNanoseconds<std::chrono::steady_clock>(newest.received), std::memory_order_relaxed);
+    m_aggregateWallClock.store(toNanoseconds<std::chrono::system_clock>(newest.wallClock), std::memory_order_relaxed);
+
+    m_aggregateSequence.store(sequence + 2, std::memory_order_release);
+  }
+
+} /* namespace tinkerforge */
@@ -0,0 +1,55 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <tinkerforge/SensorEvent.h>
+
+namespace tinkerforge {
+
+  SampleTime SampleTime::now()
+  {
+    return SampleTime{std::chrono::steady_clock::now(), std::chrono::system_clock::now()};
+  }
+
+  const char* sensorKindName(SensorKind kind)
+  {
+    switch (kind)
+    {
+    case SensorKind::Temperature:  return "temperature";
+    case SensorKind::Humidity:     return "humidity";
+    case SensorKind::AmbientLight: return "ambient-light";
+    case SensorKind::Distance:     return "distance";
+    }
+
+    return "unknown";
+  }
+
+  const char* sensorKindUnit(SensorKind kind)
+  {
+    switch (kind)
+    {
+    case SensorKind::Temperature:  return "°C";
+    case SensorKind::Humidity:     return "%RH";
+    case SensorKind::AmbientLight: return "lx";
+    case SensorKind::Distance:     return "mm";
+    }
+
+    return "";
+  }
+
+} /* namespace tinkerforge */
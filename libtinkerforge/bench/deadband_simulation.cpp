@@ -0,0 +1,161 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Simulates the adaptive deadband against Gaussian noise around a constant
+// and around a slow ramp, with a fixed seed, and compares the number of
+// reported values and the largest error with the fixed tolerance of 10.
+// Fails if the deadband doesn't suppress the noise of noisy sensors or
+// doesn't resolve small changes of quiet ones.
+
+#include <tinkerforge/Sensor.h>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using tinkerforge::Deadband;
+
+namespace {
+
+constexpr int SAMPLES = 200000;
+constexpr double FACTOR = 3.0;
+constexpr int32_t TOLERANCE = 10;
+constexpr int32_t MAX_DEADBAND = 16 * TOLERANCE;
+
+struct Result {
+    int     messages;
+    int32_t width;
+    double  maxError;
+};
+
+// A threshold sensor: the device reports a value once it left the band
+// around the last reported one, the band is re-armed at the deadband.
+Result simulateThreshold (double sigma, double drift, bool adaptive)
+{
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, sigma);
+    Deadband deadband(adaptive ? FACTOR : 0.0, MAX_DEADBAND);
+    Result result {0, adaptive ? deadband.width() : TOLERANCE, 0.0};
+    double truth = 0.0;
+    int32_t last = 0;
+    bool hasValue = false;
+
+    for (int i = 0; i < SAMPLES; ++i)
+    {
+        truth += drift;
+        const int32_t value = static_cast<int32_t>(std::lround(truth + noise(random)));
+
+        if (!hasValue || std::abs(value - last) > result.width)
+        {
+            if (hasValue && adaptive)
+            {
+                deadband.crossed(std::abs(value - last));
+                result.width = deadband.width();
+            }
+            last = value;
+            hasValue = true;
+            ++result.messages;
+        }
+
+        result.maxError = std::max(result.maxError, std::abs(last - truth));
+    }
+
+    return result;
+}
+
+// A periodic sensor: every value arrives on the host, which reports it if
+// it left the deadband around the last reported one.
+Result simulatePeriod (double sigma, double drift)
+{
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, sigma);
+    Deadband deadband(FACTOR, MAX_DEADBAND);
+    Result result {0, 0, 0.0};
+    double truth = 0.0;
+    int32_t last = 0;
+    int32_t lastSample = 0;
+
+    for (int i = 0; i < SAMPLES; ++i)
+    {
+        truth += drift;
+        const int32_t value = static_cast<int32_t>(std::lround(truth + noise(random)));
+
+        if (i > 0) { deadband.sampled(value - lastSample); }
+        lastSample = value;
+
+        if (i == 0 || std::abs(value - last) > deadband.width())
+        {
+            last = value;
+            ++result.messages;
+        }
+
+        result.maxError = std::max(result.maxError, std::abs(last - truth));
+    }
+
+    result.width = deadband.width();
+    return result;
+}
+
+} // namespace
+
+int main ()
+{
+    bool passed = true;
+
+    std::printf("%-12s %7s %10s %10s %10s %10s %8s\n", "noise", "drift", "fixed msgs", "msgs", "width", "max error", "period");
+
+    for (const double sigma : {0.5, 2.0, 5.0, 20.0})
+    {
+        for (const double drift : {0.0, 0.01})
+        {
+            const Result fixed = simulateThreshold(sigma, drift, false);
+            const Result adaptive = simulateThreshold(sigma, drift, true);
+            const Result period = simulatePeriod(sigma, drift);
+
+            std::printf("sigma %-6.1f %7.2f %10d %10d %10d %10.1f %8d\n", sigma, drift,
+                        fixed.messages, adaptive.messages, adaptive.width, adaptive.maxError, period.messages);
+
+            // the deadband follows the noise, the estimate from the overshoot
+            // is rough for bands of a few noise deviations and integer values
+            const double expected = FACTOR * sigma;
+            if (drift == 0.0 && (adaptive.width > 2 * expected + 2 || adaptive.width < expected / 2))
+            {
+                std::printf("  FAILED: width %d is not about %.1f\n", adaptive.width, expected);
+                passed = false;
+            }
+
+            // quiet sensors resolve changes below the fixed tolerance
+            if (sigma < 1.0 && adaptive.width >= TOLERANCE)
+            {
+                std::printf("  FAILED: width %d is not below %d\n", adaptive.width, TOLERANCE);
+                passed = false;
+            }
+
+            // noisy ones stop reporting their noise
+
+            if (sigma >= 5.0 && adaptive.messages * 10 > fixed.messages)
+            {
+                std::printf("  FAILED: %d messages are not a tenth of %d\n", adaptive.messages, fixed.messages);
+                passed = false;
+            }
+        }
+    }
+
+    return passed ? 0 : 1;
+}
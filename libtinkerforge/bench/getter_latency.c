@@ -0,0 +1,203 @@
+/*
+ * Benchmark of the getter latency with and without low latency completion
+ *
+ * Calls the temperature getter of the first Temperature Bricklet that
+ * enumerates, alternating between the Event based and the low latency
+ * completion in several rounds, and reports p50, p99 and maximum of both.
+ * Use the brick daemon emulator as responder:
+ *
+ *   brickd-emulator -q -p 4229 --temperature 1 &
+ *   taskset -c 0-3 getter_latency localhost 4229
+ *
+ * The low latency mode only spins on more than one CPU, on a single CPU both
+ * modes are expected to be equal.
+ *
+ * Usage: getter_latency [host] [port] [samples] [threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ip_connection.h"
+#include "bricklet_temperature.h"
+
+#define ROUNDS 5
+#define MAX_THREADS 16
+
+typedef struct {
+	Temperature *temperature;
+	uint32_t *latencies; // in usec
+	int count;
+	int errors;
+	pthread_t thread;
+} Caller;
+
+static char temperature_uid[8];
+
+static uint32_t get_usec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static void enumerate_callback(const char *uid, const char *connected_uid,
+                               char position, uint8_t hardware_version[3],
+                               uint8_t firmware_version[3], uint16_t device_identifier,
+                               uint8_t enumeration_type, void *user_data) {
+	(void)connected_uid; (void)position; (void)hardware_version;
+	(void)firmware_version; (void)user_data;
+
+	if (device_identifier == TEMPERATURE_DEVICE_IDENTIFIER &&
+	    enumeration_type != IPCON_ENUMERATION_TYPE_DISCONNECTED &&
+	    temperature_uid[0] == '\0') {
+		strncpy(temperature_uid, uid, sizeof(temperature_uid) - 1);
+	}
+}
+
+static void *caller_loop(void *opaque) {
+	Caller *caller = (Caller *)opaque;
+	int16_t value;
+	uint32_t start;
+	int i;
+
+	for (i = 0; i < caller->count; ++i) {
+		start = get_usec();
+
+		if (temperature_get_temperature(caller->temperature, &value) < 0) {
+			++caller->errors;
+		}
+
+		caller->latencies[i] = get_usec() - start;
+	}
+
+	return NULL;
+}
+
+static int compare_latency(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// returns the number of errors, appends the latencies of all callers
+static int run(Temperature *temperature, int thread_count, int count, uint32_t *latencies) {
+	Caller callers[MAX_THREADS];
+	int errors = 0;
+	int i;
+
+	for (i = 0; i < thread_count; ++i) {
+		callers[i].temperature = temperature;
+		callers[i].latencies = latencies + i * count;
+		callers[i].count = count;
+		callers[i].errors = 0;
+
+		pthread_create(&callers[i].thread, NULL, caller_loop, &callers[i]);
+	}
+
+	for (i = 0; i < thread_count; ++i) {
+		pthread_join(callers[i].thread, NULL);
+
+		errors += callers[i].errors;
+	}
+
+	return errors;
+}
+
+int main(int argc, char **argv) {
+	const char *host = argc > 1 ? argv[1] : "localhost";
+	int port = argc > 2 ? atoi(argv[2]) : 4223;
+	int samples = argc > 3 ? atoi(argv[3]) : 20000;
+	int thread_count = argc > 4 ? atoi(argv[4]) : 1;
+	int per_round = samples / ROUNDS / (thread_count > 0 ? thread_count : 1);
+	int total = per_round * thread_count * ROUNDS;
+	uint32_t *latencies[2];
+	int errors[2] = {0, 0};
+	IPConnection ipcon;
+	Temperature temperature;
+	int16_t value;
+	int round;
+	int mode;
+	int i;
+
+	if (thread_count < 1 || thread_count > MAX_THREADS || per_round < 1) {
+		fprintf(stderr, "samples must be at least %d times the threads, threads between 1 and %d\n",
+		        ROUNDS, MAX_THREADS);
+
+		return 1;
+	}
+
+	ipcon_create(&ipcon);
+	ipcon_register_callback(&ipcon, IPCON_CALLBACK_ENUMERATE,
+	                        (void *)enumerate_callback, NULL);
+
+	if (ipcon_connect(&ipcon, host, (uint16_t)port) < 0) {
+		fprintf(stderr, "could not connect to %s:%d\n", host, port);
+
+		return 1;
+	}
+
+	ipcon_enumerate(&ipcon);
+
+	for (i = 0; i < 200 && temperature_uid[0] == '\0'; ++i) {
+		usleep(10000);
+	}
+
+	if (temperature_uid[0] == '\0') {
+		fprintf(stderr, "no Temperature Bricklet enumerated\n");
+
+		return 1;
+	}
+
+	if (ipcon_set_low_latency(&ipcon, true) < 0) {
+		fprintf(stderr, "low latency completion is not supported on this platform\n");
+
+		return 1;
+	}
+
+	temperature_create(&temperature, temperature_uid, &ipcon);
+
+	latencies[0] = (uint32_t *)malloc(sizeof(uint32_t) * total);
+	latencies[1] = (uint32_t *)malloc(sizeof(uint32_t) * total);
+
+	// warm up the connection and the spin time estimate
+	for (i = 0; i < 1000; ++i) {
+		temperature_get_temperature(&temperature, &value);
+	}
+
+	// alternate the modes, so that both see the same background load
+	for (round = 0; round < ROUNDS; ++round) {
+		for (mode = 0; mode < 2; ++mode) {
+			ipcon_set_low_latency(&ipcon, mode == 1);
+
+			errors[mode] += run(&temperature, thread_count, per_round,
+			                    latencies[mode] + round * per_round * thread_count);
+		}
+	}
+
+	printf("%ld CPUs, %d threads, %d getters per mode, Temperature Bricklet %s\n",
+	       sysconf(_SC_NPROCESSORS_ONLN), thread_count, total, temperature_uid);
+	printf("%-12s %10s %10s %10s %8s   (usec)\n", "mode", "p50", "p99", "max", "errors");
+
+	for (mode = 0; mode < 2; ++mode) {
+		qsort(latencies[mode], total, sizeof(uint32_t), compare_latency);
+
+		printf("%-12s %10u %10u %10u %8d\n", mode == 1 ? "low latency" : "event",
+		       latencies[mode][total / 2], latencies[mode][(int)(total * 0.99)],
+		       latencies[mode][total - 1], errors[mode]);
+	}
+
+	free(latencies[0]);
+	free(latencies[1]);
+
+	temperature_destroy(&temperature);
+	ipcon_destroy(&ipcon);
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Microbenchmark of the device table lookup for 1 to 10,000 devices
+ *
+ * Compares the lock-free hash table of the IP Connection with the mutex
+ * protected linear table it replaced, from one thread and from several
+ * threads looking up concurrently, like callback workers do.
+ *
+ * Usage: table_lookup [threads]
+ */
+
+// the table is internal to the IP Connection
+#include "../bindings/ip_connection.c"
+
+#define LOOKUPS_PER_RUN 2000000
+
+typedef struct {
+	Mutex mutex;
+	uint32_t *keys;
+	void **values;
+	int used;
+} LinearTable;
+
+typedef struct {
+	bool linear;
+	void *table;
+	uint32_t *keys;
+	int count;
+	int lookups;
+	uint64_t misses;
+	Thread thread;
+} Reader;
+
+static void *linear_table_get(LinearTable *table, uint32_t key) {
+	void *value = NULL;
+	int i;
+
+	mutex_lock(&table->mutex);
+
+	for (i = 0; i < table->used; ++i) {
+		if (table->keys[i] == key) {
+			value = table->values[i];
+
+			break;
+		}
+	}
+
+	mutex_unlock(&table->mutex);
+
+	return value;
+}
+
+static void reader_loop(void *opaque) {
+	Reader *reader = (Reader *)opaque;
+	uint32_t key;
+	uint32_t epoch;
+	int i;
+
+	for (i = 0; i < reader->lookups; ++i) {
+		key = reader->keys[(uint32_t)i * 2654435761U % (uint32_t)reader->count];
+
+		if (reader->linear) {
+			if (linear_table_get((LinearTable *)reader->table, key) == NULL) {
+				++reader->misses;
+			}
+		} else {
+			epoch = table_read_lock((Table *)reader->table);
+
+			if (table_get((Table *)reader->table, key) == NULL) {
+				++reader->misses;
+			}
+
+			table_read_unlock((Table *)reader->table, epoch);
+		}
+	}
+}
+
+// returns the average time of a lookup in nsec
+static double run(bool linear, void *table, uint32_t *keys, int count, int thread_count) {
+	Reader readers[IPCON_MAX_CALLBACK_WORKERS];
+	uint64_t start;
+	uint64_t misses = 0;
+	int lookups = LOOKUPS_PER_RUN / thread_count;
+	int i;
+
+	// the linear table gets expensive, don't wait minutes for it
+	if (linear && count > 100) {
+		lookups /= count / 100;
+	}
+
+	start = get_monotonic_usec();
+
+	for (i = 0; i < thread_count; ++i) {
+		readers[i].linear = linear;
+		readers[i].table = table;
+		readers[i].keys = keys;
+		readers[i].count = count;
+		readers[i].lookups = lookups;
+		readers[i].misses = 0;
+
+		thread_create(&readers[i].thread, reader_loop, &readers[i]);
+	}
+
+	for (i = 0; i < thread_count; ++i) {
+		thread_join(&readers[i].thread);
+		thread_destroy(&readers[i].thread);
+
+		misses += readers[i].misses;
+	}
+
+	if (misses > 0) {
+		fprintf(stderr, "%llu lookups failed\n", (unsigned long long)misses);
+		exit(1);
+	}
+
+	// the threads run in parallel, report the time of a lookup as seen by one
+	return (double)(get_monotonic_usec() - start) * 1000.0 / lookups;
+}
+
+int main(int argc, char **argv) {
+	static const int counts[] = {1, 10, 100, 1000, 10000};
+	int thread_count = argc > 1 ? atoi(argv[1]) : 4;
+	uint32_t *keys;
+	uint32_t seed = 1;
+	Table table;
+	LinearTable linear;
+	int c;
+	int i;
+
+	if (thread_count < 1 || thread_count > IPCON_MAX_CALLBACK_WORKERS) {
+		fprintf(stderr, "threads must be between 1 and %d\n", IPCON_MAX_CALLBACK_WORKERS);
+
+		return 1;
+	}
+
+	printf("%8s %14s %14s %14s %14s   (ns per lookup)\n", "devices", "hash", "linear",
+	       "hash xN", "linear xN");
+
+	for (c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); ++c) {
+		keys = (uint32_t *)malloc(sizeof(uint32_t) * counts[c]);
+
+		table_create(&table);
+
+		mutex_create(&linear.mutex);
+		linear.keys = (uint32_t *)malloc(sizeof(uint32_t) * counts[c]);
+		linear.values = (void **)malloc(sizeof(void *) * counts[c]);
+		linear.used = 0;
+
+		// UIDs are random 32 bit numbers, 0 is never used
+		for (i = 0; i < counts[c]; ++i) {
+			do {
+				seed = seed * 1103515245U + 12345U;
+				keys[i] = seed ^ (seed >> 15);
+			} while (keys[i] == 0);
+
+			table_insert(&table, keys[i], &keys[i]);
+
+			linear.keys[linear.used] = keys[i];
+			linear.values[linear.used] = &keys[i];
+			++linear.used;
+		}
+
+		printf("%8d %14.1f %14.1f %14.1f %14.1f\n", counts[c],
+		       run(false, &table, keys, counts[c], 1),
+		       run(true, &linear, keys, counts[c], 1),
+		       run(false, &table, keys, counts[c], thread_count),
+		       run(true, &linear, keys, counts[c], thread_count));
+
+		free(linear.values);
+		free(linear.keys);
+		mutex_destroy(&linear.mutex);
+
+		table_destroy(&table);
+
+		free(keys);
+	}
+
+	printf("xN: %d threads looking up concurrently\n", thread_count);
+
+	return 0;
+}
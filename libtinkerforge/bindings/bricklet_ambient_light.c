@@ -29,6 +29,8 @@ typedef void (*IlluminanceReached_CallbackFunction)(uint16_t illuminance, void *
 
 typedef void (*AnalogValueReached_CallbackFunction)(uint16_t value, void *user_data);
 
+typedef void (*GetIlluminanceAsync_ResponseFunction)(int error_code, uint16_t illuminance, void *user_data);
+
 #if defined _MSC_VER || defined __BORLANDC__
 	#pragma pack(push)
 	#pragma pack(1)
@@ -319,6 +321,34 @@ int ambient_light_get_illuminance(AmbientLight *ambient_light, uint16_t *ret_ill
 	return ret;
 }
 
+static void ambient_light_get_illuminance_async_wrapper(int error_code, Packet *packet, void *function, void *user_data) {
+	GetIlluminanceAsync_ResponseFunction response_function;
+	GetIlluminance_Response *response = (GetIlluminance_Response *)packet;
+	uint16_t illuminance = 0;
+
+	*(void **)(&response_function) = function;
+
+	if (error_code == E_OK) {
+		illuminance = leconvert_uint16_from(response->illuminance);
+	}
+
+	response_function(error_code, illuminance, user_data);
+}
+
+int ambient_light_get_illuminance_async(AmbientLight *ambient_light, void *function, void *user_data) {
+	DevicePrivate *device_p = ambient_light->p;
+	GetIlluminance_Request request;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), AMBIENT_LIGHT_FUNCTION_GET_ILLUMINANCE, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	return device_send_request_async(device_p, (Packet *)&request, ambient_light_get_illuminance_async_wrapper, function, user_data);
+}
+
 int ambient_light_get_analog_value(AmbientLight *ambient_light, uint16_t *ret_value) {
 	DevicePrivate *device_p = ambient_light->p;
 	GetAnalogValue_Request request;
@@ -283,6 +283,23 @@ int ambient_light_get_api_version(AmbientLight *ambient_light, uint8_t ret_api_v
  */
 int ambient_light_get_illuminance(AmbientLight *ambient_light, uint16_t *ret_illuminance);
 
+/**
+ * \ingroup BrickletAmbientLight
+ *
+ * Requests the illuminance like ambient_light_get_illuminance, but returns without waiting
+ * for the response. The \c function is called with the signature
+ *
+ * \code
+ * void function(int error_code, uint16_t illuminance, void *user_data)
+ * \endcode
+ *
+ * from the callback thread of the device once the response arrived, or with
+ * E_TIMEOUT if no response arrived in time. Like a callback it can call other
+ * functions of the device. Returns E_WOULD_BLOCK if the IP Connection already
+ * has the maximum number of requests in flight.
+ */
+int ambient_light_get_illuminance_async(AmbientLight *ambient_light, void *function, void *user_data);
+
 /**
  * \ingroup BrickletAmbientLight
  *
@@ -29,6 +29,8 @@ typedef void (*DistanceReached_CallbackFunction)(uint16_t distance, void *user_d
 
 typedef void (*AnalogValueReached_CallbackFunction)(uint16_t value, void *user_data);
 
+typedef void (*GetDistanceAsync_ResponseFunction)(int error_code, uint16_t distance, void *user_data);
+
 #if defined _MSC_VER || defined __BORLANDC__
 	#pragma pack(push)
 	#pragma pack(1)
@@ -337,6 +339,34 @@ int distance_ir_get_distance(DistanceIR *distance_ir, uint16_t *ret_distance) {
 	return ret;
 }
 
+static void distance_ir_get_distance_async_wrapper(int error_code, Packet *packet, void *function, void *user_data) {
+	GetDistanceAsync_ResponseFunction response_function;
+	GetDistance_Response *response = (GetDistance_Response *)packet;
+	uint16_t distance = 0;
+
+	*(void **)(&response_function) = function;
+
+	if (error_code == E_OK) {
+		distance = leconvert_uint16_from(response->distance);
+	}
+
+	response_function(error_code, distance, user_data);
+}
+
+int distance_ir_get_distance_async(DistanceIR *distance_ir, void *function, void *user_data) {
+	DevicePrivate *device_p = distance_ir->p;
+	GetDistance_Request request;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), DISTANCE_IR_FUNCTION_GET_DISTANCE, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	return device_send_request_async(device_p, (Packet *)&request, distance_ir_get_distance_async_wrapper, function, user_data);
+}
+
 int distance_ir_get_analog_value(DistanceIR *distance_ir, uint16_t *ret_value) {
 	DevicePrivate *device_p = distance_ir->p;
 	GetAnalogValue_Request request;
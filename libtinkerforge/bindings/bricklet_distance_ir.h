@@ -293,6 +293,23 @@ int distance_ir_get_api_version(DistanceIR *distance_ir, uint8_t ret_api_version
  */
 int distance_ir_get_distance(DistanceIR *distance_ir, uint16_t *ret_distance);
 
+/**
+ * \ingroup BrickletDistanceIR
+ *
+ * Requests the distance like distance_ir_get_distance, but returns without waiting
+ * for the response. The \c function is called with the signature
+ *
+ * \code
+ * void function(int error_code, uint16_t distance, void *user_data)
+ * \endcode
+ *
+ * from the callback thread of the device once the response arrived, or with
+ * E_TIMEOUT if no response arrived in time. Like a callback it can call other
+ * functions of the device. Returns E_WOULD_BLOCK if the IP Connection already
+ * has the maximum number of requests in flight.
+ */
+int distance_ir_get_distance_async(DistanceIR *distance_ir, void *function, void *user_data);
+
 /**
  * \ingroup BrickletDistanceIR
  *
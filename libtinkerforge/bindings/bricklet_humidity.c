@@ -29,6 +29,8 @@ typedef void (*HumidityReached_CallbackFunction)(uint16_t humidity, void *user_d
 
 typedef void (*AnalogValueReached_CallbackFunction)(uint16_t value, void *user_data);
 
+typedef void (*GetHumidityAsync_ResponseFunction)(int error_code, uint16_t humidity, void *user_data);
+
 #if defined _MSC_VER || defined __BORLANDC__
 	#pragma pack(push)
 	#pragma pack(1)
@@ -319,6 +321,34 @@ int humidity_get_humidity(Humidity *humidity, uint16_t *ret_humidity) {
 	return ret;
 }
 
+static void humidity_get_humidity_async_wrapper(int error_code, Packet *packet, void *function, void *user_data) {
+	GetHumidityAsync_ResponseFunction response_function;
+	GetHumidity_Response *response = (GetHumidity_Response *)packet;
+	uint16_t humidity = 0;
+
+	*(void **)(&response_function) = function;
+
+	if (error_code == E_OK) {
+		humidity = leconvert_uint16_from(response->humidity);
+	}
+
+	response_function(error_code, humidity, user_data);
+}
+
+int humidity_get_humidity_async(Humidity *humidity, void *function, void *user_data) {
+	DevicePrivate *device_p = humidity->p;
+	GetHumidity_Request request;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), HUMIDITY_FUNCTION_GET_HUMIDITY, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	return device_send_request_async(device_p, (Packet *)&request, humidity_get_humidity_async_wrapper, function, user_data);
+}
+
 int humidity_get_analog_value(Humidity *humidity, uint16_t *ret_value) {
 	DevicePrivate *device_p = humidity->p;
 	GetAnalogValue_Request request;
@@ -283,6 +283,23 @@ int humidity_get_api_version(Humidity *humidity, uint8_t ret_api_version[3]);
  */
 int humidity_get_humidity(Humidity *humidity, uint16_t *ret_humidity);
 
+/**
+ * \ingroup BrickletHumidity
+ *
+ * Requests the humidity like humidity_get_humidity, but returns without waiting
+ * for the response. The \c function is called with the signature
+ *
+ * \code
+ * void function(int error_code, uint16_t humidity, void *user_data)
+ * \endcode
+ *
+ * from the callback thread of the device once the response arrived, or with
+ * E_TIMEOUT if no response arrived in time. Like a callback it can call other
+ * functions of the device. Returns E_WOULD_BLOCK if the IP Connection already
+ * has the maximum number of requests in flight.
+ */
+int humidity_get_humidity_async(Humidity *humidity, void *function, void *user_data);
+
 /**
  * \ingroup BrickletHumidity
  *
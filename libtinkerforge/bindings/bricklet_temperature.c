@@ -25,6 +25,8 @@ typedef void (*Temperature_CallbackFunction)(int16_t temperature, void *user_dat
 
 typedef void (*TemperatureReached_CallbackFunction)(int16_t temperature, void *user_data);
 
+typedef void (*GetTemperatureAsync_ResponseFunction)(int error_code, int16_t temperature, void *user_data);
+
 #if defined _MSC_VER || defined __BORLANDC__
 	#pragma pack(push)
 	#pragma pack(1)
@@ -241,6 +243,34 @@ int temperature_get_temperature(Temperature *temperature, int16_t *ret_temperatu
 	return ret;
 }
 
+static void temperature_get_temperature_async_wrapper(int error_code, Packet *packet, void *function, void *user_data) {
+	GetTemperatureAsync_ResponseFunction response_function;
+	GetTemperature_Response *response = (GetTemperature_Response *)packet;
+	int16_t temperature = 0;
+
+	*(void **)(&response_function) = function;
+
+	if (error_code == E_OK) {
+		temperature = leconvert_int16_from(response->temperature);
+	}
+
+	response_function(error_code, temperature, user_data);
+}
+
+int temperature_get_temperature_async(Temperature *temperature, void *function, void *user_data) {
+	DevicePrivate *device_p = temperature->p;
+	GetTemperature_Request request;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), TEMPERATURE_FUNCTION_GET_TEMPERATURE, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	return device_send_request_async(device_p, (Packet *)&request, temperature_get_temperature_async_wrapper, function, user_data);
+}
+
 int temperature_set_temperature_callback_period(Temperature *temperature, uint32_t period) {
 	DevicePrivate *device_p = temperature->p;
 	SetTemperatureCallbackPeriod_Request request;
@@ -250,6 +250,23 @@ int temperature_get_api_version(Temperature *temperature, uint8_t ret_api_versio
  */
 int temperature_get_temperature(Temperature *temperature, int16_t *ret_temperature);
 
+/**
+ * \ingroup BrickletTemperature
+ *
+ * Requests the temperature like temperature_get_temperature, but returns without waiting
+ * for the response. The \c function is called with the signature
+ *
+ * \code
+ * void function(int error_code, int16_t temperature, void *user_data)
+ * \endcode
+ *
+ * from the callback thread of the device once the response arrived, or with
+ * E_TIMEOUT if no response arrived in time. Like a callback it can call other
+ * functions of the device. Returns E_WOULD_BLOCK if the IP Connection already
+ * has the maximum number of requests in flight.
+ */
+int temperature_get_temperature_async(Temperature *temperature, void *function, void *user_data);
+
 /**
  * \ingroup BrickletTemperature
  *
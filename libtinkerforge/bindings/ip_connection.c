@@ -38,6 +38,17 @@
 	#include <netinet/tcp.h> // TCP_NO_DELAY
 	#include <netdb.h> // gethostbyname
 	#include <netinet/in.h> // struct sockaddr_in
+
+	#ifdef __linux__
+		#include <sys/epoll.h>
+		#include <sys/eventfd.h>
+		#include <sys/timerfd.h>
+		#include <sys/syscall.h>
+		#include <linux/futex.h>
+
+		#define IPCON_HAVE_REACTOR
+		#define IPCON_HAVE_FUTEX
+	#endif
 #endif
 
 #ifdef _MSC_VER
@@ -148,6 +159,49 @@ void millisleep(uint32_t msec) {
 #endif
 }
 
+static uint64_t get_monotonic_usec(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+	       (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static uint64_t get_monotonic_msec(void) {
+	return get_monotonic_usec() / 1000;
+}
+
+static uint64_t get_realtime_usec(void) { // since the Unix epoch
+#ifdef _WIN32
+	FILETIME file_time;
+	ULARGE_INTEGER time;
+
+	GetSystemTimeAsFileTime(&file_time);
+
+	time.LowPart = file_time.dwLowDateTime;
+	time.HighPart = file_time.dwHighDateTime;
+
+	return (time.QuadPart - 116444736000000000ULL) / 10; // from 100ns since 1601
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
 /*****************************************************************************
  *
  *                                 SHA1
@@ -491,7 +545,6 @@ static void hmac_sha1(uint8_t *secret, int secret_length,
 static const char BASE58_ALPHABET[] = \
 	"123456789abcdefghijkmnopqrstuvwxyzABCDEFGHJKLMNPQRSTUVWXYZ";
 
-#if 0
 static void base58_encode(uint64_t value, char *str) {
 	uint32_t mod;
 	char reverse_str[BASE58_MAX_STR_SIZE] = {'\0'};
@@ -515,7 +568,6 @@ static void base58_encode(uint64_t value, char *str) {
 		str[k] = '\0';
 	}
 }
-#endif
 
 static uint64_t base58_decode(const char *str) {
 	int i;
@@ -549,6 +601,34 @@ static uint64_t base58_decode(const char *str) {
 	return value;
 }
 
+uint32_t ipcon_uid_from_string(const char *uid_str) {
+	uint64_t uid = base58_decode(uid_str);
+	uint32_t value1;
+	uint32_t value2;
+
+	if (uid > 0xFFFFFFFF) {
+		// convert from 64bit to 32bit
+		value1 = uid & 0xFFFFFFFF;
+		value2 = (uid >> 32) & 0xFFFFFFFF;
+
+		uid  = (value1 & 0x00000FFF);
+		uid |= (value1 & 0x0F000000) >> 12;
+		uid |= (value2 & 0x0000003F) << 16;
+		uid |= (value2 & 0x000F0000) << 6;
+		uid |= (value2 & 0x3F000000) << 2;
+	}
+
+	return uid & 0xFFFFFFFF;
+}
+
+void ipcon_uid_to_string(uint32_t uid, char *uid_str) {
+	char str[BASE58_MAX_STR_SIZE];
+
+	// a 32 bit value has at most 6 digits, the rest is zero padding
+	base58_encode(uid, str);
+	memcpy(uid_str, str, 8);
+}
+
 /*****************************************************************************
  *
  *                                 Socket
@@ -686,6 +766,98 @@ static int socket_send(Socket *socket, const void *buffer, int length) {
 
 #endif
 
+/*****************************************************************************
+ *
+ *                                 Atomic
+ *
+ *****************************************************************************/
+
+#ifdef _MSC_VER
+
+static uint32_t atomic_load_uint32(volatile uint32_t *value) {
+	return (uint32_t)InterlockedCompareExchange((volatile LONG *)value, 0, 0);
+}
+
+static uint64_t atomic_load_uint64(volatile uint64_t *value) {
+	return (uint64_t)InterlockedCompareExchange64((volatile LONGLONG *)value, 0, 0);
+}
+
+static void atomic_store_uint32(volatile uint32_t *value, uint32_t new_value) {
+	InterlockedExchange((volatile LONG *)value, (LONG)new_value);
+}
+
+static void atomic_store_uint64(volatile uint64_t *value, uint64_t new_value) {
+	InterlockedExchange64((volatile LONGLONG *)value, (LONGLONG)new_value);
+}
+
+static uint32_t atomic_add_uint32(volatile uint32_t *value, int32_t delta) {
+	return (uint32_t)InterlockedExchangeAdd((volatile LONG *)value, delta) + (uint32_t)delta;
+}
+
+static void atomic_add_uint64(volatile uint64_t *value, int64_t delta) {
+	InterlockedExchangeAdd64((volatile LONGLONG *)value, delta);
+}
+
+static bool atomic_compare_exchange_uint32(volatile uint32_t *value, uint32_t expected, uint32_t desired) {
+	return (uint32_t)InterlockedCompareExchange((volatile LONG *)value, (LONG)desired, (LONG)expected) == expected;
+}
+
+static void *atomic_load_pointer(void *volatile *pointer) {
+	return InterlockedCompareExchangePointer(pointer, NULL, NULL);
+}
+
+static void atomic_store_pointer(void *volatile *pointer, void *new_pointer) {
+	InterlockedExchangePointer(pointer, new_pointer);
+}
+
+static void atomic_fence(void) {
+	MemoryBarrier();
+}
+
+#else
+
+static uint32_t atomic_load_uint32(volatile uint32_t *value) {
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static uint64_t atomic_load_uint64(volatile uint64_t *value) {
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void atomic_store_uint32(volatile uint32_t *value, uint32_t new_value) {
+	__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static void atomic_store_uint64(volatile uint64_t *value, uint64_t new_value) {
+	__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static uint32_t atomic_add_uint32(volatile uint32_t *value, int32_t delta) {
+	return __atomic_add_fetch(value, (uint32_t)delta, __ATOMIC_ACQ_REL);
+}
+
+static void atomic_add_uint64(volatile uint64_t *value, int64_t delta) {
+	__atomic_add_fetch(value, (uint64_t)delta, __ATOMIC_RELAXED);
+}
+
+static bool atomic_compare_exchange_uint32(volatile uint32_t *value, uint32_t expected, uint32_t desired) {
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static void *atomic_load_pointer(void *volatile *pointer) {
+	return __atomic_load_n(pointer, __ATOMIC_ACQUIRE);
+}
+
+static void atomic_store_pointer(void *volatile *pointer, void *new_pointer) {
+	__atomic_store_n(pointer, new_pointer, __ATOMIC_RELEASE);
+}
+
+static void atomic_fence(void) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
 /*****************************************************************************
  *
  *                                 Mutex
@@ -821,6 +993,81 @@ static int event_wait(Event *event, uint32_t timeout) { // in msec
 
 #endif
 
+/*****************************************************************************
+ *
+ *                                 Completion
+ *
+ *****************************************************************************/
+
+#ifdef IPCON_HAVE_FUTEX
+
+// a completion is a futex word that is set once by the receive thread. the
+// waiting thread spins for a while before it parks in the kernel, the receive
+// thread only does the wake syscall if the waiter announced that it parked
+
+enum {
+	COMPLETION_PENDING = 0,
+	COMPLETION_DONE,
+	COMPLETION_PARKED // still pending, the waiter sleeps in the kernel
+};
+
+static void cpu_relax(void) {
+#if defined __i386__ || defined __x86_64__
+	__asm__ __volatile__("pause");
+#elif defined __aarch64__
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static void completion_reset(uint32_t *completion) {
+	atomic_store_uint32(completion, COMPLETION_PENDING);
+}
+
+static void completion_set(uint32_t *completion) {
+	uint32_t state;
+
+	do {
+		state = atomic_load_uint32(completion);
+	} while (!atomic_compare_exchange_uint32(completion, state, COMPLETION_DONE));
+
+	if (state == COMPLETION_PARKED) {
+		syscall(SYS_futex, completion, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+}
+
+// NOTE: returns E_OK and the waited time in usec if the completion was set
+//       within the timeout (in msec), spins for the first spin usec
+static int completion_wait(uint32_t *completion, uint32_t timeout, uint32_t spin,
+                           uint32_t *ret_waited) {
+	uint64_t start = get_monotonic_usec();
+	uint64_t deadline = start + (uint64_t)timeout * 1000;
+	uint64_t now = start;
+	struct timespec ts;
+
+	while (atomic_load_uint32(completion) != COMPLETION_DONE) {
+		if (now - start < spin) {
+			cpu_relax();
+		} else if (now >= deadline) {
+			return E_TIMEOUT;
+		} else if (atomic_compare_exchange_uint32(completion, COMPLETION_PENDING, COMPLETION_PARKED) ||
+		           atomic_load_uint32(completion) == COMPLETION_PARKED) {
+			ts.tv_sec = (time_t)((deadline - now) / 1000000);
+			ts.tv_nsec = (long)((deadline - now) % 1000000) * 1000;
+
+			// returns early on wake up, signal or if the completion was set meanwhile
+			syscall(SYS_futex, completion, FUTEX_WAIT_PRIVATE, COMPLETION_PARKED, &ts, NULL, 0);
+		}
+
+		now = get_monotonic_usec();
+	}
+
+	*ret_waited = (uint32_t)(now - start);
+
+	return E_OK;
+}
+
+#endif // IPCON_HAVE_FUTEX
+
 /*****************************************************************************
  *
  *                                 Semaphore
@@ -841,6 +1088,10 @@ static int semaphore_acquire(Semaphore *semaphore) {
 	return WaitForSingleObject(semaphore->handle, INFINITE) != WAIT_OBJECT_0 ? -1 : 0;
 }
 
+static bool semaphore_try_acquire(Semaphore *semaphore) {
+	return WaitForSingleObject(semaphore->handle, 0) == WAIT_OBJECT_0;
+}
+
 static void semaphore_release(Semaphore *semaphore) {
 	ReleaseSemaphore(semaphore->handle, 1, NULL);
 }
@@ -879,6 +1130,10 @@ static int semaphore_acquire(Semaphore *semaphore) {
 	return sem_wait(semaphore->pointer) < 0 ? -1 : 0;
 }
 
+static bool semaphore_try_acquire(Semaphore *semaphore) {
+	return sem_trywait(semaphore->pointer) == 0;
+}
+
 static void semaphore_release(Semaphore *semaphore) {
 	sem_post(semaphore->pointer);
 }
@@ -959,92 +1214,198 @@ static void thread_join(Thread *thread) {
  *
  *****************************************************************************/
 
+// open addressing hash table keyed by UID with linear probing. lookups don't
+// lock, they only announce themselves in the reader counter of the current
+// epoch. writers are serialized by the mutex and modify slots in place, a
+// removed slot keeps its key with a NULL value until the next rehash. before
+// memory that a reader might still see is freed (the old slot array after a
+// rehash, or a removed value by the caller of table_remove) the writer waits
+// for all readers of the current epoch to leave
+
+#define TABLE_INITIAL_SLOT_COUNT 16 // must be a power of two
+
+static TableSlots *table_allocate_slots(uint32_t slot_count) {
+	TableSlots *slots = (TableSlots *)calloc(1, sizeof(TableSlots) + sizeof(TableSlot) * (slot_count - 1));
+
+	slots->mask = slot_count - 1;
+
+	return slots;
+}
+
+static uint32_t table_hash(uint32_t key) {
+	key ^= key >> 16;
+	key *= 0x45D9F3B;
+	key ^= key >> 16;
+
+	return key;
+}
+
 static void table_create(Table *table) {
 	mutex_create(&table->mutex);
 
+	table->slots = table_allocate_slots(TABLE_INITIAL_SLOT_COUNT);
 	table->used = 0;
-	table->allocated = 16;
-	table->keys = (uint32_t *)malloc(sizeof(uint32_t) * table->allocated);
-	table->values = (void **)malloc(sizeof(void *) * table->allocated);
+	table->count = 0;
+	table->epoch = 0;
+	table->readers[0] = 0;
+	table->readers[1] = 0;
 }
 
 static void table_destroy(Table *table) {
-	free(table->keys);
-	free(table->values);
+	free(table->slots);
 
 	mutex_destroy(&table->mutex);
 }
 
-static void table_insert(Table *table, uint32_t key, void *value) {
-	int i;
-
-	mutex_lock(&table->mutex);
+static uint32_t table_read_lock(Table *table) {
+	uint32_t epoch;
 
-	for (i = 0; i < table->used; ++i) {
-		if (table->keys[i] == key) {
-			table->values[i] = value;
+	while (true) {
+		epoch = atomic_load_uint32(&table->epoch);
 
-			mutex_unlock(&table->mutex);
+		atomic_add_uint32(&table->readers[epoch & 1], 1);
+		atomic_fence();
 
-			return;
+		// if a writer flipped the epoch in the meantime it might already
+		// have checked the counter of the old epoch, so retry
+		if (atomic_load_uint32(&table->epoch) == epoch) {
+			return epoch;
 		}
+
+		atomic_add_uint32(&table->readers[epoch & 1], -1);
 	}
+}
+
+static void table_read_unlock(Table *table, uint32_t epoch) {
+	atomic_add_uint32(&table->readers[epoch & 1], -1);
+}
 
-	if (table->allocated <= table->used) {
-		table->allocated += 16;
-		table->keys = (uint32_t *)realloc(table->keys, sizeof(uint32_t) * table->allocated);
-		table->values = (void **)realloc(table->values, sizeof(void *) * table->allocated);
+// NOTE: assumes that table->mutex is locked
+static void table_synchronize(Table *table) {
+	uint32_t epoch = table->epoch;
+
+	atomic_store_uint32(&table->epoch, epoch + 1);
+	atomic_fence();
+
+	while (atomic_load_uint32(&table->readers[epoch & 1]) > 0) {
+		millisleep(0);
 	}
+}
 
-	table->keys[table->used] = key;
-	table->values[table->used] = value;
+// NOTE: assumes that table->mutex is locked
+static TableSlot *table_find_slot(TableSlots *slots, uint32_t key) {
+	uint32_t i = table_hash(key) & slots->mask;
 
-	++table->used;
+	while (slots->slots[i].state != 0 && slots->slots[i].key != key) {
+		i = (i + 1) & slots->mask;
+	}
 
-	mutex_unlock(&table->mutex);
+	return &slots->slots[i];
 }
 
-static void table_remove(Table *table, uint32_t key) {
-	int i;
-	int tail;
+// NOTE: assumes that table->mutex is locked
+static void table_rehash(Table *table, uint32_t slot_count) {
+	TableSlots *old_slots = table->slots;
+	TableSlots *new_slots = table_allocate_slots(slot_count);
+	TableSlot *slot;
+	uint32_t i;
+
+	table->used = 0;
+
+	for (i = 0; i <= old_slots->mask; ++i) {
+		if (old_slots->slots[i].state != 0 && old_slots->slots[i].value != NULL) {
+			slot = table_find_slot(new_slots, old_slots->slots[i].key);
+
+			slot->key = old_slots->slots[i].key;
+			slot->value = old_slots->slots[i].value;
+			slot->state = 1;
+
+			++table->used;
+		}
+	}
+
+	atomic_store_pointer((void *volatile *)&table->slots, new_slots);
+	table_synchronize(table);
+
+	free(old_slots);
+}
+
+static void table_insert(Table *table, uint32_t key, void *value) {
+	TableSlot *slot;
+	uint32_t slot_count;
 
 	mutex_lock(&table->mutex);
 
-	for (i = 0; i < table->used; ++i) {
-		if (table->keys[i] == key) {
-			tail = table->used - i - 1;
+	slot = table_find_slot(table->slots, key);
+
+	if (slot->state == 0) {
+		// keep the load factor at or below 3/4, grow if that is needed
+		// because of values, otherwise just drop the removed slots
+		slot_count = table->slots->mask + 1;
 
-			if (tail > 0) {
-				memmove(table->keys + i, table->keys + i + 1, sizeof(uint32_t) * tail);
-				memmove(table->values + i, table->values + i + 1, sizeof(void *) * tail);
+		if ((table->used + 1) * 4 > slot_count * 3) {
+			if ((table->count + 1) * 2 > slot_count) {
+				slot_count *= 2;
 			}
 
-			--table->used;
+			table_rehash(table, slot_count);
 
-			break;
+			slot = table_find_slot(table->slots, key);
+		}
+
+		slot->key = key;
+		slot->value = value;
+
+		atomic_store_uint32(&slot->state, 1);
+
+		++table->used;
+		++table->count;
+	} else {
+		if (slot->value == NULL) {
+			++table->count;
 		}
+
+		atomic_store_pointer(&slot->value, value);
 	}
 
 	mutex_unlock(&table->mutex);
 }
 
-static void *table_get(Table *table, uint32_t key) {
-	int i;
-	void *value = NULL;
+// NOTE: only removes the key if it still maps to the given value. once this
+//       returns no reader can see the value anymore and it can be freed
+static void table_remove(Table *table, uint32_t key, void *value) {
+	TableSlot *slot;
 
 	mutex_lock(&table->mutex);
 
-	for (i = 0; i < table->used; ++i) {
-		if (table->keys[i] == key) {
-			value = table->values[i];
+	slot = table_find_slot(table->slots, key);
 
-			break;
-		}
+	if (slot->state != 0 && slot->value == value) {
+		atomic_store_pointer(&slot->value, NULL);
+
+		--table->count;
+
+		table_synchronize(table);
 	}
 
 	mutex_unlock(&table->mutex);
+}
 
-	return value;
+// NOTE: assumes that the caller is between table_read_lock and
+//       table_read_unlock, the value stays valid until table_read_unlock
+static void *table_get(Table *table, uint32_t key) {
+	TableSlots *slots = (TableSlots *)atomic_load_pointer((void *volatile *)&table->slots);
+	uint32_t i = table_hash(key) & slots->mask;
+
+	while (atomic_load_uint32(&slots->slots[i].state) != 0) {
+		if (slots->slots[i].key == key) {
+			return atomic_load_pointer(&slots->slots[i].value);
+		}
+
+		i = (i + 1) & slots->mask;
+	}
+
+	return NULL;
 }
 
 /*****************************************************************************
@@ -1057,7 +1418,8 @@ enum {
 	QUEUE_KIND_EXIT = 0,
 	QUEUE_KIND_DESTROY_AND_EXIT,
 	QUEUE_KIND_META,
-	QUEUE_KIND_PACKET
+	QUEUE_KIND_PACKET,
+	QUEUE_KIND_COMPLETION
 };
 
 typedef struct {
@@ -1066,12 +1428,77 @@ typedef struct {
 	uint64_t socket_id;
 } Meta;
 
-static void queue_create(Queue *queue) {
+typedef struct {
+	ResponseWrapperFunction response_wrapper;
+	void *response_function;
+	void *response_user_data;
+	int error_code;
+	bool has_response;
+	Packet response;
+} Completion;
+
+enum {
+	IPCON_META_REPLAY_BARRIER = 255 // not a callback, see ipcon_replay_barrier
+};
+
+// packets are handed from the receive thread (or the reactor) to the callback
+// thread through a single-producer/single-consumer ring of fixed-size packet
+// slots. this needs no allocation and no locking in steady state. all other
+// items (meta, exit) can be put by any thread and go to a mutex protected
+// list, as do packets while the ring is full. every list item remembers the
+// ring write index at the time it was put, the consumer drains the ring up to
+// this ticket before it takes the item, this keeps the overall FIFO order.
+//
+// with a capacity the number of queued packets is bounded. to drop the oldest
+// packet the producer advances the read index of the ring, therefore the
+// consumer claims a slot by compare-and-swap in the dropping policies. packets
+// that must not be dropped (enumerate) are put into the list by the dropping
+// policies, in the ring they could be dropped as the oldest packet or be
+// coalesced with a newer packet of the same key, like a CONNECTED enumeration
+// with a following AVAILABLE one
+
+#define QUEUE_RING_LENGTH 512 // must be a power of two
+#define QUEUE_LATEST_INDEX_MASK 0xFFFFFF // ring indices stored in latest
+
+static void queue_create(Queue *queue, uint32_t capacity, uint8_t policy,
+                         bool *producer_running) {
+	uint32_t ring_length = QUEUE_RING_LENGTH;
+
+	while (ring_length < capacity) {
+		ring_length *= 2;
+	}
+
 	queue->head = NULL;
 	queue->tail = NULL;
+	queue->item_count = 0;
+	queue->overflow_count = 0;
+
+	queue->ring = (Packet *)malloc(sizeof(Packet) * ring_length);
+	queue->ring_timestamps = (uint64_t *)malloc(sizeof(uint64_t) * ring_length);
+	queue->ring_length = ring_length;
+	queue->ring_read = 0;
+	queue->ring_write = 0;
+
+	queue->capacity = capacity;
+	queue->policy = policy;
+	queue->latest = NULL;
+	queue->producer_running = producer_running;
+	queue->producer_waiting = 0;
+
+	queue->delivered = NULL;
+
+	if (capacity > 0 && policy == IPCON_QUEUE_POLICY_KEEP_LATEST) {
+		queue->latest = (uint64_t *)calloc(ring_length, sizeof(uint64_t));
+		queue->delivered = (uint64_t *)calloc(ring_length, sizeof(uint64_t));
+	}
+
+	queue->high_water = 0;
+	queue->overflows = 0;
+	queue->drops = 0;
 
 	mutex_create(&queue->mutex);
 	semaphore_create(&queue->semaphore);
+	event_create(&queue->space_event);
 }
 
 static void queue_destroy(Queue *queue) {
@@ -1087,19 +1514,47 @@ static void queue_destroy(Queue *queue) {
 		item = next;
 	}
 
+	free(queue->ring);
+	free(queue->ring_timestamps);
+	free(queue->latest);
+	free(queue->delivered);
+
 	mutex_destroy(&queue->mutex);
 	semaphore_destroy(&queue->semaphore);
+	event_destroy(&queue->space_event);
 }
 
-static void queue_put(Queue *queue, int kind, void *data) {
+static bool queue_is_dropping(Queue *queue) {
+	return queue->capacity > 0 &&
+	       (queue->policy == IPCON_QUEUE_POLICY_DROP_OLDEST ||
+	        queue->policy == IPCON_QUEUE_POLICY_KEEP_LATEST);
+}
+
+static uint32_t queue_get_depth(Queue *queue) {
+	return atomic_load_uint32(&queue->ring_write) - atomic_load_uint32(&queue->ring_read) +
+	       atomic_load_uint32(&queue->overflow_count);
+}
+
+static uint64_t queue_get_latest_key(Packet *packet) {
+	return ((uint64_t)packet->header.uid << 8) | packet->header.function_id;
+}
+
+static uint32_t queue_get_latest_index(Queue *queue, uint64_t key) {
+	return (table_hash((uint32_t)(key >> 8)) + (uint32_t)(key & 0xFF)) & (queue->ring_length - 1);
+}
+
+static void queue_append_item(Queue *queue, int kind, void *data, uint64_t timestamp) {
 	QueueItem *item = (QueueItem *)malloc(sizeof(QueueItem));
 
 	item->next = NULL;
 	item->kind = kind;
 	item->data = data;
+	item->timestamp = timestamp;
 
 	mutex_lock(&queue->mutex);
 
+	item->ticket = atomic_load_uint32(&queue->ring_write);
+
 	if (queue->tail == NULL) {
 		queue->head = item;
 		queue->tail = item;
@@ -1108,953 +1563,3450 @@ static void queue_put(Queue *queue, int kind, void *data) {
 		queue->tail = item;
 	}
 
+	atomic_add_uint32(&queue->item_count, 1);
+
+	if (kind == QUEUE_KIND_PACKET) {
+		atomic_add_uint32(&queue->overflow_count, 1);
+	}
+
 	mutex_unlock(&queue->mutex);
+}
+
+static void queue_put(Queue *queue, int kind, void *data) {
+	queue_append_item(queue, kind, data, 0);
 	semaphore_release(&queue->semaphore);
 }
 
-static int queue_get(Queue *queue, int *kind, void **data) {
-	QueueItem *item;
+// NOTE: must only be called by the producer. returns true if there is space
+//       for another packet, false if the packet has to be dropped
+static bool queue_make_space(Queue *queue) {
+	uint32_t read;
 
-	if (semaphore_acquire(&queue->semaphore) < 0) {
-		return -1;
-	}
+	switch (queue->policy) {
+	case IPCON_QUEUE_POLICY_BLOCK:
+		atomic_store_uint32(&queue->producer_waiting, 1);
 
-	mutex_lock(&queue->mutex);
+		while (*queue->producer_running && queue_get_depth(queue) >= queue->capacity) {
+			event_reset(&queue->space_event);
 
-	if (queue->head == NULL) {
-		mutex_unlock(&queue->mutex);
+			// the consumer might have made space before the event was reset,
+			// check again in short intervals instead of relying on the event
+			if (queue_get_depth(queue) >= queue->capacity) {
+				event_wait(&queue->space_event, 10);
+			}
+		}
 
-		return -1;
-	}
+		atomic_store_uint32(&queue->producer_waiting, 0);
 
-	item = queue->head;
-	queue->head = item->next;
-	item->next = NULL;
+		return *queue->producer_running;
 
-	if (queue->tail == item) {
-		queue->head = NULL;
-		queue->tail = NULL;
-	}
+	case IPCON_QUEUE_POLICY_DROP_OLDEST:
+	case IPCON_QUEUE_POLICY_KEEP_LATEST:
+		read = atomic_load_uint32(&queue->ring_read);
 
-	mutex_unlock(&queue->mutex);
+		if (read == queue->ring_write) {
+			return false; // only undroppable packets are queued
+		}
 
-	*kind = item->kind;
-	*data = item->data;
+		// if this fails then the consumer just took the oldest packet
+		if (atomic_compare_exchange_uint32(&queue->ring_read, read, read + 1)) {
+			atomic_add_uint64(&queue->drops, 1);
+		}
 
-	free(item);
+		return true;
 
-	return 0;
+	default:
+		return false;
+	}
 }
 
-/*****************************************************************************
- *
- *                                 Device
- *
- *****************************************************************************/
+// NOTE: must only be called by the single producer, the receive thread or
+//       the reactor of the IP Connection owning the queue
+static void queue_put_packet(Queue *queue, Packet *packet, uint64_t timestamp,
+                             bool droppable) {
+	uint32_t write = queue->ring_write;
+	uint32_t depth;
+	bool bypass = !droppable && queue_is_dropping(queue);
+	Packet *copy;
 
-enum {
-	IPCON_FUNCTION_ENUMERATE = 254
-};
+	if (droppable && queue->capacity > 0 && queue_get_depth(queue) >= queue->capacity &&
+	    !queue_make_space(queue)) {
+		atomic_add_uint64(&queue->drops, 1);
 
-static int ipcon_send_request(IPConnectionPrivate *ipcon_p, Packet *request);
+		return;
+	}
 
-// NOTE: assumes device_p->ref_count == 0
-static void device_destroy(DevicePrivate *device_p) {
-	int i;
+	// keep using the list while it still holds overflowed packets, otherwise
+	// newer packets from the ring would overtake them
+	if (!bypass && atomic_load_uint32(&queue->overflow_count) == 0 &&
+	    write - atomic_load_uint32(&queue->ring_read) < queue->ring_length) {
+		memcpy(&queue->ring[write & (queue->ring_length - 1)], packet, packet->header.length);
+		queue->ring_timestamps[write & (queue->ring_length - 1)] = timestamp;
 
-	table_remove(&device_p->ipcon_p->devices, device_p->uid);
+		if (queue->latest != NULL) {
+			atomic_store_uint64(&queue->latest[queue_get_latest_index(queue, queue_get_latest_key(packet))],
+			                    (queue_get_latest_key(packet) << 24) | (write & QUEUE_LATEST_INDEX_MASK));
+		}
 
-	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
-		free(device_p->high_level_callbacks[i].data);
-	}
+		atomic_store_uint32(&queue->ring_write, write + 1);
+	} else {
+		copy = (Packet *)malloc(packet->header.length);
 
-	mutex_destroy(&device_p->stream_mutex);
+		memcpy(copy, packet, packet->header.length);
+		queue_append_item(queue, QUEUE_KIND_PACKET, copy, timestamp);
 
-	event_destroy(&device_p->response_event);
+		if (!bypass) {
+			atomic_add_uint64(&queue->overflows, 1);
+		}
+	}
 
-	mutex_destroy(&device_p->response_mutex);
+	depth = queue_get_depth(queue);
 
-	mutex_destroy(&device_p->request_mutex);
+	if (depth > queue->high_water) {
+		atomic_store_uint32(&queue->high_water, depth);
+	}
 
-	free(device_p);
+	semaphore_release(&queue->semaphore);
 }
 
-void device_create(Device *device, const char *uid_str,
-                   IPConnectionPrivate *ipcon_p, uint8_t api_version_major,
-                   uint8_t api_version_minor, uint8_t api_version_release) {
-	DevicePrivate *device_p;
-	uint64_t uid;
-	uint32_t value1;
-	uint32_t value2;
-	int i;
+// NOTE: must only be called by the single consumer after it took the packet with
+//       the given ring index. if a newer packet with the same key is queued
+//       then its value is delivered now, in place of the taken packet, and the
+//       newer packet is skipped later. this keeps the position of a callback in
+//       the queue, so frequent callbacks cannot starve the others. returns 0 if
+//       the taken packet was delivered early and has to be skipped, 1 otherwise
+static int queue_coalesce_latest(Queue *queue, Packet *packet, uint64_t *timestamp,
+                                 uint32_t read) {
+	uint64_t key = queue_get_latest_key(packet);
+	uint32_t i = queue_get_latest_index(queue, key);
+	uint64_t entry = (key << 24) | (read & QUEUE_LATEST_INDEX_MASK);
+	uint64_t latest;
+	uint32_t newer;
+	Packet copy;
+
+	if (queue->delivered[i] == entry) {
+		queue->delivered[i] = 0;
+
+		return 0;
+	}
 
-	device_p = (DevicePrivate *)malloc(sizeof(DevicePrivate));
-	device->p = device_p;
+	latest = atomic_load_uint64(&queue->latest[i]);
 
-	uid = base58_decode(uid_str);
+	if (latest >> 24 != key || latest == entry) {
+		return 1; // this is the latest packet for its key
+	}
 
-	if (uid > 0xFFFFFFFF) {
-		// convert from 64bit to 32bit
-		value1 = uid & 0xFFFFFFFF;
-		value2 = (uid >> 32) & 0xFFFFFFFF;
+	// another delivered early packet might still be queued with a colliding
+	// key, then don't overwrite its marker but just deliver the older value
+	if (queue->delivered[i] != 0 &&
+	    (((uint32_t)queue->delivered[i] - read) & QUEUE_LATEST_INDEX_MASK) < queue->ring_length) {
+		return 1;
+	}
 
-		uid  = (value1 & 0x00000FFF);
-		uid |= (value1 & 0x0F000000) >> 12;
-		uid |= (value2 & 0x0000003F) << 16;
-		uid |= (value2 & 0x000F0000) << 6;
-		uid |= (value2 & 0x3F000000) << 2;
+	newer = read + (((uint32_t)latest - read) & QUEUE_LATEST_INDEX_MASK);
+
+	memcpy(&copy, &queue->ring[newer & (queue->ring_length - 1)], sizeof(Packet));
+
+	// the producer might have dropped the newer packet and reused its slot
+	// while it was copied, then the copy is discarded
+	atomic_fence();
+
+	if ((int32_t)(newer - atomic_load_uint32(&queue->ring_read)) < 0) {
+		return 1;
 	}
 
-	device_p->ref_count = 1;
+	memcpy(packet, &copy, copy.header.length);
 
-	device_p->uid = uid & 0xFFFFFFFF;
+	*timestamp = queue->ring_timestamps[newer & (queue->ring_length - 1)];
+	queue->delivered[i] = latest;
 
-	device_p->ipcon_p = ipcon_p;
+	atomic_add_uint64(&queue->drops, 1);
 
-	device_p->api_version[0] = api_version_major;
-	device_p->api_version[1] = api_version_minor;
-	device_p->api_version[2] = api_version_release;
+	return 1;
+}
 
-	// request
-	mutex_create(&device_p->request_mutex);
+// NOTE: returns 1 if a packet was taken from the ring, 0 if the taken packet
+//       was already delivered early and got skipped and -1 if the ring is empty
+static int queue_get_from_ring(Queue *queue, Packet *packet, uint64_t *timestamp) {
+	uint32_t read;
+	Packet *slot;
 
-	// response
-	device_p->expected_response_function_id = 0;
-	device_p->expected_response_sequence_number = 0;
+	if (!queue_is_dropping(queue)) {
+		read = queue->ring_read;
 
-	mutex_create(&device_p->response_mutex);
+		if (read == atomic_load_uint32(&queue->ring_write)) {
+			return -1;
+		}
 
-	memset(&device_p->response_packet, 0, sizeof(Packet));
+		slot = &queue->ring[read & (queue->ring_length - 1)];
 
-	event_create(&device_p->response_event);
+		memcpy(packet, slot, slot->header.length);
 
-	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
-		device_p->response_expected[i] = DEVICE_RESPONSE_EXPECTED_INVALID_FUNCTION_ID;
+		*timestamp = queue->ring_timestamps[read & (queue->ring_length - 1)];
+
+		atomic_store_uint32(&queue->ring_read, read + 1);
+
+		if (atomic_load_uint32(&queue->producer_waiting)) {
+			event_set(&queue->space_event);
+		}
+
+		return 1;
 	}
 
-	// stream
-	mutex_create(&device_p->stream_mutex);
+	// the producer might drop the slot while it is copied, then the copy is
+	// discarded. copy the whole slot, because its length might be torn
+	while (true) {
+		read = atomic_load_uint32(&queue->ring_read);
 
-	// callbacks
-	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS * 2; i++) {
-		device_p->registered_callbacks[i] = NULL;
-		device_p->registered_callback_user_data[i] = NULL;
+		if (read == atomic_load_uint32(&queue->ring_write)) {
+			return -1;
+		}
+
+		memcpy(packet, &queue->ring[read & (queue->ring_length - 1)], sizeof(Packet));
+
+		*timestamp = queue->ring_timestamps[read & (queue->ring_length - 1)];
+
+		if (atomic_compare_exchange_uint32(&queue->ring_read, read, read + 1)) {
+			break;
+		}
 	}
 
-	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
-		device_p->callback_wrappers[i] = NULL;
-		device_p->high_level_callbacks[i].exists = false;
-		device_p->high_level_callbacks[i].data = NULL;
-		device_p->high_level_callbacks[i].length = 0;
+	if (queue->latest != NULL) {
+		return queue_coalesce_latest(queue, packet, timestamp, read);
 	}
 
-	// add to IPConnection
-	table_insert(&ipcon_p->devices, device_p->uid, device_p);
+	return 1;
 }
 
-void device_release(DevicePrivate *device_p) {
-	IPConnectionPrivate *ipcon_p = device_p->ipcon_p;
+// NOTE: must only be called by the single consumer, the callback thread. if
+//       the returned kind is QUEUE_KIND_PACKET then the packet was copied to
+//       the given packet buffer, its timestamp is stored and data is NULL
+static int queue_get(Queue *queue, int *kind, void **data, Packet *packet,
+                     uint64_t *timestamp) {
+	QueueItem *item;
 
-	mutex_lock(&ipcon_p->devices_ref_mutex);
+	// packets dropped by the producer or superseded by newer packets leave
+	// their semaphore count behind, keep waiting if nothing is left to take
+	while (true) {
+		if (semaphore_acquire(&queue->semaphore) < 0) {
+			return -1;
+		}
 
-	--device_p->ref_count;
+		if (atomic_load_uint32(&queue->item_count) == 0) {
+			if (queue_get_from_ring(queue, packet, timestamp) > 0) {
+				*kind = QUEUE_KIND_PACKET;
+				*data = NULL;
 
-	if (device_p->ref_count == 0) {
-		device_destroy(device_p);
-	}
+				return 0;
+			}
 
-	mutex_unlock(&ipcon_p->devices_ref_mutex);
-}
+			continue;
+		}
 
-int device_get_response_expected(DevicePrivate *device_p, uint8_t function_id,
-                                 bool *ret_response_expected) {
-	int flag = device_p->response_expected[function_id];
+		mutex_lock(&queue->mutex);
 
-	if (flag == DEVICE_RESPONSE_EXPECTED_INVALID_FUNCTION_ID) {
-		return E_INVALID_PARAMETER;
+		item = queue->head;
+
+		// older packets from the ring have to be dispatched first
+		if (item == NULL || (int32_t)(item->ticket - atomic_load_uint32(&queue->ring_read)) > 0) {
+			mutex_unlock(&queue->mutex);
+
+			if (queue_get_from_ring(queue, packet, timestamp) > 0) {
+				*kind = QUEUE_KIND_PACKET;
+				*data = NULL;
+
+				return 0;
+			}
+
+			continue;
+		}
+
+		break;
 	}
 
-	if (flag == DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE ||
-	    flag == DEVICE_RESPONSE_EXPECTED_TRUE) {
-		*ret_response_expected = true;
-	} else {
-		*ret_response_expected = false;
+	queue->head = item->next;
+	item->next = NULL;
+
+	if (queue->tail == item) {
+		queue->head = NULL;
+		queue->tail = NULL;
 	}
 
-	return E_OK;
-}
+	atomic_add_uint32(&queue->item_count, -1);
 
-int device_set_response_expected(DevicePrivate *device_p, uint8_t function_id,
-                                 bool response_expected) {
-	int current_flag = device_p->response_expected[function_id];
+	if (item->kind == QUEUE_KIND_PACKET) {
+		atomic_add_uint32(&queue->overflow_count, -1);
+	}
 
-	if (current_flag != DEVICE_RESPONSE_EXPECTED_TRUE &&
-	    current_flag != DEVICE_RESPONSE_EXPECTED_FALSE) {
-		return E_INVALID_PARAMETER;
+	mutex_unlock(&queue->mutex);
+
+	*kind = item->kind;
+	*data = item->data;
+
+	if (item->kind == QUEUE_KIND_PACKET) {
+		memcpy(packet, item->data, ((Packet *)item->data)->header.length);
+		free(item->data);
+
+		*data = NULL;
+		*timestamp = item->timestamp;
 	}
 
-	device_p->response_expected[function_id] =
-	    response_expected ? DEVICE_RESPONSE_EXPECTED_TRUE
-	                      : DEVICE_RESPONSE_EXPECTED_FALSE;
+	free(item);
 
-	return E_OK;
+	return 0;
 }
 
-int device_set_response_expected_all(DevicePrivate *device_p, bool response_expected) {
-	int flag = response_expected ? DEVICE_RESPONSE_EXPECTED_TRUE
-	                             : DEVICE_RESPONSE_EXPECTED_FALSE;
-	int i;
+/*****************************************************************************
+ *
+ *                                 Capture
+ *
+ *****************************************************************************/
 
-	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; ++i) {
-		if (device_p->response_expected[i] == DEVICE_RESPONSE_EXPECTED_TRUE ||
-		    device_p->response_expected[i] == DEVICE_RESPONSE_EXPECTED_FALSE) {
-			device_p->response_expected[i] = flag;
-		}
+// a capture file starts with the magic and the realtime in usec since the
+// Unix epoch at the start of the capture (little endian). each packet follows
+// as a LEB128 encoded (delta << 1 | direction), where delta is the monotonic
+// time in usec since the previous packet, followed by the packet itself as it
+// was on the wire. the packet length is taken from its header
+
+static const uint8_t CAPTURE_MAGIC[8] = {'T', 'F', 'C', 'A', 'P', 0, 0, 1};
+
+enum {
+	CAPTURE_DIRECTION_RECEIVED = 0,
+	CAPTURE_DIRECTION_SENT = 1
+};
+
+struct _Capture {
+	FILE *file;
+	uint64_t timestamp; // monotonic time of the previous packet, in usec
+	bool failed; // a write failed
+};
+
+static Capture *capture_create(const char *filename) {
+	Capture *capture;
+	uint64_t start = leconvert_uint64_to(get_realtime_usec());
+
+	capture = (Capture *)malloc(sizeof(Capture));
+	capture->file = fopen(filename, "wb");
+
+	if (capture->file == NULL) {
+		free(capture);
+
+		return NULL;
 	}
 
-	return E_OK;
+	capture->timestamp = get_monotonic_usec();
+	capture->failed = fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, capture->file) != 1 ||
+	                  fwrite(&start, sizeof(start), 1, capture->file) != 1;
+
+	return capture;
 }
 
-void device_register_callback(DevicePrivate *device_p, int16_t callback_id,
-                              void *function, void *user_data) {
-	if (callback_id <= -DEVICE_NUM_FUNCTION_IDS || callback_id >= DEVICE_NUM_FUNCTION_IDS) {
-		return;
+// NOTE: returns E_CAPTURE_FILE if any write failed
+static int capture_destroy(Capture *capture) {
+	bool failed = capture->failed;
+
+	if (fclose(capture->file) != 0) {
+		failed = true;
 	}
 
-	device_p->registered_callbacks[DEVICE_NUM_FUNCTION_IDS + callback_id] = function;
-	device_p->registered_callback_user_data[DEVICE_NUM_FUNCTION_IDS + callback_id] = user_data;
+	free(capture);
+
+	return failed ? E_CAPTURE_FILE : E_OK;
 }
 
-int device_get_api_version(DevicePrivate *device_p, uint8_t ret_api_version[3]) {
-	ret_api_version[0] = device_p->api_version[0];
-	ret_api_version[1] = device_p->api_version[1];
-	ret_api_version[2] = device_p->api_version[2];
+// NOTE: the packet header has to be in wire byte order
+static void capture_write(Capture *capture, Packet *packet, int direction,
+                          uint64_t timestamp) {
+	uint8_t prefix[10];
+	int length = 0;
+	uint64_t value;
 
-	return E_OK;
-}
+	// packets of different threads might be written slightly out of order
+	if (timestamp < capture->timestamp) {
+		timestamp = capture->timestamp;
+	}
 
-int device_send_request(DevicePrivate *device_p, Packet *request, Packet *response) {
-	int ret = E_OK;
-	uint8_t sequence_number = packet_header_get_sequence_number(&request->header);
-	uint8_t response_expected = packet_header_get_response_expected(&request->header);
-	uint8_t error_code;
+	value = (timestamp - capture->timestamp) << 1 | (uint64_t)direction;
+	capture->timestamp = timestamp;
 
-	if (response_expected) {
-		mutex_lock(&device_p->request_mutex);
+	do {
+		prefix[length] = (uint8_t)(value & 0x7F);
+		value >>= 7;
+
+		if (value != 0) {
+			prefix[length] |= 0x80;
+		}
 
-		event_reset(&device_p->response_event);
+		++length;
+	} while (value != 0);
 
-		device_p->expected_response_function_id = request->header.function_id;
-		device_p->expected_response_sequence_number = sequence_number;
+	if (fwrite(prefix, length, 1, capture->file) != 1 ||
+	    fwrite(packet, packet->header.length, 1, capture->file) != 1) {
+		capture->failed = true;
 	}
+}
 
-	ret = ipcon_send_request(device_p->ipcon_p, request);
+typedef struct {
+	uint64_t key; // uid << 8 | function_id
+	Packet *response; // latest response replayed so far, atomic
+} ReplayResponse;
+
+// a replay reads the whole capture into memory, so that it doesn't wait for
+// the disk while replaying as fast as possible
+struct _Replay {
+	uint8_t *data;
+	size_t length;
+	ReplayResponse *responses; // sorted by key
+	int response_count;
+	bool stop; // set by ipcon_disconnect
+	Event barrier;
+};
 
-	if (ret != E_OK) {
-		if (response_expected) {
-			mutex_unlock(&device_p->request_mutex);
-		}
+// NOTE: returns -1 if the record at the given offset is malformed, 0 at the end
+//       of the capture and the offset of the next record otherwise. a record
+//       cut off at the end is ignored, the capturing process might have died
+static int64_t replay_read_record(Replay *replay, size_t offset, uint64_t *delta,
+                                  int *direction, Packet **packet) {
+	uint64_t value = 0;
+	int shift = 0;
+	uint8_t length;
 
-		return ret;
+	if (offset >= replay->length) {
+		return 0;
 	}
 
-	if (response_expected) {
-		if (event_wait(&device_p->response_event, device_p->ipcon_p->timeout) < 0) {
-			ret = E_TIMEOUT;
+	do {
+		if (offset >= replay->length) {
+			return 0;
 		}
 
-		device_p->expected_response_function_id = 0;
-		device_p->expected_response_sequence_number = 0;
+		if (shift > 63) {
+			return -1;
+		}
 
-		event_reset(&device_p->response_event);
+		value |= (uint64_t)(replay->data[offset] & 0x7F) << shift;
+		shift += 7;
+	} while (replay->data[offset++] & 0x80);
 
-		if (ret == E_OK) {
-			mutex_lock(&device_p->response_mutex);
-
-			error_code = packet_header_get_error_code(&device_p->response_packet.header);
-
-			if (device_p->response_packet.header.function_id != request->header.function_id ||
-			    packet_header_get_sequence_number(&device_p->response_packet.header) != sequence_number) {
-				ret = E_TIMEOUT;
-			} else if (error_code == 0) {
-				// no error
-				if (response != NULL) {
-					memcpy(response, &device_p->response_packet,
-					       device_p->response_packet.header.length);
-				}
-			} else if (error_code == 1) {
-				ret = E_INVALID_PARAMETER;
-			} else if (error_code == 2) {
-				ret = E_NOT_SUPPORTED;
-			} else {
-				ret = E_UNKNOWN_ERROR_CODE;
-			}
+	if (replay->length - offset < sizeof(PacketHeader)) {
+		return 0;
+	}
 
-			mutex_unlock(&device_p->response_mutex);
-		}
+	*packet = (Packet *)(replay->data + offset);
+	length = (*packet)->header.length;
 
-		mutex_unlock(&device_p->request_mutex);
+	if (length < sizeof(PacketHeader) || length > sizeof(Packet)) {
+		return -1;
 	}
 
-	return ret;
-}
+	if (replay->length - offset < length) {
+		return 0;
+	}
 
-/*****************************************************************************
- *
- *                                 Brick Daemon
- *
- *****************************************************************************/
+	*delta = value >> 1;
+	*direction = (int)(value & 1);
 
-enum {
-	BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE = 1,
-	BRICK_DAEMON_FUNCTION_AUTHENTICATE = 2
-};
+	return (int64_t)(offset + length);
+}
 
-static void brickd_create(BrickDaemon *brickd, const char *uid, IPConnection *ipcon) {
-	DevicePrivate *device_p;
+static uint64_t replay_get_response_key(Packet *packet) {
+	return (uint64_t)leconvert_uint32_from(packet->header.uid) << 8 | packet->header.function_id;
+}
 
-	device_create(brickd, uid, ipcon->p, 2, 0, 0);
+static bool replay_is_response(Packet *packet, int direction) {
+	return direction == CAPTURE_DIRECTION_RECEIVED &&
+	       packet_header_get_sequence_number(&packet->header) != 0;
+}
 
-	device_p = brickd->p;
+static int replay_compare_responses(const void *a, const void *b) {
+	uint64_t key_a = ((const ReplayResponse *)a)->key;
+	uint64_t key_b = ((const ReplayResponse *)b)->key;
 
-	device_p->response_expected[BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE] = DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE;
-	device_p->response_expected[BRICK_DAEMON_FUNCTION_AUTHENTICATE] = DEVICE_RESPONSE_EXPECTED_TRUE;
+	return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
 }
 
-static void brickd_destroy(BrickDaemon *brickd) {
-	device_release(brickd->p);
+static ReplayResponse *replay_find_response(Replay *replay, Packet *packet) {
+	ReplayResponse key;
+
+	key.key = replay_get_response_key(packet);
+
+	return (ReplayResponse *)bsearch(&key, replay->responses, replay->response_count,
+	                                 sizeof(ReplayResponse), replay_compare_responses);
 }
 
-static int brickd_get_authentication_nonce(BrickDaemon *brickd, uint8_t ret_server_nonce[4]) {
-	DevicePrivate *device_p = brickd->p;
-	GetAuthenticationNonce request;
-	GetAuthenticationNonceResponse response;
-	int ret;
+static void replay_destroy(Replay *replay) {
+	event_destroy(&replay->barrier);
+	free(replay->responses);
+	free(replay->data);
+	free(replay);
+}
 
-	ret = packet_header_create(&request.header, sizeof(request), BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE, device_p->ipcon_p, device_p);
+// NOTE: returns NULL if the file could not be read or is malformed
+static Replay *replay_create(const char *filename) {
+	FILE *file = fopen(filename, "rb");
+	Replay *replay;
+	long size;
+	int64_t offset;
+	uint64_t delta;
+	int direction;
+	Packet *packet;
+	int count = 0;
+	int i;
 
-	if (ret < 0) {
-		return ret;
+	if (file == NULL) {
+		return NULL;
 	}
 
-	ret = device_send_request(device_p, (Packet *)&request, (Packet *)&response);
+	replay = (Replay *)calloc(1, sizeof(Replay));
 
-	if (ret < 0) {
-		return ret;
+	event_create(&replay->barrier);
+
+	if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 16 ||
+	    fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		free(replay);
+
+		return NULL;
 	}
 
-	memcpy(ret_server_nonce, response.server_nonce, 4 * sizeof(uint8_t));
+	replay->data = (uint8_t *)malloc(size);
+	replay->length = (size_t)size;
 
-	return ret;
-}
+	if (fread(replay->data, size, 1, file) != 1 ||
+	    memcmp(replay->data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+		fclose(file);
+		replay_destroy(replay);
 
-static int brickd_authenticate(BrickDaemon *brickd, uint8_t client_nonce[4], uint8_t digest[20]) {
-	DevicePrivate *device_p = brickd->p;
-	Authenticate request;
-	int ret;
+		return NULL;
+	}
 
-	ret = packet_header_create(&request.header, sizeof(request), BRICK_DAEMON_FUNCTION_AUTHENTICATE, device_p->ipcon_p, device_p);
+	fclose(file);
 
-	if (ret < 0) {
-		return ret;
+	// validate all records and collect the responses, each key keeps its
+	// first response, so that requests are answered before the capture
+	// reached any response
+	for (offset = 16; offset > 0;
+	     offset = replay_read_record(replay, offset, &delta, &direction, &packet)) {
+		if (offset > 16 && replay_is_response(packet, direction)) {
+			++count;
+		}
 	}
 
-	memcpy(request.client_nonce, client_nonce, 4 * sizeof(uint8_t));
-	memcpy(request.digest, digest, 20 * sizeof(uint8_t));
+	if (offset < 0) {
+		replay_destroy(replay);
 
-	ret = device_send_request(device_p, (Packet *)&request, NULL);
+		return NULL;
+	}
 
-	return ret;
+	replay->responses = (ReplayResponse *)malloc(sizeof(ReplayResponse) * (count > 0 ? count : 1));
+
+	for (offset = replay_read_record(replay, 16, &delta, &direction, &packet); offset > 0;
+	     offset = replay_read_record(replay, offset, &delta, &direction, &packet)) {
+		if (replay_is_response(packet, direction) &&
+		    replay_find_response(replay, packet) == NULL) {
+			// keep the array sorted, insertion is fine for the few
+			// distinct functions of a capture
+			for (i = replay->response_count;
+			     i > 0 && replay->responses[i - 1].key > replay_get_response_key(packet); --i) {
+				replay->responses[i] = replay->responses[i - 1];
+			}
+
+			replay->responses[i].key = replay_get_response_key(packet);
+			replay->responses[i].response = packet;
+
+			++replay->response_count;
+		}
+	}
+
+	return replay;
 }
 
 /*****************************************************************************
  *
- *                                 IPConnection
+ *                                 Latency Histogram
  *
  *****************************************************************************/
 
-struct _CallbackContext {
-	IPConnectionPrivate *ipcon_p;
-	Queue queue;
-	Mutex mutex;
-	Thread thread;
-	bool packet_dispatch_allowed;
-};
-
-static int ipcon_connect_unlocked(IPConnectionPrivate *ipcon_p, bool is_auto_reconnect);
-static void ipcon_disconnect_unlocked(IPConnectionPrivate *ipcon_p);
-
-static DevicePrivate *ipcon_acquire_device(IPConnectionPrivate *ipcon_p, uint32_t uid) {
-	DevicePrivate *device_p;
+// log-linear buckets in the style of HdrHistogram: values below 16 get a
+// bucket each, then every power of two is split into 8 equally wide buckets.
+// this keeps the relative error at 12.5% or less over the whole uint32 range
+// with 240 buckets. all counters are updated atomically, so several threads
+// can record into the same histogram without locking
 
-	mutex_lock(&ipcon_p->devices_ref_mutex);
+#define LATENCY_LINEAR_BITS 4
+#define LATENCY_LINEAR_BUCKETS (1 << LATENCY_LINEAR_BITS)
+#define LATENCY_SUB_BUCKET_BITS 3
 
-	device_p = (DevicePrivate *)table_get(&ipcon_p->devices, uid);
+static int latency_get_bucket(uint32_t value) {
+	uint32_t rest = value;
+	int msb = 0;
 
-	if (device_p != NULL) {
-		++device_p->ref_count;
+	if (value < LATENCY_LINEAR_BUCKETS) {
+		return (int)value;
 	}
 
-	mutex_unlock(&ipcon_p->devices_ref_mutex);
+	if (rest >= 1u << 16) { rest >>= 16; msb += 16; }
+	if (rest >= 1u << 8) { rest >>= 8; msb += 8; }
+	if (rest >= 1u << 4) { rest >>= 4; msb += 4; }
+	if (rest >= 1u << 2) { rest >>= 2; msb += 2; }
+	if (rest >= 1u << 1) { msb += 1; }
 
-	return device_p;
+	return LATENCY_LINEAR_BUCKETS + ((msb - LATENCY_LINEAR_BITS) << LATENCY_SUB_BUCKET_BITS) +
+	       (int)((value >> (msb - LATENCY_SUB_BUCKET_BITS)) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1));
 }
 
-static void ipcon_dispatch_meta(IPConnectionPrivate *ipcon_p, Meta *meta) {
-	ConnectedCallbackFunction connected_callback_function;
-	DisconnectedCallbackFunction disconnected_callback_function;
-	void *user_data;
-	bool retry;
+static void latency_histogram_record(LatencyHistogram *histogram, uint64_t latency) { // in usec
+	uint32_t value = latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency;
+	uint32_t max;
 
-	if (meta->function_id == IPCON_CALLBACK_CONNECTED) {
-		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_CONNECTED] != NULL) {
-			*(void **)(&connected_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_CONNECTED];
-			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_CONNECTED];
+	atomic_add_uint32(&histogram->buckets[latency_get_bucket(value)], 1);
+	atomic_add_uint64(&histogram->count, 1);
+	atomic_add_uint64(&histogram->sum, value);
 
-			connected_callback_function(meta->parameter, user_data);
-		}
-	} else if (meta->function_id == IPCON_CALLBACK_DISCONNECTED) {
-		// need to do this here, the receive loop is not allowed to
-		// hold the socket mutex because this could cause a deadlock
-		// with a concurrent call to the (dis-)connect function
-		if (meta->parameter != IPCON_DISCONNECT_REASON_REQUEST) {
-			mutex_lock(&ipcon_p->socket_mutex);
+	max = atomic_load_uint32(&histogram->max);
 
-			// don't close the socket if it got disconnected or
-			// reconnected in the meantime
-			if (ipcon_p->socket != NULL && ipcon_p->socket_id == meta->socket_id) {
-				// destroy disconnect probe thread
-				event_set(&ipcon_p->disconnect_probe_event);
-				thread_join(&ipcon_p->disconnect_probe_thread);
-				thread_destroy(&ipcon_p->disconnect_probe_thread);
+	while (value > max && !atomic_compare_exchange_uint32(&histogram->max, max, value)) {
+		max = atomic_load_uint32(&histogram->max);
+	}
+}
 
-				// destroy socket
-				socket_destroy(ipcon_p->socket);
-				free(ipcon_p->socket);
-				ipcon_p->socket = NULL;
-			}
+static void latency_histogram_copy(LatencyHistogram *copy, LatencyHistogram *histogram) {
+	int i;
 
-			mutex_unlock(&ipcon_p->socket_mutex);
-		}
+	copy->count = atomic_load_uint64(&histogram->count);
+	copy->sum = atomic_load_uint64(&histogram->sum);
+	copy->max = atomic_load_uint32(&histogram->max);
+	copy->timeouts = atomic_load_uint32(&histogram->timeouts);
 
-		// FIXME: wait a moment here, otherwise the next connect
-		// attempt will succeed, even if there is no open server
-		// socket. the first receive will then fail directly
-		millisleep(100);
+	for (i = 0; i < IPCON_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		copy->buckets[i] = atomic_load_uint32(&histogram->buckets[i]);
+	}
+}
 
-		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_DISCONNECTED] != NULL) {
-			*(void **)(&disconnected_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_DISCONNECTED];
-			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_DISCONNECTED];
+static void latency_histogram_reset(LatencyHistogram *histogram) {
+	int i;
 
-			disconnected_callback_function(meta->parameter, user_data);
-		}
+	atomic_store_uint64(&histogram->count, 0);
+	atomic_store_uint64(&histogram->sum, 0);
+	atomic_store_uint32(&histogram->max, 0);
+	atomic_store_uint32(&histogram->timeouts, 0);
 
-		if (meta->parameter != IPCON_DISCONNECT_REASON_REQUEST &&
-			ipcon_p->auto_reconnect && ipcon_p->auto_reconnect_allowed) {
-			ipcon_p->auto_reconnect_pending = true;
-			retry = true;
+	for (i = 0; i < IPCON_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		atomic_store_uint32(&histogram->buckets[i], 0);
+	}
+}
 
-			// block here until reconnect. this is okay, there is no
-			// callback to deliver when there is no connection
-			while (retry) {
-				retry = false;
+/*****************************************************************************
+ *
+ *                                 Device
+ *
+ *****************************************************************************/
 
-				mutex_lock(&ipcon_p->socket_mutex);
+enum {
+	IPCON_FUNCTION_ENUMERATE = 254
+};
 
-				if (ipcon_p->auto_reconnect_allowed && ipcon_p->socket == NULL) {
-					if (ipcon_connect_unlocked(ipcon_p, true) < 0) {
-						retry = true;
-					}
-				} else {
-					ipcon_p->auto_reconnect_pending = false;
-				}
+static int ipcon_send_request(IPConnectionPrivate *ipcon_p, Packet *request);
+static DevicePrivate *ipcon_acquire_device(IPConnectionPrivate *ipcon_p, uint32_t uid);
 
-				mutex_unlock(&ipcon_p->socket_mutex);
+// NOTE: assumes device_p->ref_count == 0
+static void device_destroy(DevicePrivate *device_p) {
+	int i;
 
-				if (retry) {
-					// wait a moment to give another thread a chance to
-					// interrupt the auto-reconnect
-					millisleep(100);
-				}
-			}
+	table_remove(&device_p->ipcon_p->devices, device_p->uid, device_p);
+
+	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
+		free(device_p->high_level_callbacks[i].data);
+	}
+
+	if (device_p->latency_histograms != NULL) {
+		for (i = 0; i < DEVICE_NUM_FUNCTION_IDS * IPCON_NUM_LATENCY_KINDS; i++) {
+			free(device_p->latency_histograms[i]);
 		}
+
+		free(device_p->latency_histograms);
 	}
+
+	mutex_destroy(&device_p->stream_mutex);
+
+	free(device_p);
 }
 
-static void ipcon_dispatch_packet(IPConnectionPrivate *ipcon_p, Packet *packet) {
-	EnumerateCallbackFunction enumerate_callback_function;
-	void *user_data;
-	EnumerateCallback *enumerate_callback;
+void device_create(Device *device, const char *uid_str,
+                   IPConnectionPrivate *ipcon_p, uint8_t api_version_major,
+                   uint8_t api_version_minor, uint8_t api_version_release) {
 	DevicePrivate *device_p;
-	CallbackWrapperFunction callback_wrapper_function;
+	int i;
 
-	if (packet->header.function_id == IPCON_CALLBACK_ENUMERATE) {
-		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE] != NULL) {
-			*(void **)(&enumerate_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE];
-			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_ENUMERATE];
-			enumerate_callback = (EnumerateCallback *)packet;
+	device_p = (DevicePrivate *)malloc(sizeof(DevicePrivate));
+	device->p = device_p;
 
-			enumerate_callback_function(enumerate_callback->uid,
-			                            enumerate_callback->connected_uid,
-			                            enumerate_callback->position,
-			                            enumerate_callback->hardware_version,
-			                            enumerate_callback->firmware_version,
-			                            leconvert_uint16_from(enumerate_callback->device_identifier),
-			                            enumerate_callback->enumeration_type,
-			                            user_data);
-		}
-	} else {
-		device_p = ipcon_acquire_device(ipcon_p, packet->header.uid);
+	device_p->ref_count = 1;
 
-		if (device_p == NULL) {
-			return;
-		}
+	device_p->uid = ipcon_uid_from_string(uid_str);
 
-		callback_wrapper_function = device_p->callback_wrappers[packet->header.function_id];
+	device_p->ipcon_p = ipcon_p;
 
-		if (callback_wrapper_function == NULL) {
-			device_release(device_p);
+	device_p->api_version[0] = api_version_major;
+	device_p->api_version[1] = api_version_minor;
+	device_p->api_version[2] = api_version_release;
 
-			return;
-		}
+	// response
+	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
+		device_p->response_expected[i] = DEVICE_RESPONSE_EXPECTED_INVALID_FUNCTION_ID;
+	}
 
-		callback_wrapper_function(device_p, packet);
+	// stream
+	mutex_create(&device_p->stream_mutex);
 
-		device_release(device_p);
+	// callbacks
+	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS * 2; i++) {
+		device_p->registered_callbacks[i] = NULL;
+		device_p->registered_callback_user_data[i] = NULL;
+	}
+
+	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; i++) {
+		device_p->callback_wrappers[i] = NULL;
+		device_p->high_level_callbacks[i].exists = false;
+		device_p->high_level_callbacks[i].data = NULL;
+		device_p->high_level_callbacks[i].length = 0;
 	}
+
+	device_p->callbacks_stopped = 0;
+	device_p->dispatch_count = 0;
+
+	// latency
+	device_p->latency_histograms = NULL;
+
+	// add to IPConnection
+	table_insert(&ipcon_p->devices, device_p->uid, device_p);
 }
 
-static void ipcon_destroy_callback_context(CallbackContext *callback) {
-	thread_destroy(&callback->thread);
-	mutex_destroy(&callback->mutex);
-	queue_destroy(&callback->queue);
+// a device whose reference count already dropped to zero is about to be
+// destroyed and must not be revived
+static bool device_acquire(DevicePrivate *device_p) {
+	uint32_t ref_count;
 
-	free(callback);
+	while (true) {
+		ref_count = atomic_load_uint32(&device_p->ref_count);
+
+		if (ref_count == 0) {
+			return false;
+		}
+
+		if (atomic_compare_exchange_uint32(&device_p->ref_count, ref_count, ref_count + 1)) {
+			return true;
+		}
+	}
 }
 
-static void ipcon_exit_callback_thread(CallbackContext *callback) {
-	if (!thread_is_current(&callback->thread)) {
-		queue_put(&callback->queue, QUEUE_KIND_EXIT, NULL);
+void device_release(DevicePrivate *device_p) {
+	if (atomic_add_uint32(&device_p->ref_count, -1) == 0) {
+		device_destroy(device_p);
+	}
+}
 
-		thread_join(&callback->thread);
+// NOTE: a callback thread first counts itself as dispatching and then checks
+//       the flag, the stopping thread first sets the flag and then checks the
+//       count, both with a fence in between. so either the callback is not
+//       called or the stopping thread waits for it
+void device_stop_callbacks(DevicePrivate *device_p) {
+	atomic_store_uint32(&device_p->callbacks_stopped, 1);
+	atomic_fence();
 
-		ipcon_destroy_callback_context(callback);
-	} else {
-		queue_put(&callback->queue, QUEUE_KIND_DESTROY_AND_EXIT, NULL);
+	while (atomic_load_uint32(&device_p->dispatch_count) > 0) {
+		millisleep(1);
 	}
 }
 
-static void ipcon_callback_loop(void *opaque) {
-	CallbackContext *callback = (CallbackContext *)opaque;
-	int kind;
-	void *data;
+// the histograms are allocated on first use and only freed with the device,
+// so recording doesn't have to lock once they exist
+static LatencyHistogram *device_get_latency_histogram(DevicePrivate *device_p,
+                                                      uint8_t function_id, int kind) {
+	IPConnectionPrivate *ipcon_p = device_p->ipcon_p;
+	LatencyHistogram **histograms;
+	LatencyHistogram *histogram = NULL;
+	int index = function_id * IPCON_NUM_LATENCY_KINDS + kind;
 
-	while (true) {
-		if (queue_get(&callback->queue, &kind, &data) < 0) {
-			// FIXME: what to do here? try again? exit?
-			break;
-		}
+	histograms = (LatencyHistogram **)atomic_load_pointer((void *volatile *)&device_p->latency_histograms);
 
-		if (kind == QUEUE_KIND_EXIT) {
-			break;
-		} else if (kind == QUEUE_KIND_DESTROY_AND_EXIT) {
-			ipcon_destroy_callback_context(callback);
-			break;
-		}
+	if (histograms != NULL) {
+		histogram = (LatencyHistogram *)atomic_load_pointer((void *volatile *)&histograms[index]);
+	}
 
-		// FIXME: cannot lock callback mutex here because this can
-		//        deadlock due to an ordering problem with the socket mutex
-		//mutex_lock(&callback->mutex);
+	if (histogram != NULL) {
+		return histogram;
+	}
 
-		if (kind == QUEUE_KIND_META) {
-			ipcon_dispatch_meta(callback->ipcon_p, (Meta *)data);
-		} else if (kind == QUEUE_KIND_PACKET) {
-			// don't dispatch callbacks when the receive thread isn't running
-			if (callback->packet_dispatch_allowed) {
-				ipcon_dispatch_packet(callback->ipcon_p, (Packet *)data);
-			}
-		}
+	mutex_lock(&ipcon_p->latency_mutex);
 
-		//mutex_unlock(&callback->mutex);
+	histograms = device_p->latency_histograms;
 
-		free(data);
+	if (histograms == NULL) {
+		histograms = (LatencyHistogram **)calloc(DEVICE_NUM_FUNCTION_IDS * IPCON_NUM_LATENCY_KINDS,
+		                                         sizeof(LatencyHistogram *));
+
+		atomic_store_pointer((void *volatile *)&device_p->latency_histograms, histograms);
 	}
-}
 
-// NOTE: assumes that socket_mutex is locked if disconnect_immediately is true
-static void ipcon_handle_disconnect_by_peer(IPConnectionPrivate *ipcon_p,
-                                            uint8_t disconnect_reason,
-                                            uint64_t socket_id,
-                                            bool disconnect_immediately) {
-	Meta *meta;
+	histogram = histograms[index];
 
-	ipcon_p->auto_reconnect_allowed = true;
+	if (histogram == NULL) {
+		histogram = (LatencyHistogram *)calloc(1, sizeof(LatencyHistogram));
 
-	if (disconnect_immediately) {
-		ipcon_disconnect_unlocked(ipcon_p);
+		atomic_store_pointer((void *volatile *)&histograms[index], histogram);
 	}
 
-	meta = (Meta *)malloc(sizeof(Meta));
-	meta->function_id = IPCON_CALLBACK_DISCONNECTED;
-	meta->parameter = disconnect_reason;
-	meta->socket_id = socket_id;
+	mutex_unlock(&ipcon_p->latency_mutex);
 
-	queue_put(&ipcon_p->callback->queue, QUEUE_KIND_META, meta);
+	return histogram;
 }
 
-enum {
-	IPCON_DISCONNECT_PROBE_INTERVAL = 5000
-};
+static void device_record_latency(DevicePrivate *device_p, uint8_t function_id,
+                                  int kind, uint64_t latency) { // in usec
+	latency_histogram_record(device_get_latency_histogram(device_p, function_id, kind), latency);
+}
 
-enum {
-	IPCON_FUNCTION_DISCONNECT_PROBE = 128
-};
+static void device_record_timeout(DevicePrivate *device_p, uint8_t function_id) {
+	atomic_add_uint32(&device_get_latency_histogram(device_p, function_id,
+	                                                IPCON_LATENCY_ROUND_TRIP)->timeouts, 1);
+}
 
-// NOTE: the disconnect probe loop is not allowed to hold the socket_mutex at any
-//       time because it is created and joined while the socket_mutex is locked
-static void ipcon_disconnect_probe_loop(void *opaque) {
-	IPConnectionPrivate *ipcon_p = (IPConnectionPrivate *)opaque;
-	PacketHeader disconnect_probe;
+int device_get_response_expected(DevicePrivate *device_p, uint8_t function_id,
+                                 bool *ret_response_expected) {
+	int flag = device_p->response_expected[function_id];
 
-	packet_header_create(&disconnect_probe, sizeof(PacketHeader),
-	                     IPCON_FUNCTION_DISCONNECT_PROBE, ipcon_p, NULL);
+	if (flag == DEVICE_RESPONSE_EXPECTED_INVALID_FUNCTION_ID) {
+		return E_INVALID_PARAMETER;
+	}
 
-	while (event_wait(&ipcon_p->disconnect_probe_event,
-	                  IPCON_DISCONNECT_PROBE_INTERVAL) < 0) {
-		if (ipcon_p->disconnect_probe_flag) {
-			// FIXME: this might block
-			if (socket_send(ipcon_p->socket, &disconnect_probe,
-			                disconnect_probe.length) < 0) {
-				ipcon_handle_disconnect_by_peer(ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
-				                                ipcon_p->socket_id, false);
-				break;
-			}
-		} else {
-			ipcon_p->disconnect_probe_flag = true;
-		}
+	if (flag == DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE ||
+	    flag == DEVICE_RESPONSE_EXPECTED_TRUE) {
+		*ret_response_expected = true;
+	} else {
+		*ret_response_expected = false;
 	}
+
+	return E_OK;
 }
 
-static void ipcon_handle_response(IPConnectionPrivate *ipcon_p, Packet *response) {
-	DevicePrivate *device_p;
-	uint8_t sequence_number = packet_header_get_sequence_number(&response->header);
-	Packet *callback;
+int device_set_response_expected(DevicePrivate *device_p, uint8_t function_id,
+                                 bool response_expected) {
+	int current_flag = device_p->response_expected[function_id];
+
+	if (current_flag != DEVICE_RESPONSE_EXPECTED_TRUE &&
+	    current_flag != DEVICE_RESPONSE_EXPECTED_FALSE) {
+		return E_INVALID_PARAMETER;
+	}
+
+	device_p->response_expected[function_id] =
+	    response_expected ? DEVICE_RESPONSE_EXPECTED_TRUE
+	                      : DEVICE_RESPONSE_EXPECTED_FALSE;
+
+	return E_OK;
+}
+
+int device_set_response_expected_all(DevicePrivate *device_p, bool response_expected) {
+	int flag = response_expected ? DEVICE_RESPONSE_EXPECTED_TRUE
+	                             : DEVICE_RESPONSE_EXPECTED_FALSE;
+	int i;
+
+	for (i = 0; i < DEVICE_NUM_FUNCTION_IDS; ++i) {
+		if (device_p->response_expected[i] == DEVICE_RESPONSE_EXPECTED_TRUE ||
+		    device_p->response_expected[i] == DEVICE_RESPONSE_EXPECTED_FALSE) {
+			device_p->response_expected[i] = flag;
+		}
+	}
+
+	return E_OK;
+}
+
+void device_register_callback(DevicePrivate *device_p, int16_t callback_id,
+                              void *function, void *user_data) {
+	if (callback_id <= -DEVICE_NUM_FUNCTION_IDS || callback_id >= DEVICE_NUM_FUNCTION_IDS) {
+		return;
+	}
+
+	device_p->registered_callbacks[DEVICE_NUM_FUNCTION_IDS + callback_id] = function;
+	device_p->registered_callback_user_data[DEVICE_NUM_FUNCTION_IDS + callback_id] = user_data;
+}
+
+int device_get_api_version(DevicePrivate *device_p, uint8_t ret_api_version[3]) {
+	ret_api_version[0] = device_p->api_version[0];
+	ret_api_version[1] = device_p->api_version[1];
+	ret_api_version[2] = device_p->api_version[2];
+
+	return E_OK;
+}
+
+static int device_get_error_code(Packet *response) {
+	uint8_t error_code = packet_header_get_error_code(&response->header);
+
+	if (error_code == 0) {
+		return E_OK;
+	} else if (error_code == 1) {
+		return E_INVALID_PARAMETER;
+	} else if (error_code == 2) {
+		return E_NOT_SUPPORTED;
+	} else {
+		return E_UNKNOWN_ERROR_CODE;
+	}
+}
+
+// NOTE: assumes that pending_request_mutex is locked and that an unused
+//       pending request was reserved from the pending_request_semaphore
+static PendingRequest *device_reserve_pending_request(DevicePrivate *device_p, Packet *request) {
+	IPConnectionPrivate *ipcon_p = device_p->ipcon_p;
+	uint8_t sequence_number = packet_header_get_sequence_number(&request->header);
+	PendingRequest *pending_request;
+	int i;
+
+	// the sequence number of the request is still in flight because of a
+	// slow request on another thread, use the next unused one instead
+	if (ipcon_p->pending_requests[sequence_number].in_use) {
+		for (i = 1; i < IPCON_NUM_SEQUENCE_NUMBERS; ++i) {
+			sequence_number = sequence_number % (IPCON_NUM_SEQUENCE_NUMBERS - 1) + 1;
+
+			if (!ipcon_p->pending_requests[sequence_number].in_use) {
+				break;
+			}
+		}
+
+		request->header.sequence_number_and_options &= ~0xF0;
+		packet_header_set_sequence_number(&request->header, sequence_number);
+	}
+
+	pending_request = &ipcon_p->pending_requests[sequence_number];
+
+	pending_request->in_use = true;
+	pending_request->done = false;
+	pending_request->uid = device_p->uid;
+	pending_request->function_id = request->header.function_id;
+	pending_request->response_wrapper = NULL;
+	pending_request->response_function = NULL;
+	pending_request->response_user_data = NULL;
+	pending_request->deadline = 0;
+	pending_request->low_latency = ipcon_p->low_latency;
+	pending_request->send_timestamp = ipcon_p->latency_tracking ? get_monotonic_usec() : 0;
+	pending_request->serial = ++ipcon_p->next_request_serial;
+
+	return pending_request;
+}
+
+#ifdef IPCON_HAVE_FUTEX
+
+// spin about as long as a response took recently, but don't spin at all if
+// responses are too slow for spinning to pay off
+static int device_wait_for_completion(IPConnectionPrivate *ipcon_p,
+                                      PendingRequest *pending_request) {
+	uint32_t average = atomic_load_uint32(&ipcon_p->completion_wait_average);
+	uint32_t waited;
+
+	if (completion_wait(&pending_request->completion, ipcon_p->timeout,
+	                    atomic_load_uint32(&ipcon_p->completion_spin), &waited) < 0) {
+		return E_TIMEOUT;
+	}
+
+	average = (average * 7 + waited) / 8;
+
+	atomic_store_uint32(&ipcon_p->completion_wait_average, average);
+	atomic_store_uint32(&ipcon_p->completion_spin,
+	                    average + average / 2 <= ipcon_p->completion_spin_max ? average + average / 2 : 0);
+
+	return E_OK;
+}
+
+#endif
+
+// responses are matched by sequence number against the pending requests of
+// the IP Connection. this allows to have a request in flight for every
+// sequence number at the same time, also for the same device
+int device_send_request(DevicePrivate *device_p, Packet *request, Packet *response) {
+	IPConnectionPrivate *ipcon_p = device_p->ipcon_p;
+	int ret = E_OK;
+	uint8_t response_expected = packet_header_get_response_expected(&request->header);
+	PendingRequest *pending_request;
+	bool done;
+	uint64_t send_timestamp;
+
+	if (!response_expected) {
+		return ipcon_send_request(ipcon_p, request);
+	}
+
+	semaphore_acquire(&ipcon_p->pending_request_semaphore);
+
+	mutex_lock(&ipcon_p->pending_request_mutex);
+
+	pending_request = device_reserve_pending_request(device_p, request);
+
+#ifdef IPCON_HAVE_FUTEX
+	if (pending_request->low_latency) {
+		completion_reset(&pending_request->completion);
+	} else
+#endif
+	{
+		event_reset(&pending_request->event);
+	}
+
+	mutex_unlock(&ipcon_p->pending_request_mutex);
+
+	ret = ipcon_send_request(ipcon_p, request);
+
+#ifdef IPCON_HAVE_FUTEX
+	if (pending_request->low_latency) {
+		if (ret == E_OK) {
+			ret = device_wait_for_completion(ipcon_p, pending_request);
+		}
+	} else
+#endif
+	if (ret == E_OK && event_wait(&pending_request->event, ipcon_p->timeout) < 0) {
+		ret = E_TIMEOUT;
+	}
+
+	mutex_lock(&ipcon_p->pending_request_mutex);
+
+	done = pending_request->done;
+	send_timestamp = pending_request->send_timestamp;
+
+	if (ret == E_OK) {
+		if (!done) {
+			ret = E_TIMEOUT;
+		} else {
+			ret = device_get_error_code(&pending_request->response);
+
+			if (ret == E_OK && response != NULL) {
+				memcpy(response, &pending_request->response,
+				       pending_request->response.header.length);
+			}
+		}
+	}
+
+	pending_request->in_use = false;
+
+	mutex_unlock(&ipcon_p->pending_request_mutex);
+
+	semaphore_release(&ipcon_p->pending_request_semaphore);
+
+	if (send_timestamp != 0) {
+		if (done) {
+			device_record_latency(device_p, request->header.function_id, IPCON_LATENCY_ROUND_TRIP,
+			                      get_monotonic_usec() - send_timestamp);
+		} else if (ret == E_TIMEOUT) {
+			device_record_timeout(device_p, request->header.function_id);
+		}
+	}
+
+	return ret;
+}
+
+int device_send_request_async(DevicePrivate *device_p, Packet *request,
+                              ResponseWrapperFunction response_wrapper,
+                              void *response_function, void *response_user_data) {
+	IPConnectionPrivate *ipcon_p = device_p->ipcon_p;
+	int ret;
+	PendingRequest *pending_request;
+	uint32_t serial;
+
+	if (!semaphore_try_acquire(&ipcon_p->pending_request_semaphore)) {
+		return E_WOULD_BLOCK;
+	}
+
+	// the response is always expected, otherwise there would be nothing to
+	// complete the request with
+	packet_header_set_response_expected(&request->header, 1);
+
+	mutex_lock(&ipcon_p->pending_request_mutex);
+
+	pending_request = device_reserve_pending_request(device_p, request);
+
+	pending_request->response_wrapper = response_wrapper;
+	pending_request->response_function = response_function;
+	pending_request->response_user_data = response_user_data;
+	pending_request->deadline = get_monotonic_msec() + ipcon_p->timeout;
+
+	serial = pending_request->serial;
+
+	++ipcon_p->pending_async_request_count;
+
+	mutex_unlock(&ipcon_p->pending_request_mutex);
+
+	ret = ipcon_send_request(ipcon_p, request);
+
+	if (ret != E_OK) {
+		mutex_lock(&ipcon_p->pending_request_mutex);
+
+		// a disconnect meanwhile might have expired the request already, then
+		// the response wrapper reports the failure and the request is done
+		if (!pending_request->in_use || pending_request->serial != serial) {
+			mutex_unlock(&ipcon_p->pending_request_mutex);
+
+			return E_OK;
+		}
+
+		pending_request->in_use = false;
+
+		--ipcon_p->pending_async_request_count;
+
+		mutex_unlock(&ipcon_p->pending_request_mutex);
+
+		semaphore_release(&ipcon_p->pending_request_semaphore);
+	}
+
+	return ret;
+}
+
+static Queue *ipcon_get_callback_queue(CallbackContext *callback, uint32_t uid);
+
+// asynchronous requests are completed on the callback thread of the device,
+// never on the receive thread or the reactor. the response wrapper is free
+// to send requests and to wait for responses there, like any callback. only
+// after the callback threads are gone it is called by the completing thread
+static void ipcon_complete_async_request(IPConnectionPrivate *ipcon_p, uint32_t uid,
+                                         ResponseWrapperFunction response_wrapper,
+                                         void *response_function, void *response_user_data,
+                                         int error_code, Packet *response) {
+	CallbackContext *callback = ipcon_p->callback;
+	Completion *completion;
+
+	if (callback == NULL) {
+		response_wrapper(error_code, response, response_function, response_user_data);
+
+		return;
+	}
+
+	completion = (Completion *)malloc(sizeof(Completion));
+	completion->response_wrapper = response_wrapper;
+	completion->response_function = response_function;
+	completion->response_user_data = response_user_data;
+	completion->error_code = error_code;
+	completion->has_response = response != NULL;
+
+	if (response != NULL) {
+		memcpy(&completion->response, response, response->header.length);
+	}
+
+	queue_put(ipcon_get_callback_queue(callback, uid), QUEUE_KIND_COMPLETION, completion);
+}
+
+// completes all asynchronous requests that are past their deadline (or all
+// of them if expire_all is true) with E_TIMEOUT. asynchronous requests are
+// only checked when a response arrives and on every disconnect probe, so a
+// lost response is reported after at most the timeout plus the disconnect
+// probe interval. closing the socket expires all of them, because their
+// responses cannot arrive anymore and a blocking request might be waiting
+// for their sequence numbers
+static void ipcon_expire_async_requests(IPConnectionPrivate *ipcon_p, bool expire_all) {
+	PendingRequest expired[IPCON_NUM_SEQUENCE_NUMBERS];
+	int expired_count = 0;
+	uint64_t now;
+	DevicePrivate *device_p;
+	int i;
+
+	if (atomic_load_uint32(&ipcon_p->pending_async_request_count) == 0) {
+		return;
+	}
+
+	now = get_monotonic_msec();
+
+	mutex_lock(&ipcon_p->pending_request_mutex);
+
+	for (i = 1; i < IPCON_NUM_SEQUENCE_NUMBERS; ++i) {
+		if (ipcon_p->pending_requests[i].in_use &&
+		    ipcon_p->pending_requests[i].response_wrapper != NULL &&
+		    (expire_all || ipcon_p->pending_requests[i].deadline <= now)) {
+			expired[expired_count].response_wrapper = ipcon_p->pending_requests[i].response_wrapper;
+			expired[expired_count].response_function = ipcon_p->pending_requests[i].response_function;
+			expired[expired_count].response_user_data = ipcon_p->pending_requests[i].response_user_data;
+			expired[expired_count].uid = ipcon_p->pending_requests[i].uid;
+			expired[expired_count].function_id = ipcon_p->pending_requests[i].function_id;
+			expired[expired_count].send_timestamp = ipcon_p->pending_requests[i].send_timestamp;
+
+			++expired_count;
+
+			ipcon_p->pending_requests[i].in_use = false;
+
+			--ipcon_p->pending_async_request_count;
+		}
+	}
+
+	mutex_unlock(&ipcon_p->pending_request_mutex);
+
+	for (i = 0; i < expired_count; ++i) {
+		semaphore_release(&ipcon_p->pending_request_semaphore);
+
+		if (expired[i].send_timestamp != 0) {
+			device_p = ipcon_acquire_device(ipcon_p, expired[i].uid);
+
+			if (device_p != NULL) {
+				device_record_timeout(device_p, expired[i].function_id);
+				device_release(device_p);
+			}
+		}
+
+		ipcon_complete_async_request(ipcon_p, expired[i].uid, expired[i].response_wrapper,
+		                             expired[i].response_function, expired[i].response_user_data,
+		                             E_TIMEOUT, NULL);
+	}
+}
+
+/*****************************************************************************
+ *
+ *                                 Brick Daemon
+ *
+ *****************************************************************************/
+
+enum {
+	BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE = 1,
+	BRICK_DAEMON_FUNCTION_AUTHENTICATE = 2
+};
+
+static void brickd_create(BrickDaemon *brickd, const char *uid, IPConnection *ipcon) {
+	DevicePrivate *device_p;
+
+	device_create(brickd, uid, ipcon->p, 2, 0, 0);
+
+	device_p = brickd->p;
+
+	device_p->response_expected[BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE] = DEVICE_RESPONSE_EXPECTED_ALWAYS_TRUE;
+	device_p->response_expected[BRICK_DAEMON_FUNCTION_AUTHENTICATE] = DEVICE_RESPONSE_EXPECTED_TRUE;
+}
+
+static void brickd_destroy(BrickDaemon *brickd) {
+	device_release(brickd->p);
+}
+
+static int brickd_get_authentication_nonce(BrickDaemon *brickd, uint8_t ret_server_nonce[4]) {
+	DevicePrivate *device_p = brickd->p;
+	GetAuthenticationNonce request;
+	GetAuthenticationNonceResponse response;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), BRICK_DAEMON_FUNCTION_GET_AUTHENTICATION_NONCE, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = device_send_request(device_p, (Packet *)&request, (Packet *)&response);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	memcpy(ret_server_nonce, response.server_nonce, 4 * sizeof(uint8_t));
+
+	return ret;
+}
+
+static int brickd_authenticate(BrickDaemon *brickd, uint8_t client_nonce[4], uint8_t digest[20]) {
+	DevicePrivate *device_p = brickd->p;
+	Authenticate request;
+	int ret;
+
+	ret = packet_header_create(&request.header, sizeof(request), BRICK_DAEMON_FUNCTION_AUTHENTICATE, device_p->ipcon_p, device_p);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	memcpy(request.client_nonce, client_nonce, 4 * sizeof(uint8_t));
+	memcpy(request.digest, digest, 20 * sizeof(uint8_t));
+
+	ret = device_send_request(device_p, (Packet *)&request, NULL);
+
+	return ret;
+}
+
+/*****************************************************************************
+ *
+ *                                 IPConnection
+ *
+ *****************************************************************************/
+
+typedef struct {
+	CallbackContext *callback;
+	Queue queue;
+	Thread thread;
+	uint64_t dispatch_count; // atomic
+	uint64_t latency_sum; // in usec from receive to end of dispatch, atomic
+	uint32_t latency_max; // in usec, atomic
+	uint64_t dispatch_timestamp; // receive time of the dispatched packet, in usec
+} CallbackWorker;
+
+// packet callbacks are sharded by UID over the workers, this keeps them in
+// order per device. worker 0 also dispatches all meta callbacks and the
+// enumerate callback
+struct _CallbackContext {
+	IPConnectionPrivate *ipcon_p;
+	Mutex mutex;
+	bool packet_dispatch_allowed;
+	int worker_count;
+	CallbackWorker *workers;
+};
+
+static int ipcon_connect_unlocked(IPConnectionPrivate *ipcon_p, bool is_auto_reconnect);
+static void ipcon_disconnect_unlocked(IPConnectionPrivate *ipcon_p);
+#ifdef IPCON_HAVE_REACTOR
+static void reactor_unregister(IPConnectionPrivate *ipcon_p);
+#endif
+
+static DevicePrivate *ipcon_acquire_device(IPConnectionPrivate *ipcon_p, uint32_t uid) {
+	DevicePrivate *device_p;
+	uint32_t epoch;
+
+	epoch = table_read_lock(&ipcon_p->devices);
+
+	device_p = (DevicePrivate *)table_get(&ipcon_p->devices, uid);
+
+	if (device_p != NULL && !device_acquire(device_p)) {
+		device_p = NULL;
+	}
+
+	table_read_unlock(&ipcon_p->devices, epoch);
+
+	return device_p;
+}
+
+// returns a malloc'ed array of all devices that could be acquired, the caller
+// has to release them
+static DevicePrivate **ipcon_acquire_devices(IPConnectionPrivate *ipcon_p, int *ret_count) {
+	Table *table = &ipcon_p->devices;
+	DevicePrivate **devices;
+	DevicePrivate *device_p;
+	uint32_t i;
+
+	*ret_count = 0;
+
+	mutex_lock(&table->mutex);
+
+	devices = (DevicePrivate **)malloc(sizeof(DevicePrivate *) * (table->count + 1));
+
+	for (i = 0; i <= table->slots->mask; ++i) {
+		device_p = (DevicePrivate *)table->slots->slots[i].value;
+
+		if (table->slots->slots[i].state != 0 && device_p != NULL && device_acquire(device_p)) {
+			devices[(*ret_count)++] = device_p;
+		}
+	}
+
+	mutex_unlock(&table->mutex);
+
+	return devices;
+}
+
+static void ipcon_dispatch_meta(IPConnectionPrivate *ipcon_p, Meta *meta) {
+	ConnectedCallbackFunction connected_callback_function;
+	DisconnectedCallbackFunction disconnected_callback_function;
+	void *user_data;
+	bool retry;
+
+	if (meta->function_id == IPCON_META_REPLAY_BARRIER) {
+		event_set(&ipcon_p->replay->barrier);
+	} else if (meta->function_id == IPCON_CALLBACK_CONNECTED) {
+		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_CONNECTED] != NULL) {
+			*(void **)(&connected_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_CONNECTED];
+			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_CONNECTED];
+
+			connected_callback_function(meta->parameter, user_data);
+		}
+	} else if (meta->function_id == IPCON_CALLBACK_DISCONNECTED) {
+		// need to do this here, the receive loop is not allowed to
+		// hold the socket mutex because this could cause a deadlock
+		// with a concurrent call to the (dis-)connect function
+		if (meta->parameter != IPCON_DISCONNECT_REASON_REQUEST) {
+			mutex_lock(&ipcon_p->socket_mutex);
+
+			// don't close the socket if it got disconnected or
+			// reconnected in the meantime
+			if (ipcon_p->socket != NULL && ipcon_p->socket_id == meta->socket_id) {
+#ifdef IPCON_HAVE_REACTOR
+				if (ipcon_p->reactor_slot >= 0) {
+					ipcon_p->receive_flag = false;
+
+					reactor_unregister(ipcon_p);
+				} else
+#endif
+				{
+					// destroy disconnect probe thread
+					ipcon_p->disconnect_probe_stop = true;
+
+					event_set(&ipcon_p->disconnect_probe_event);
+					thread_join(&ipcon_p->disconnect_probe_thread);
+					thread_destroy(&ipcon_p->disconnect_probe_thread);
+				}
+
+				// destroy socket
+				socket_destroy(ipcon_p->socket);
+				free(ipcon_p->socket);
+				ipcon_p->socket = NULL;
+
+				// the responses of requests still in flight cannot arrive anymore
+				ipcon_expire_async_requests(ipcon_p, true);
+			}
+
+			mutex_unlock(&ipcon_p->socket_mutex);
+		}
+
+		// FIXME: wait a moment here, otherwise the next connect
+		// attempt will succeed, even if there is no open server
+		// socket. the first receive will then fail directly
+		millisleep(100);
+
+		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_DISCONNECTED] != NULL) {
+			*(void **)(&disconnected_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_DISCONNECTED];
+			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_DISCONNECTED];
+
+			disconnected_callback_function(meta->parameter, user_data);
+		}
+
+		if (meta->parameter != IPCON_DISCONNECT_REASON_REQUEST &&
+			ipcon_p->auto_reconnect && ipcon_p->auto_reconnect_allowed) {
+			ipcon_p->auto_reconnect_pending = true;
+			retry = true;
+
+			// block here until reconnect. this is okay, there is no
+			// callback to deliver when there is no connection
+			while (retry) {
+				retry = false;
+
+				mutex_lock(&ipcon_p->socket_mutex);
+
+				if (ipcon_p->auto_reconnect_allowed && ipcon_p->socket == NULL) {
+					if (ipcon_connect_unlocked(ipcon_p, true) < 0) {
+						retry = true;
+					}
+				} else {
+					ipcon_p->auto_reconnect_pending = false;
+				}
+
+				mutex_unlock(&ipcon_p->socket_mutex);
+
+				if (retry) {
+					// wait a moment to give another thread a chance to
+					// interrupt the auto-reconnect
+					millisleep(100);
+				}
+			}
+		}
+	}
+}
+
+static void ipcon_dispatch_packet(IPConnectionPrivate *ipcon_p, Packet *packet,
+                                  uint64_t timestamp) {
+	EnumerateCallbackFunction enumerate_callback_function;
+	void *user_data;
+	EnumerateCallback *enumerate_callback;
+	char uid[9];
+	char connected_uid[9];
+	DevicePrivate *device_p;
+	CallbackWrapperFunction callback_wrapper_function;
+	uint8_t function_id = packet->header.function_id;
+	uint64_t start = 0;
+
+	if (packet->header.function_id == IPCON_CALLBACK_ENUMERATE) {
+		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE] != NULL) {
+			*(void **)(&enumerate_callback_function) = ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE];
+			user_data = ipcon_p->registered_callback_user_data[IPCON_CALLBACK_ENUMERATE];
+			enumerate_callback = (EnumerateCallback *)packet;
+
+			// NOTE: the UIDs are only zero terminated if they are shorter
+			//       than 8 characters
+			memcpy(uid, enumerate_callback->uid, 8);
+			uid[8] = '\0';
+
+			memcpy(connected_uid, enumerate_callback->connected_uid, 8);
+			connected_uid[8] = '\0';
+
+			enumerate_callback_function(uid,
+			                            connected_uid,
+			                            enumerate_callback->position,
+			                            enumerate_callback->hardware_version,
+			                            enumerate_callback->firmware_version,
+			                            leconvert_uint16_from(enumerate_callback->device_identifier),
+			                            enumerate_callback->enumeration_type,
+			                            user_data);
+		}
+	} else {
+		device_p = ipcon_acquire_device(ipcon_p, packet->header.uid);
+
+		if (device_p == NULL) {
+			return;
+		}
+
+		callback_wrapper_function = device_p->callback_wrappers[packet->header.function_id];
+
+		if (callback_wrapper_function == NULL) {
+			device_release(device_p);
+
+			return;
+		}
+
+		atomic_add_uint32(&device_p->dispatch_count, 1);
+		atomic_fence();
+
+		if (atomic_load_uint32(&device_p->callbacks_stopped) != 0) {
+			atomic_add_uint32(&device_p->dispatch_count, -1);
+			device_release(device_p);
+
+			return;
+		}
+
+		if (ipcon_p->latency_tracking) {
+			start = get_monotonic_usec();
+		}
+
+		callback_wrapper_function(device_p, packet);
+
+		atomic_add_uint32(&device_p->dispatch_count, -1);
+
+		if (start != 0) {
+			device_record_latency(device_p, function_id, IPCON_LATENCY_QUEUE_WAIT, start - timestamp);
+			device_record_latency(device_p, function_id, IPCON_LATENCY_EXECUTION, get_monotonic_usec() - start);
+		}
+
+		device_release(device_p);
+	}
+}
+
+static void ipcon_dispatch_completion(Completion *completion) {
+	completion->response_wrapper(completion->error_code,
+	                             completion->has_response ? &completion->response : NULL,
+	                             completion->response_function,
+	                             completion->response_user_data);
+}
+
+static void ipcon_callback_loop(void *opaque);
+
+static CallbackContext *ipcon_create_callback_context(IPConnectionPrivate *ipcon_p) {
+	CallbackContext *callback = (CallbackContext *)malloc(sizeof(CallbackContext));
+	CallbackWorker *worker;
+	int i;
+
+	callback->ipcon_p = ipcon_p;
+	callback->packet_dispatch_allowed = false;
+	callback->worker_count = ipcon_p->callback_worker_count;
+	callback->workers = (CallbackWorker *)malloc(sizeof(CallbackWorker) * callback->worker_count);
+
+	mutex_create(&callback->mutex);
+
+	for (i = 0; i < callback->worker_count; ++i) {
+		worker = &callback->workers[i];
+
+		worker->callback = callback;
+		worker->dispatch_count = 0;
+		worker->latency_sum = 0;
+		worker->latency_max = 0;
+
+		queue_create(&worker->queue, ipcon_p->callback_queue_capacity,
+		             ipcon_p->callback_queue_policy, &ipcon_p->receive_flag);
+
+		if (thread_create(&worker->thread, ipcon_callback_loop, worker) < 0) {
+			queue_destroy(&worker->queue);
+
+			while (--i >= 0) {
+				queue_put(&callback->workers[i].queue, QUEUE_KIND_EXIT, NULL);
+				thread_join(&callback->workers[i].thread);
+				thread_destroy(&callback->workers[i].thread);
+				queue_destroy(&callback->workers[i].queue);
+			}
+
+			mutex_destroy(&callback->mutex);
+
+			free(callback->workers);
+			free(callback);
+
+			return NULL;
+		}
+	}
+
+	return callback;
+}
+
+// NOTE: assumes that worker 0 has exited already or that it is the caller
+static void ipcon_destroy_callback_context(CallbackContext *callback) {
+	int i;
+
+	for (i = 1; i < callback->worker_count; ++i) {
+		queue_put(&callback->workers[i].queue, QUEUE_KIND_EXIT, NULL);
+	}
+
+	for (i = 1; i < callback->worker_count; ++i) {
+		thread_join(&callback->workers[i].thread);
+	}
+
+	for (i = 0; i < callback->worker_count; ++i) {
+		thread_destroy(&callback->workers[i].thread);
+		queue_destroy(&callback->workers[i].queue);
+	}
+
+	mutex_destroy(&callback->mutex);
+
+	free(callback->workers);
+	free(callback);
+}
+
+static bool ipcon_is_callback_thread(CallbackContext *callback) {
+	int i;
+
+	for (i = 0; i < callback->worker_count; ++i) {
+		if (thread_is_current(&callback->workers[i].thread)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static Queue *ipcon_get_callback_queue(CallbackContext *callback, uint32_t uid) {
+	return &callback->workers[table_hash(uid) % callback->worker_count].queue;
+}
+
+static void ipcon_exit_callback_thread(CallbackContext *callback) {
+	if (!ipcon_is_callback_thread(callback)) {
+		queue_put(&callback->workers[0].queue, QUEUE_KIND_EXIT, NULL);
+
+		thread_join(&callback->workers[0].thread);
+
+		ipcon_destroy_callback_context(callback);
+	} else {
+		// worker 0 destroys the context, it joins the other workers. if
+		// the caller is one of them then it exits after returning from
+		// the current callback
+		queue_put(&callback->workers[0].queue, QUEUE_KIND_DESTROY_AND_EXIT, NULL);
+	}
+}
+
+static void ipcon_callback_loop(void *opaque) {
+	CallbackWorker *worker = (CallbackWorker *)opaque;
+	CallbackContext *callback = worker->callback;
+	int kind;
+	void *data;
+	Packet packet;
+	uint64_t timestamp;
+	uint32_t latency;
+
+	while (true) {
+		if (queue_get(&worker->queue, &kind, &data, &packet, &timestamp) < 0) {
+			// FIXME: what to do here? try again? exit?
+			break;
+		}
+
+		if (kind == QUEUE_KIND_EXIT) {
+			break;
+		} else if (kind == QUEUE_KIND_DESTROY_AND_EXIT) {
+			ipcon_destroy_callback_context(callback);
+			break;
+		}
+
+		// FIXME: cannot lock callback mutex here because this can
+		//        deadlock due to an ordering problem with the socket mutex
+		//mutex_lock(&callback->mutex);
+
+		if (kind == QUEUE_KIND_META) {
+			ipcon_dispatch_meta(callback->ipcon_p, (Meta *)data);
+		} else if (kind == QUEUE_KIND_COMPLETION) {
+			ipcon_dispatch_completion((Completion *)data);
+		} else if (kind == QUEUE_KIND_PACKET) {
+			// don't dispatch callbacks when the receive thread isn't running
+			if (callback->packet_dispatch_allowed) {
+				worker->dispatch_timestamp = timestamp;
+
+				ipcon_dispatch_packet(callback->ipcon_p, &packet, timestamp);
+			}
+
+			latency = (uint32_t)(get_monotonic_usec() - timestamp);
+
+			atomic_add_uint64(&worker->dispatch_count, 1);
+			atomic_add_uint64(&worker->latency_sum, latency);
+
+			if (latency > worker->latency_max) {
+				atomic_store_uint32(&worker->latency_max, latency);
+			}
+		}
+
+		//mutex_unlock(&callback->mutex);
+
+		free(data);
+	}
+}
+
+// NOTE: assumes that socket_mutex is locked if disconnect_immediately is true
+static void ipcon_handle_disconnect_by_peer(IPConnectionPrivate *ipcon_p,
+                                            uint8_t disconnect_reason,
+                                            uint64_t socket_id,
+                                            bool disconnect_immediately) {
+	Meta *meta;
+
+	ipcon_p->auto_reconnect_allowed = true;
+
+	if (disconnect_immediately) {
+		ipcon_disconnect_unlocked(ipcon_p);
+	}
+
+	meta = (Meta *)malloc(sizeof(Meta));
+	meta->function_id = IPCON_CALLBACK_DISCONNECTED;
+	meta->parameter = disconnect_reason;
+	meta->socket_id = socket_id;
+
+	queue_put(&ipcon_p->callback->workers[0].queue, QUEUE_KIND_META, meta);
+}
+
+enum {
+	IPCON_DISCONNECT_PROBE_INTERVAL = 5000,
+	IPCON_SEND_BATCH_DEADLINE = 20 // in msec
+};
+
+enum {
+	IPCON_FUNCTION_DISCONNECT_PROBE = 128
+};
+
+static volatile uint32_t io_thread_count = 0;
+static volatile uint64_t io_wakeup_count = 0;
+
+// NOTE: the packet header has to be in wire byte order
+static void ipcon_capture_packet(IPConnectionPrivate *ipcon_p, Packet *packet,
+                                 int direction, uint64_t timestamp) {
+	// only take the mutex while capturing
+	if (atomic_load_pointer((void *volatile *)&ipcon_p->capture) == NULL) {
+		return;
+	}
+
+	mutex_lock(&ipcon_p->capture_mutex);
+
+	if (ipcon_p->capture != NULL) {
+		capture_write(ipcon_p->capture, packet, direction, timestamp);
+	}
+
+	mutex_unlock(&ipcon_p->capture_mutex);
+}
+
+// NOTE: returns -1 if the disconnect probe could not be sent and the
+//       disconnect was reported, 0 otherwise
+static int ipcon_send_disconnect_probe(IPConnectionPrivate *ipcon_p,
+                                       PacketHeader *disconnect_probe) {
+	if (ipcon_p->disconnect_probe_flag) {
+		// FIXME: this might block
+		if (socket_send(ipcon_p->socket, disconnect_probe,
+		                disconnect_probe->length) < 0) {
+			ipcon_handle_disconnect_by_peer(ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
+			                                ipcon_p->socket_id, false);
+
+			return -1;
+		}
+
+		ipcon_capture_packet(ipcon_p, (Packet *)disconnect_probe,
+		                     CAPTURE_DIRECTION_SENT, get_monotonic_usec());
+	} else {
+		ipcon_p->disconnect_probe_flag = true;
+	}
+
+	return 0;
+}
+
+static int ipcon_flush_send_buffer(IPConnectionPrivate *ipcon_p);
+
+// NOTE: called by the disconnect probe thread or the reactor, at least every
+//       IPCON_SEND_BATCH_DEADLINE msec while send batching is enabled. returns
+//       -1 if the socket failed and the disconnect was reported, 0 otherwise
+static int ipcon_disconnect_probe_tick(IPConnectionPrivate *ipcon_p,
+                                       PacketHeader *disconnect_probe) {
+	uint64_t now = get_monotonic_usec();
+	int ret = E_OK;
+
+	// send held back requests, this bounds their delay by the batch deadline
+	mutex_lock(&ipcon_p->send_mutex);
+
+	if (!ipcon_p->send_flushing && ipcon_p->send_buffer_length > 0) {
+		ret = ipcon_flush_send_buffer(ipcon_p);
+	}
+
+	mutex_unlock(&ipcon_p->send_mutex);
+
+	if (ret < 0) {
+		return -1;
+	}
+
+	if (now < ipcon_p->disconnect_probe_time) {
+		return 0;
+	}
+
+	ipcon_p->disconnect_probe_time = now + IPCON_DISCONNECT_PROBE_INTERVAL * 1000ULL;
+
+	ipcon_expire_async_requests(ipcon_p, false);
+
+	return ipcon_send_disconnect_probe(ipcon_p, disconnect_probe);
+}
+
+// NOTE: the disconnect probe loop is not allowed to hold the socket_mutex at any
+//       time because it is created and joined while the socket_mutex is locked
+static void ipcon_disconnect_probe_loop(void *opaque) {
+	IPConnectionPrivate *ipcon_p = (IPConnectionPrivate *)opaque;
+	PacketHeader disconnect_probe;
+	uint64_t now;
+	int timeout;
+
+	atomic_add_uint32(&io_thread_count, 1);
+
+	packet_header_create(&disconnect_probe, sizeof(PacketHeader),
+	                     IPCON_FUNCTION_DISCONNECT_PROBE, ipcon_p, NULL);
+
+	for (;;) {
+		now = get_monotonic_usec();
+		timeout = 0;
+
+		if (ipcon_p->disconnect_probe_time > now) {
+			timeout = (int)((ipcon_p->disconnect_probe_time - now + 999) / 1000);
+		}
+
+		// NOTE: reading send_batching without holding the send_mutex is only a
+		//       hint, enabling send batching wakes this thread up
+		if (ipcon_p->send_batching && timeout > IPCON_SEND_BATCH_DEADLINE) {
+			timeout = IPCON_SEND_BATCH_DEADLINE;
+		}
+
+		if (event_wait(&ipcon_p->disconnect_probe_event, timeout) >= 0) {
+			event_reset(&ipcon_p->disconnect_probe_event);
+
+			if (ipcon_p->disconnect_probe_stop) {
+				break;
+			}
+		}
+
+		atomic_add_uint64(&io_wakeup_count, 1);
+
+		if (ipcon_disconnect_probe_tick(ipcon_p, &disconnect_probe) < 0) {
+			break;
+		}
+	}
+
+	atomic_add_uint32(&io_thread_count, -1);
+}
+
+// NOTE: timestamp is the monotonic time in usec the response was read off the socket
+static void ipcon_handle_response(IPConnectionPrivate *ipcon_p, Packet *response,
+                                  uint64_t timestamp) {
+	DevicePrivate *device_p;
+	PendingRequest *pending_request;
+	ResponseWrapperFunction response_wrapper = NULL;
+	void *response_function = NULL;
+	void *response_user_data = NULL;
+	uint64_t send_timestamp = 0;
+	uint8_t sequence_number = packet_header_get_sequence_number(&response->header);
+
+	ipcon_p->disconnect_probe_flag = false;
+
+	response->header.uid = leconvert_uint32_from(response->header.uid);
+
+	if (sequence_number == 0 &&
+	    response->header.function_id == IPCON_CALLBACK_ENUMERATE) {
+		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE] != NULL) {
+			queue_put_packet(&ipcon_p->callback->workers[0].queue, response,
+			                 timestamp, false);
+		}
+
+		return;
+	}
+
+	device_p = ipcon_acquire_device(ipcon_p, response->header.uid);
+
+	if (device_p == NULL) {
+		// ignoring response for an unknown device
+		return;
+	}
+
+	if (sequence_number == 0) {
+		if (device_p->registered_callbacks[DEVICE_NUM_FUNCTION_IDS + response->header.function_id] != NULL ||
+		    device_p->high_level_callbacks[response->header.function_id].exists) {
+			queue_put_packet(ipcon_get_callback_queue(ipcon_p->callback, response->header.uid),
+			                 response, timestamp, true);
+		}
+
+		device_release(device_p);
+
+		return;
+	}
+
+	pending_request = &ipcon_p->pending_requests[sequence_number];
+
+	mutex_lock(&ipcon_p->pending_request_mutex);
+
+	if (pending_request->in_use && !pending_request->done &&
+	    pending_request->uid == response->header.uid &&
+	    pending_request->function_id == response->header.function_id) {
+		if (pending_request->response_wrapper != NULL) {
+			response_wrapper = pending_request->response_wrapper;
+			response_function = pending_request->response_function;
+			response_user_data = pending_request->response_user_data;
+			send_timestamp = pending_request->send_timestamp;
+
+			pending_request->in_use = false;
+
+			--ipcon_p->pending_async_request_count;
+		} else {
+			memcpy(&pending_request->response, response, response->header.length);
+
+			pending_request->done = true;
+
+#ifdef IPCON_HAVE_FUTEX
+			if (pending_request->low_latency) {
+				completion_set(&pending_request->completion);
+			} else
+#endif
+			{
+				event_set(&pending_request->event);
+			}
+		}
+	}
+
+	// otherwise the response seems to be OK, but can't be handled
+
+	mutex_unlock(&ipcon_p->pending_request_mutex);
+
+	if (send_timestamp != 0) {
+		device_record_latency(device_p, response->header.function_id,
+		                      IPCON_LATENCY_ROUND_TRIP, timestamp - send_timestamp);
+	}
+
+	device_release(device_p);
+
+	if (response_wrapper != NULL) {
+		semaphore_release(&ipcon_p->pending_request_semaphore);
+
+		ipcon_complete_async_request(ipcon_p, response->header.uid, response_wrapper,
+		                             response_function, response_user_data,
+		                             device_get_error_code(response), response);
+	}
+
+	ipcon_expire_async_requests(ipcon_p, false);
+}
+
+// NOTE: the receive function is not allowed to hold the socket_mutex at any
+//       time because it is called from the receive thread and the reactor.
+//       returns -1 if receiving has to stop, 0 otherwise
+static int ipcon_receive(IPConnectionPrivate *ipcon_p, uint64_t socket_id) {
+	uint8_t *buffer = ipcon_p->receive_buffer;
+	Packet *packet;
+	int length;
+	uint8_t disconnect_reason;
+	uint64_t timestamp;
+
+	// packets are parsed in place. only the incomplete packet at the end of
+	// the buffer is moved to the front, and only if there is no room for a
+	// complete packet behind it anymore
+	if (ipcon_p->receive_buffer_start == ipcon_p->receive_buffer_end) {
+		ipcon_p->receive_buffer_start = 0;
+		ipcon_p->receive_buffer_end = 0;
+	} else if (IPCON_RECEIVE_BUFFER_SIZE - ipcon_p->receive_buffer_end < (int)sizeof(Packet)) {
+		memmove(buffer, buffer + ipcon_p->receive_buffer_start,
+		        ipcon_p->receive_buffer_end - ipcon_p->receive_buffer_start);
+
+		ipcon_p->receive_buffer_end -= ipcon_p->receive_buffer_start;
+		ipcon_p->receive_buffer_start = 0;
+	}
+
+	length = socket_receive(ipcon_p->socket, buffer + ipcon_p->receive_buffer_end,
+	                        IPCON_RECEIVE_BUFFER_SIZE - ipcon_p->receive_buffer_end);
+
+	// all packets completed by this read share its receive time
+	timestamp = get_monotonic_usec();
+
+	if (!ipcon_p->receive_flag) {
+		return -1;
+	}
+
+	if (length <= 0) {
+		if (length < 0 && errno == EINTR) {
+			return 0;
+		}
+
+		if (length == 0) {
+			disconnect_reason = IPCON_DISCONNECT_REASON_SHUTDOWN;
+		} else {
+			disconnect_reason = IPCON_DISCONNECT_REASON_ERROR;
+		}
+
+		ipcon_handle_disconnect_by_peer(ipcon_p, disconnect_reason, socket_id, false);
+		return -1;
+	}
+
+	ipcon_p->receive_buffer_end += length;
+
+	while (ipcon_p->receive_flag) {
+		length = ipcon_p->receive_buffer_end - ipcon_p->receive_buffer_start;
+
+		if (length < (int)sizeof(PacketHeader)) {
+			// wait for complete header
+			break;
+		}
+
+		packet = (Packet *)(buffer + ipcon_p->receive_buffer_start);
+
+		if (length < packet->header.length) {
+			// wait for complete packet
+			break;
+		}
+
+		ipcon_p->receive_buffer_start += packet->header.length;
+
+		ipcon_capture_packet(ipcon_p, packet, CAPTURE_DIRECTION_RECEIVED, timestamp);
+
+		ipcon_handle_response(ipcon_p, packet, timestamp);
+	}
+
+	return 0;
+}
+
+// NOTE: the receive loop is now allowed to hold the socket_mutex at any time
+//       because it is created and joined while the socket_mutex is locked
+static void ipcon_receive_loop(void *opaque) {
+	IPConnectionPrivate *ipcon_p = (IPConnectionPrivate *)opaque;
+	uint64_t socket_id = ipcon_p->socket_id;
+
+	atomic_add_uint32(&io_thread_count, 1);
+
+	while (ipcon_p->receive_flag) {
+		atomic_add_uint64(&io_wakeup_count, 1);
+
+		if (ipcon_receive(ipcon_p, socket_id) < 0) {
+			break;
+		}
+	}
+
+	atomic_add_uint32(&io_thread_count, -1);
+}
+
+#ifdef IPCON_HAVE_REACTOR
+
+// the reactor services the sockets and disconnect probes of all IP Connections
+// in reactor mode with a single epoll event loop thread. every registered IP
+// Connection occupies a slot. the epoll data of its socket and timer encodes
+// the slot index and the generation of the slot, so events that were already
+// fetched for a slot that got unregistered in the meantime can be detected
+
+#define REACTOR_STOP_EVENT UINT64_MAX
+
+enum {
+	REACTOR_MAX_EVENTS = 32
+};
+
+typedef struct {
+	IPConnectionPrivate *ipcon_p; // NULL if the slot is unused
+	uint32_t generation;
+	uint64_t socket_id;
+	int timer_handle;
+	bool active; // false after receiving or probing failed
+	bool busy; // true while the reactor handles an event of the slot
+	PacketHeader disconnect_probe;
+} ReactorSlot;
+
+typedef struct {
+	Mutex lifecycle_mutex; // serializes starting and stopping the reactor thread
+	Mutex mutex; // protects the slots, not locked while events are handled
+	pthread_cond_t idle_condition; // signaled when a slot stops being busy
+	int ref_count; // protected by lifecycle_mutex
+	Thread thread; // protected by lifecycle_mutex
+	int epoll_handle;
+	int stop_handle;
+	ReactorSlot *slots; // protected by mutex
+	int slots_allocated; // protected by mutex
+	uint32_t next_generation; // protected by mutex
+} Reactor;
+
+static Reactor shared_reactor = {
+	{ PTHREAD_MUTEX_INITIALIZER },
+	{ PTHREAD_MUTEX_INITIALIZER },
+	PTHREAD_COND_INITIALIZER
+};
+
+static uint64_t reactor_event_data(int index, uint32_t generation, bool timer) {
+	return ((uint64_t)generation << 32) | ((uint64_t)index << 1) | (timer ? 1 : 0);
+}
+
+// NOTE: assumes that mutex is locked
+static ReactorSlot *reactor_get_slot(uint64_t data) {
+	int index = (int)((data & 0xFFFFFFFF) >> 1);
+	ReactorSlot *slot;
+
+	if (index >= shared_reactor.slots_allocated) {
+		return NULL;
+	}
+
+	slot = &shared_reactor.slots[index];
+
+	if (slot->ipcon_p == NULL || slot->generation != (uint32_t)(data >> 32)) {
+		return NULL;
+	}
+
+	return slot;
+}
+
+// NOTE: assumes that mutex is locked
+static void reactor_deactivate_slot(ReactorSlot *slot) {
+	if (!slot->active) {
+		return;
+	}
+
+	slot->active = false;
+
+	epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_DEL, slot->ipcon_p->socket->handle, NULL);
+	epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_DEL, slot->timer_handle, NULL);
+}
+
+// NOTE: epoll_wait only fails if the epoll instance itself is broken. it gets
+//       replaced and all IP Connections registered with the old one report a
+//       disconnect, their auto-reconnect registers them again. returns false
+//       if the reactor was asked to stop meanwhile
+static bool reactor_recover(void) {
+	struct epoll_event event;
+	ReactorSlot *slot;
+	uint64_t stop;
+	int epoll_handle;
+	int i;
+
+	while (true) {
+		if (read(shared_reactor.stop_handle, &stop, sizeof(stop)) == sizeof(stop)) {
+			return false;
+		}
+
+		epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+
+		if (epoll_handle >= 0) {
+			memset(&event, 0, sizeof(event));
+
+			event.events = EPOLLIN;
+			event.data.u64 = REACTOR_STOP_EVENT;
+
+			if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, shared_reactor.stop_handle, &event) == 0) {
+				break;
+			}
+
+			close(epoll_handle);
+		}
+
+		millisleep(100);
+	}
+
+	mutex_lock(&shared_reactor.mutex);
+
+	for (i = 0; i < shared_reactor.slots_allocated; ++i) {
+		slot = &shared_reactor.slots[i];
+
+		if (slot->ipcon_p != NULL && slot->active) {
+			reactor_deactivate_slot(slot);
+			ipcon_handle_disconnect_by_peer(slot->ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
+			                                slot->socket_id, false);
+		}
+	}
+
+	close(shared_reactor.epoll_handle);
+	shared_reactor.epoll_handle = epoll_handle;
+
+	mutex_unlock(&shared_reactor.mutex);
+
+	return true;
+}
+
+// NOTE: the mutex is only locked to look up the slot of an event and to mark
+//       it busy. it is not held while the event is handled, because handling
+//       it can call into the IP Connection, which must be free to take its own
+//       mutexes without an ordering problem with reactor_unregister
+static void reactor_loop(void *opaque) {
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+	bool running = true;
+	ReactorSlot *slot;
+	IPConnectionPrivate *ipcon_p;
+	uint64_t socket_id;
+	int timer_handle;
+	PacketHeader disconnect_probe;
+	int index;
+	uint64_t expirations;
+	bool failed;
+	int count;
+	int i;
+
+	(void)opaque;
+
+	atomic_add_uint32(&io_thread_count, 1);
+
+	while (running) {
+		count = epoll_wait(shared_reactor.epoll_handle, events, REACTOR_MAX_EVENTS, -1);
+
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			running = reactor_recover();
+
+			continue;
+		}
+
+		atomic_add_uint64(&io_wakeup_count, 1);
+
+		for (i = 0; i < count; ++i) {
+			if (events[i].data.u64 == REACTOR_STOP_EVENT) {
+				running = false;
+				continue;
+			}
+
+			mutex_lock(&shared_reactor.mutex);
+
+			slot = reactor_get_slot(events[i].data.u64);
+
+			if (slot == NULL || !slot->active) {
+				mutex_unlock(&shared_reactor.mutex);
+				continue;
+			}
+
+			// the slot cannot be unregistered while it is busy, but the slot
+			// array can be reallocated, only remember the index
+			slot->busy = true;
+			ipcon_p = slot->ipcon_p;
+			socket_id = slot->socket_id;
+			timer_handle = slot->timer_handle;
+			disconnect_probe = slot->disconnect_probe;
+			index = (int)(slot - shared_reactor.slots);
+
+			mutex_unlock(&shared_reactor.mutex);
+
+			failed = false;
+
+			if ((events[i].data.u64 & 1) != 0) {
+				// the timer is non-blocking, ignore spurious wakeups
+				if (read(timer_handle, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+					failed = ipcon_disconnect_probe_tick(ipcon_p, &disconnect_probe) < 0;
+				}
+			} else {
+				failed = ipcon_receive(ipcon_p, socket_id) < 0;
+			}
+
+			mutex_lock(&shared_reactor.mutex);
+
+			slot = &shared_reactor.slots[index];
+			slot->busy = false;
+
+			if (failed) {
+				reactor_deactivate_slot(slot);
+			}
+
+			pthread_cond_broadcast(&shared_reactor.idle_condition);
+			mutex_unlock(&shared_reactor.mutex);
+		}
+	}
+
+	atomic_add_uint32(&io_thread_count, -1);
+}
+
+static int reactor_acquire(void) {
+	struct epoll_event event;
+	int ret = E_OK;
+
+	mutex_lock(&shared_reactor.lifecycle_mutex);
+
+	if (shared_reactor.ref_count == 0) {
+		shared_reactor.epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+
+		if (shared_reactor.epoll_handle < 0) {
+			mutex_unlock(&shared_reactor.lifecycle_mutex);
+
+			return E_NO_THREAD;
+		}
+
+		shared_reactor.stop_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		memset(&event, 0, sizeof(event));
+
+		event.events = EPOLLIN;
+		event.data.u64 = REACTOR_STOP_EVENT;
+
+		if (shared_reactor.stop_handle < 0 ||
+		    epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_ADD,
+		              shared_reactor.stop_handle, &event) < 0 ||
+		    thread_create(&shared_reactor.thread, reactor_loop, NULL) < 0) {
+			if (shared_reactor.stop_handle >= 0) {
+				close(shared_reactor.stop_handle);
+			}
+
+			close(shared_reactor.epoll_handle);
+
+			ret = E_NO_THREAD;
+		}
+	}
+
+	if (ret == E_OK) {
+		++shared_reactor.ref_count;
+	}
+
+	mutex_unlock(&shared_reactor.lifecycle_mutex);
+
+	return ret;
+}
+
+// NOTE: must not be called from the reactor thread
+static void reactor_release(void) {
+	uint64_t stop = 1;
+
+	mutex_lock(&shared_reactor.lifecycle_mutex);
+
+	--shared_reactor.ref_count;
+
+	if (shared_reactor.ref_count == 0) {
+		if (write(shared_reactor.stop_handle, &stop, sizeof(stop)) == sizeof(stop)) {
+			thread_join(&shared_reactor.thread);
+		}
+
+		thread_destroy(&shared_reactor.thread);
+
+		close(shared_reactor.stop_handle);
+		close(shared_reactor.epoll_handle);
+
+		free(shared_reactor.slots);
+		shared_reactor.slots = NULL;
+		shared_reactor.slots_allocated = 0;
+	}
+
+	mutex_unlock(&shared_reactor.lifecycle_mutex);
+}
+
+// NOTE: the timer ticks every disconnect probe interval, or every batch
+//       deadline while send batching is enabled
+static void reactor_arm_timer(int timer_handle, bool send_batching) {
+	struct itimerspec interval;
+	int period = send_batching ? IPCON_SEND_BATCH_DEADLINE : IPCON_DISCONNECT_PROBE_INTERVAL;
+
+	memset(&interval, 0, sizeof(interval));
+
+	interval.it_interval.tv_sec = period / 1000;
+	interval.it_interval.tv_nsec = (period % 1000) * 1000000L;
+	interval.it_value = interval.it_interval;
+
+	timerfd_settime(timer_handle, 0, &interval, NULL);
+}
+
+// NOTE: assumes that socket is not NULL and socket_mutex is locked
+static int reactor_register(IPConnectionPrivate *ipcon_p) {
+	struct epoll_event event;
+	ReactorSlot *slot;
+	int timer_handle;
+	int index;
+
+	if (reactor_acquire() < 0) {
+		return E_NO_THREAD;
+	}
+
+	timer_handle = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+	if (timer_handle < 0) {
+		reactor_release();
+
+		return E_NO_THREAD;
+	}
+
+	reactor_arm_timer(timer_handle, ipcon_p->send_batching);
+
+	mutex_lock(&shared_reactor.mutex);
+
+	for (index = 0; index < shared_reactor.slots_allocated; ++index) {
+		if (shared_reactor.slots[index].ipcon_p == NULL) {
+			break;
+		}
+	}
+
+	if (index == shared_reactor.slots_allocated) {
+		shared_reactor.slots_allocated += 4;
+		shared_reactor.slots = (ReactorSlot *)realloc(shared_reactor.slots,
+		                                              sizeof(ReactorSlot) * shared_reactor.slots_allocated);
+
+		memset(&shared_reactor.slots[index], 0, sizeof(ReactorSlot) * 4);
+	}
+
+	slot = &shared_reactor.slots[index];
+
+	slot->ipcon_p = ipcon_p;
+	slot->generation = ++shared_reactor.next_generation;
+	slot->socket_id = ipcon_p->socket_id;
+	slot->timer_handle = timer_handle;
+	slot->active = true;
+	slot->busy = false;
+
+	packet_header_create(&slot->disconnect_probe, sizeof(PacketHeader),
+	                     IPCON_FUNCTION_DISCONNECT_PROBE, ipcon_p, NULL);
+
+	memset(&event, 0, sizeof(event));
+
+	event.events = EPOLLIN;
+	event.data.u64 = reactor_event_data(index, slot->generation, false);
+
+	if (epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_ADD, ipcon_p->socket->handle, &event) < 0) {
+		slot->ipcon_p = NULL;
+
+		mutex_unlock(&shared_reactor.mutex);
+
+		close(timer_handle);
+		reactor_release();
+
+		return E_NO_THREAD;
+	}
+
+	event.data.u64 = reactor_event_data(index, slot->generation, true);
+
+	if (epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_ADD, timer_handle, &event) < 0) {
+		epoll_ctl(shared_reactor.epoll_handle, EPOLL_CTL_DEL, ipcon_p->socket->handle, NULL);
+
+		slot->ipcon_p = NULL;
+
+		mutex_unlock(&shared_reactor.mutex);
+
+		close(timer_handle);
+		reactor_release();
+
+		return E_NO_THREAD;
+	}
+
+	ipcon_p->reactor_slot = index;
+
+	mutex_unlock(&shared_reactor.mutex);
+
+	return E_OK;
+}
+
+// NOTE: assumes that socket is not NULL and socket_mutex is locked, must not be
+//       called from the reactor thread. after this returned the reactor
+//       doesn't access the IP Connection anymore
+static void reactor_unregister(IPConnectionPrivate *ipcon_p) {
+	ReactorSlot *slot;
+
+	mutex_lock(&shared_reactor.mutex);
+
+	reactor_deactivate_slot(&shared_reactor.slots[ipcon_p->reactor_slot]);
+
+	// wait for the reactor to finish an event it is handling for the slot
+	while (shared_reactor.slots[ipcon_p->reactor_slot].busy) {
+		pthread_cond_wait(&shared_reactor.idle_condition, &shared_reactor.mutex.handle);
+	}
+
+	slot = &shared_reactor.slots[ipcon_p->reactor_slot];
+
+	close(slot->timer_handle);
+
+	slot->ipcon_p = NULL;
+	ipcon_p->reactor_slot = -1;
+
+	mutex_unlock(&shared_reactor.mutex);
+
+	reactor_release();
+}
+
+#endif // IPCON_HAVE_REACTOR
+
+// NOTE: assumes that socket is NULL and socket_mutex is locked
+static int ipcon_connect_unlocked(IPConnectionPrivate *ipcon_p, bool is_auto_reconnect) {
+	char service[32];
+	struct addrinfo hints;
+	struct addrinfo *resolved = NULL;
+	Socket *tmp;
+	uint8_t connect_reason;
+	Meta *meta;
+#ifdef IPCON_HAVE_REACTOR
+	int ret;
+#endif
+
+	// create callback queue and thread
+	if (ipcon_p->callback == NULL) {
+		ipcon_p->callback = ipcon_create_callback_context(ipcon_p);
+
+		if (ipcon_p->callback == NULL) {
+			return E_NO_THREAD;
+		}
+	}
+
+	// create and connect socket
+	snprintf(service, sizeof(service), "%u", ipcon_p->port);
+
+	memset(&hints, 0, sizeof(hints));
+
+	hints.ai_flags = AI_PASSIVE;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(ipcon_p->host, service, &hints, &resolved) != 0) {
+		// destroy callback thread
+		if (!is_auto_reconnect) {
+			ipcon_exit_callback_thread(ipcon_p->callback);
+			ipcon_p->callback = NULL;
+		}
+
+		return E_HOSTNAME_INVALID;
+	}
+
+	tmp = (Socket *)malloc(sizeof(Socket));
+
+	if (socket_create(tmp, resolved->ai_family, resolved->ai_socktype,
+	                  resolved->ai_protocol) < 0) {
+		// destroy callback thread
+		if (!is_auto_reconnect) {
+			ipcon_exit_callback_thread(ipcon_p->callback);
+			ipcon_p->callback = NULL;
+		}
+
+		// destroy socket
+		free(tmp);
+		freeaddrinfo(resolved);
+
+		return E_NO_STREAM_SOCKET;
+	}
+
+	if (socket_connect(tmp, resolved->ai_addr, resolved->ai_addrlen) < 0) {
+		// destroy callback thread
+		if (!is_auto_reconnect) {
+			ipcon_exit_callback_thread(ipcon_p->callback);
+			ipcon_p->callback = NULL;
+		}
+
+		// destroy socket
+		socket_destroy(tmp);
+		free(tmp);
+		freeaddrinfo(resolved);
+
+		return E_NO_CONNECT;
+	}
+
+	freeaddrinfo(resolved);
+
+	ipcon_p->socket = tmp;
+	++ipcon_p->socket_id;
+
+	ipcon_p->receive_buffer_start = 0;
+	ipcon_p->receive_buffer_end = 0;
+
+	// requests held back for the previous socket are stale now. while another
+	// thread is flushing they belong to its next round, the callers that wait
+	// for it get the result of sending them to the new socket
+	mutex_lock(&ipcon_p->send_mutex);
+
+	if (!ipcon_p->send_flushing) {
+		ipcon_p->send_buffer_length = 0;
+	}
+
+	mutex_unlock(&ipcon_p->send_mutex);
+
+	ipcon_p->disconnect_probe_time = get_monotonic_usec() + IPCON_DISCONNECT_PROBE_INTERVAL * 1000ULL;
+
+#ifdef IPCON_HAVE_REACTOR
+	if (ipcon_p->reactor) {
+		// register socket and disconnect probe with the reactor
+		ipcon_p->disconnect_probe_flag = true;
+		ipcon_p->receive_flag = true;
+		ipcon_p->callback->packet_dispatch_allowed = true;
+
+		ret = reactor_register(ipcon_p);
+
+		if (ret < 0) {
+			ipcon_p->receive_flag = false;
+			ipcon_p->callback->packet_dispatch_allowed = false;
+
+			// destroy callback thread
+			if (!is_auto_reconnect) {
+				ipcon_exit_callback_thread(ipcon_p->callback);
+				ipcon_p->callback = NULL;
+			}
+
+			// destroy socket
+			socket_destroy(ipcon_p->socket);
+			free(ipcon_p->socket);
+			ipcon_p->socket = NULL;
+
+			return ret;
+		}
+
+		goto connected;
+	}
+#endif
+
+	// create disconnect probe thread
+	ipcon_p->disconnect_probe_flag = true;
+	ipcon_p->disconnect_probe_stop = false;
+
+	event_reset(&ipcon_p->disconnect_probe_event);
+
+	if (thread_create(&ipcon_p->disconnect_probe_thread,
+	                  ipcon_disconnect_probe_loop, ipcon_p) < 0) {
+		// destroy callback thread
+		if (!is_auto_reconnect) {
+			ipcon_exit_callback_thread(ipcon_p->callback);
+			ipcon_p->callback = NULL;
+		}
+
+		// destroy socket
+		socket_destroy(ipcon_p->socket);
+		free(ipcon_p->socket);
+		ipcon_p->socket = NULL;
+
+		return E_NO_THREAD;
+	}
+
+	// create receive thread
+	ipcon_p->receive_flag = true;
+	ipcon_p->callback->packet_dispatch_allowed = true;
+
+	if (thread_create(&ipcon_p->receive_thread, ipcon_receive_loop, ipcon_p) < 0) {
+		ipcon_p->receive_flag = false;
+
+		// destroy socket
+		ipcon_disconnect_unlocked(ipcon_p);
+
+		// destroy callback thread
+		if (!is_auto_reconnect) {
+			ipcon_exit_callback_thread(ipcon_p->callback);
+			ipcon_p->callback = NULL;
+		}
+
+		return E_NO_THREAD;
+	}
+
+#ifdef IPCON_HAVE_REACTOR
+connected:
+#endif
+	ipcon_p->auto_reconnect_allowed = false;
+	ipcon_p->auto_reconnect_pending = false;
+
+	// trigger connected callback
+	if (is_auto_reconnect) {
+		connect_reason = IPCON_CONNECT_REASON_AUTO_RECONNECT;
+	} else {
+		connect_reason = IPCON_CONNECT_REASON_REQUEST;
+	}
+
+	meta = (Meta *)malloc(sizeof(Meta));
+	meta->function_id = IPCON_CALLBACK_CONNECTED;
+	meta->parameter = connect_reason;
+	meta->socket_id = 0;
+
+	queue_put(&ipcon_p->callback->workers[0].queue, QUEUE_KIND_META, meta);
+
+	return E_OK;
+}
+
+// NOTE: assumes that socket is not NULL and socket_mutex is locked
+static void ipcon_disconnect_unlocked(IPConnectionPrivate *ipcon_p) {
+#ifdef IPCON_HAVE_REACTOR
+	if (ipcon_p->reactor_slot >= 0) {
+		ipcon_p->callback->packet_dispatch_allowed = false;
+		ipcon_p->receive_flag = false;
+
+		// unregister socket and disconnect probe from the reactor
+		reactor_unregister(ipcon_p);
+
+		// destroy socket
+		socket_destroy(ipcon_p->socket);
+		free(ipcon_p->socket);
+		ipcon_p->socket = NULL;
+
+		// the responses of requests still in flight cannot arrive anymore
+		ipcon_expire_async_requests(ipcon_p, true);
+
+		return;
+	}
+#endif
+
+	// destroy disconnect probe thread
+	ipcon_p->disconnect_probe_stop = true;
+
+	event_set(&ipcon_p->disconnect_probe_event);
+	thread_join(&ipcon_p->disconnect_probe_thread);
+	thread_destroy(&ipcon_p->disconnect_probe_thread);
+
+	// stop dispatching packet callbacks before ending the receive
+	// thread to avoid timeout exceptions due to callback functions
+	// trying to call getters
+	if (!ipcon_is_callback_thread(ipcon_p->callback)) {
+		// FIXME: cannot lock callback mutex here because this can
+		//        deadlock due to an ordering problem with the socket mutex
+		//mutex_lock(&ipcon->callback->mutex);
+
+		ipcon_p->callback->packet_dispatch_allowed = false;
+
+		//mutex_unlock(&ipcon->callback->mutex);
+	} else {
+		ipcon_p->callback->packet_dispatch_allowed = false;
+	}
+
+	// destroy receive thread
+	if (ipcon_p->receive_flag) {
+		ipcon_p->receive_flag = false;
+
+		socket_shutdown(ipcon_p->socket);
+
+		thread_join(&ipcon_p->receive_thread);
+		thread_destroy(&ipcon_p->receive_thread);
+	}
+
+	// destroy socket
+	socket_destroy(ipcon_p->socket);
+	free(ipcon_p->socket);
+	ipcon_p->socket = NULL;
+
+	// the responses of requests still in flight cannot arrive anymore
+	ipcon_expire_async_requests(ipcon_p, true);
+}
+
+// NOTE: assumes that socket is not NULL and socket_mutex is locked, so the
+//       threads servicing the socket cannot change meanwhile
+static bool ipcon_is_io_thread(IPConnectionPrivate *ipcon_p) {
+#ifdef IPCON_HAVE_REACTOR
+	if (ipcon_p->reactor_slot >= 0) {
+		return thread_is_current(&shared_reactor.thread);
+	}
+#endif
+
+	return thread_is_current(&ipcon_p->receive_thread) ||
+	       thread_is_current(&ipcon_p->disconnect_probe_thread);
+}
+
+// NOTE: assumes that send_mutex is locked, it gets unlocked while sending. only
+//       one thread flushes at a time, other threads append their requests to
+//       the send buffer meanwhile and they get sent in the next round. returns
+//       the result of the first round, which includes the caller's request.
+//       an I/O thread doesn't lock the socket_mutex, because it is stopped
+//       while the socket_mutex is locked and before the socket is destroyed
+static int ipcon_flush_send_buffer(IPConnectionPrivate *ipcon_p) {
+	uint8_t buffer[IPCON_SEND_BUFFER_SIZE];
+	int length;
+	int ret = E_OK;
+	bool first = true;
+	bool failed;
+	bool io_thread = ipcon_is_io_thread(ipcon_p);
+
+	ipcon_p->send_flushing = true;
+
+	event_reset(&ipcon_p->send_flushed_event);
+
+	while (ipcon_p->send_buffer_length > 0) {
+		length = ipcon_p->send_buffer_length;
+
+		memcpy(buffer, ipcon_p->send_buffer, length);
+
+		ipcon_p->send_buffer_length = 0;
+		++ipcon_p->send_round;
+
+		mutex_unlock(&ipcon_p->send_mutex);
+
+		if (!io_thread) {
+			mutex_lock(&ipcon_p->socket_mutex);
+		}
+
+		if (ipcon_p->socket == NULL) {
+			failed = true;
+		} else if (socket_send(ipcon_p->socket, buffer, length) < 0) {
+			// an I/O thread cannot stop itself, the disconnected callback
+			// cleans up for it
+			if (io_thread) {
+				ipcon_handle_disconnect_by_peer(ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
+				                                ipcon_p->socket_id, false);
+			} else {
+				ipcon_handle_disconnect_by_peer(ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
+				                                0, true);
+			}
+
+			failed = true;
+		} else {
+			ipcon_p->disconnect_probe_flag = false;
+			failed = false;
+
+			atomic_add_uint64(&ipcon_p->send_call_count, 1);
+		}
+
+		if (!io_thread) {
+			mutex_unlock(&ipcon_p->socket_mutex);
+		}
+
+		mutex_lock(&ipcon_p->send_mutex);
+
+		ipcon_p->send_round_failures = (ipcon_p->send_round_failures << 1) | (failed ? 1 : 0);
+
+		if (first && failed) {
+			ret = E_NOT_CONNECTED;
+		}
+
+		first = false;
+	}
+
+	ipcon_p->send_flushing = false;
+
+	event_set(&ipcon_p->send_flushed_event);
+
+	return ret;
+}
+
+// NOTE: assumes that send_mutex is locked and another thread is flushing, it
+//       gets unlocked while waiting. waits until the given round is sent and
+//       returns its result. only the last 64 rounds are remembered, an older
+//       round is reported as sent
+static int ipcon_wait_send_round(IPConnectionPrivate *ipcon_p, uint32_t round) {
+	uint32_t age;
+
+	// the flushing thread takes rounds until the send buffer is empty, so the
+	// round is done once no thread is flushing or a later round is in progress
+	while (ipcon_p->send_flushing && (int32_t)(ipcon_p->send_round - round) <= 0) {
+		mutex_unlock(&ipcon_p->send_mutex);
+		event_wait(&ipcon_p->send_flushed_event, ipcon_p->timeout);
+		mutex_lock(&ipcon_p->send_mutex);
+	}
+
+	age = ipcon_p->send_round - (ipcon_p->send_flushing ? 1 : 0) - round;
+
+	if (age < 64 && ((ipcon_p->send_round_failures >> age) & 1) != 0) {
+		return E_NOT_CONNECTED;
+	}
+
+	return E_OK;
+}
+
+// NOTE: answers the request from the capture that is being replayed, in the
+//       calling thread
+static int ipcon_replay_request(IPConnectionPrivate *ipcon_p, Packet *request) {
+	ReplayResponse *replay_response;
+	Packet *canned = NULL;
+	Packet response;
+
+	mutex_lock(&ipcon_p->socket_mutex);
+
+	if (ipcon_p->replay == NULL) {
+		mutex_unlock(&ipcon_p->socket_mutex);
+
+		return E_NOT_CONNECTED;
+	}
+
+	if (!packet_header_get_response_expected(&request->header)) {
+		mutex_unlock(&ipcon_p->socket_mutex);
+
+		return E_OK;
+	}
+
+	replay_response = replay_find_response(ipcon_p->replay, request);
+
+	if (replay_response != NULL) {
+		canned = (Packet *)atomic_load_pointer((void *volatile *)&replay_response->response);
+
+		memcpy(&response, canned, canned->header.length);
+	} else {
+		memcpy(&response, request, sizeof(PacketHeader));
+
+		response.header.length = sizeof(PacketHeader);
+		response.header.error_code_and_future_use = 2 << 6; // function not supported
+	}
+
+	mutex_unlock(&ipcon_p->socket_mutex);
+
+	// the response goes to the pending request of this call
+	response.header.uid = request->header.uid;
+	response.header.sequence_number_and_options = request->header.sequence_number_and_options;
+
+	ipcon_handle_response(ipcon_p, &response, get_monotonic_usec());
+
+	return E_OK;
+}
+
+static int ipcon_send_request(IPConnectionPrivate *ipcon_p, Packet *request) {
+	int ret = E_OK;
+
+	// NOTE: reading the replay and the socket without holding the socket_mutex
+	//       is only a hint here, both are checked again under the mutex
+	if (ipcon_p->replay != NULL) {
+		return ipcon_replay_request(ipcon_p, request);
+	}
+
+	if (ipcon_p->socket == NULL) {
+		return E_NOT_CONNECTED;
+	}
+
+	mutex_lock(&ipcon_p->send_mutex);
+
+	// make room in the send buffer, if another thread is flushing already
+	// then wait for it to send the current content
+	while (ipcon_p->send_buffer_length + request->header.length > IPCON_SEND_BUFFER_SIZE) {
+		if (!ipcon_p->send_flushing) {
+			ipcon_flush_send_buffer(ipcon_p);
+		} else {
+			mutex_unlock(&ipcon_p->send_mutex);
+			event_wait(&ipcon_p->send_flushed_event, ipcon_p->timeout);
+			mutex_lock(&ipcon_p->send_mutex);
+		}
+	}
+
+	memcpy(ipcon_p->send_buffer + ipcon_p->send_buffer_length, request, request->header.length);
+
+	ipcon_p->send_buffer_length += request->header.length;
+
+	ipcon_capture_packet(ipcon_p, request, CAPTURE_DIRECTION_SENT, get_monotonic_usec());
+
+	atomic_add_uint64(&ipcon_p->send_packet_count, 1);
+
+	// a request that expects a response is never held back, because the
+	// caller is going to wait for the response. the result of a held back
+	// request is not known yet, it is sent by a later flush
+	if (ipcon_p->send_batching && !packet_header_get_response_expected(&request->header)) {
+		ret = E_OK;
+	} else if (!ipcon_p->send_flushing) {
+		ret = ipcon_flush_send_buffer(ipcon_p);
+	} else {
+		// the flushing thread takes the request with its next round
+		ret = ipcon_wait_send_round(ipcon_p, ipcon_p->send_round + 1);
+	}
+
+	mutex_unlock(&ipcon_p->send_mutex);
+
+	return ret;
+}
+
+void ipcon_create(IPConnection *ipcon) {
+	IPConnectionPrivate *ipcon_p;
+	int i;
+
+	ipcon_p = (IPConnectionPrivate *)malloc(sizeof(IPConnectionPrivate));
+	ipcon->p = ipcon_p;
+
+#ifdef _WIN32
+	ipcon_p->wsa_startup_done = false;
+#endif
+
+	ipcon_p->host = NULL;
+	ipcon_p->port = 0;
+
+	ipcon_p->timeout = 2500;
+
+	ipcon_p->auto_reconnect = true;
+	ipcon_p->auto_reconnect_allowed = false;
+	ipcon_p->auto_reconnect_pending = false;
+
+	mutex_create(&ipcon_p->sequence_number_mutex);
+	ipcon_p->next_sequence_number = 0;
+
+	mutex_create(&ipcon_p->pending_request_mutex);
+	semaphore_create(&ipcon_p->pending_request_semaphore);
+
+	ipcon_p->pending_async_request_count = 0;
+	ipcon_p->next_request_serial = 0;
+
+	for (i = 0; i < IPCON_NUM_SEQUENCE_NUMBERS; ++i) {
+		ipcon_p->pending_requests[i].in_use = false;
+		ipcon_p->pending_requests[i].done = false;
+		ipcon_p->pending_requests[i].response_wrapper = NULL;
+		ipcon_p->pending_requests[i].completion = 0;
+		ipcon_p->pending_requests[i].low_latency = false;
+
+		event_create(&ipcon_p->pending_requests[i].event);
+
+		// sequence number 0 is reserved for callbacks
+		if (i > 0) {
+			semaphore_release(&ipcon_p->pending_request_semaphore);
+		}
+	}
+
+	mutex_create(&ipcon_p->authentication_mutex);
+	ipcon_p->next_authentication_nonce = 0;
+
+	table_create(&ipcon_p->devices);
+
+	ipcon_p->latency_tracking = false;
+	mutex_create(&ipcon_p->latency_mutex);
+
+	for (i = 0; i < IPCON_NUM_CALLBACK_IDS; ++i) {
+		ipcon_p->registered_callbacks[i] = NULL;
+		ipcon_p->registered_callback_user_data[i] = NULL;
+	}
+
+	mutex_create(&ipcon_p->socket_mutex);
+	ipcon_p->socket = NULL;
+	ipcon_p->socket_id = 0;
+
+	mutex_create(&ipcon_p->send_mutex);
+	ipcon_p->send_buffer_length = 0;
+	ipcon_p->send_flushing = false;
+	event_create(&ipcon_p->send_flushed_event);
+	event_set(&ipcon_p->send_flushed_event);
+	ipcon_p->send_round = 0;
+	ipcon_p->send_round_failures = 0;
+	ipcon_p->send_batching = false;
+
+	ipcon_p->low_latency = false;
+	ipcon_p->completion_wait_average = 0;
+	ipcon_p->completion_spin = 0;
+	ipcon_p->completion_spin_max = 0;
+	ipcon_p->send_packet_count = 0;
+	ipcon_p->send_call_count = 0;
+
+	ipcon_p->receive_flag = false;
+	ipcon_p->receive_buffer_start = 0;
+	ipcon_p->receive_buffer_end = 0;
+
+	ipcon_p->reactor = false;
+	ipcon_p->reactor_slot = -1;
+
+	ipcon_p->callback = NULL;
+	ipcon_p->callback_worker_count = 1;
+	ipcon_p->callback_queue_capacity = 0;
+	ipcon_p->callback_queue_policy = IPCON_QUEUE_POLICY_BLOCK;
+
+	mutex_create(&ipcon_p->capture_mutex);
+	ipcon_p->capture = NULL;
+	ipcon_p->replay = NULL;
+
+	ipcon_p->disconnect_probe_flag = false;
+	ipcon_p->disconnect_probe_stop = false;
+	ipcon_p->disconnect_probe_time = 0;
+	event_create(&ipcon_p->disconnect_probe_event);
+
+	semaphore_create(&ipcon_p->wait);
+
+	brickd_create(&ipcon_p->brickd, "2", ipcon);
+}
+
+void ipcon_destroy(IPConnection *ipcon) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	int i;
+
+	ipcon_disconnect(ipcon); // FIXME: disable disconnected callback before?
+
+	brickd_destroy(&ipcon_p->brickd);
+
+	mutex_destroy(&ipcon_p->authentication_mutex);
+
+	mutex_destroy(&ipcon_p->sequence_number_mutex);
+
+	// the receive thread is gone, nobody else can complete them anymore
+	ipcon_expire_async_requests(ipcon_p, true);
+
+	for (i = 0; i < IPCON_NUM_SEQUENCE_NUMBERS; ++i) {
+		event_destroy(&ipcon_p->pending_requests[i].event);
+	}
+
+	semaphore_destroy(&ipcon_p->pending_request_semaphore);
+	mutex_destroy(&ipcon_p->pending_request_mutex);
+
+	table_destroy(&ipcon_p->devices); // FIXME: destroy all devices?
+
+	mutex_destroy(&ipcon_p->latency_mutex);
+
+	event_destroy(&ipcon_p->send_flushed_event);
+	mutex_destroy(&ipcon_p->send_mutex);
+
+	mutex_destroy(&ipcon_p->socket_mutex);
+
+	ipcon_stop_capture(ipcon);
+	mutex_destroy(&ipcon_p->capture_mutex);
+
+	event_destroy(&ipcon_p->disconnect_probe_event);
+
+	semaphore_destroy(&ipcon_p->wait);
+
+	free(ipcon_p->host);
+
+	free(ipcon_p);
+}
+
+int ipcon_connect(IPConnection *ipcon, const char *host, uint16_t port) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	int ret;
+#ifdef _WIN32
+	WSADATA wsa_data;
+#endif
+
+	mutex_lock(&ipcon_p->socket_mutex);
+
+#ifdef _WIN32
+	if (!ipcon_p->wsa_startup_done) {
+		if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+			mutex_unlock(&ipcon_p->socket_mutex);
+
+			return E_NO_STREAM_SOCKET;
+		}
+
+		ipcon_p->wsa_startup_done = true;
+	}
+#endif
+
+	if (ipcon_p->socket != NULL || ipcon_p->replay != NULL) {
+		mutex_unlock(&ipcon_p->socket_mutex);
+
+		return E_ALREADY_CONNECTED;
+	}
+
+	free(ipcon_p->host);
+
+	ipcon_p->host = strdup(host);
+	ipcon_p->port = port;
+
+	ret = ipcon_connect_unlocked(ipcon_p, false);
+
+	mutex_unlock(&ipcon_p->socket_mutex);
+
+	return ret;
+}
+
+int ipcon_disconnect(IPConnection *ipcon) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	CallbackContext *callback;
+	Meta *meta;
+
+	mutex_lock(&ipcon_p->socket_mutex);
+
+	ipcon_p->auto_reconnect_allowed = false;
+
+	if (ipcon_p->replay != NULL) {
+		// ipcon_replay tears the replay down itself
+		ipcon_p->replay->stop = true;
+
+		mutex_unlock(&ipcon_p->socket_mutex);
+
+		return E_OK;
+	}
+
+	if (ipcon_p->auto_reconnect_pending) {
+		// abort pending auto-reconnect
+		ipcon_p->auto_reconnect_pending = false;
+	} else {
+		if (ipcon_p->socket == NULL) {
+			// the callback threads outlive a connection closed by the peer
+			// and a finished replay, the disconnect was reported already
+			callback = ipcon_p->callback;
+			ipcon_p->callback = NULL;
+
+			mutex_unlock(&ipcon_p->socket_mutex);
+
+			if (callback != NULL) {
+				ipcon_exit_callback_thread(callback);
+			}
+
+			return E_NOT_CONNECTED;
+		}
+
+		ipcon_disconnect_unlocked(ipcon_p);
+	}
+
+	// destroy callback thread
+	callback = ipcon_p->callback;
+	ipcon_p->callback = NULL;
+
+	mutex_unlock(&ipcon_p->socket_mutex);
+
+	// do this outside of socket_mutex to allow calling (dis-)connect from
+	// the callbacks while blocking on the join call here
+	meta = (Meta *)malloc(sizeof(Meta));
+	meta->function_id = IPCON_CALLBACK_DISCONNECTED;
+	meta->parameter = IPCON_DISCONNECT_REASON_REQUEST;
+	meta->socket_id = 0;
+
+	queue_put(&callback->workers[0].queue, QUEUE_KIND_META, meta);
 
-	ipcon_p->disconnect_probe_flag = false;
+	ipcon_exit_callback_thread(callback);
 
-	response->header.uid = leconvert_uint32_from(response->header.uid);
+	return E_OK;
+}
 
-	if (sequence_number == 0 &&
-	    response->header.function_id == IPCON_CALLBACK_ENUMERATE) {
-		if (ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE] != NULL) {
-			callback = (Packet *)malloc(response->header.length);
+int ipcon_authenticate(IPConnection *ipcon, const char secret[64]) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	int ret;
+	uint32_t nonces[2]; // server, client
+	uint8_t digest[SHA1_DIGEST_LENGTH];
 
-			memcpy(callback, response, response->header.length);
-			queue_put(&ipcon_p->callback->queue, QUEUE_KIND_PACKET, callback);
-		}
+	mutex_lock(&ipcon_p->authentication_mutex);
 
-		return;
+	if (ipcon_p->next_authentication_nonce == 0) {
+		ipcon_p->next_authentication_nonce = get_random_uint32();
 	}
 
-	device_p = ipcon_acquire_device(ipcon_p, response->header.uid);
+	ret = brickd_get_authentication_nonce(&ipcon_p->brickd, (uint8_t *)nonces);
 
-	if (device_p == NULL) {
-		// ignoring response for an unknown device
-		return;
+	if (ret < 0) {
+		mutex_unlock(&ipcon_p->authentication_mutex);
+
+		return ret;
 	}
 
-	if (sequence_number == 0) {
-		if (device_p->registered_callbacks[DEVICE_NUM_FUNCTION_IDS + response->header.function_id] != NULL ||
-		    device_p->high_level_callbacks[response->header.function_id].exists) {
-			callback = (Packet *)malloc(response->header.length);
+	nonces[1] = ipcon_p->next_authentication_nonce++;
 
-			memcpy(callback, response, response->header.length);
-			queue_put(&ipcon_p->callback->queue, QUEUE_KIND_PACKET, callback);
-		}
+	hmac_sha1((uint8_t *)secret, string_length(secret, IPCON_MAX_SECRET_LENGTH),
+	          (uint8_t *)nonces, sizeof(nonces), digest);
 
-		device_release(device_p);
+	ret = brickd_authenticate(&ipcon_p->brickd, (uint8_t *)&nonces[1], digest);
 
-		return;
+	if (ret < 0) {
+		mutex_unlock(&ipcon_p->authentication_mutex);
+
+		return ret;
 	}
 
-	if (device_p->expected_response_function_id == response->header.function_id &&
-	    device_p->expected_response_sequence_number == sequence_number) {
-		mutex_lock(&device_p->response_mutex);
-		memcpy(&device_p->response_packet, response, response->header.length);
-		mutex_unlock(&device_p->response_mutex);
+	mutex_unlock(&ipcon_p->authentication_mutex);
 
-		event_set(&device_p->response_event);
+	return E_OK;
+}
 
-		device_release(device_p);
+int ipcon_get_connection_state(IPConnection *ipcon) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
 
-		return;
+	if (ipcon_p->socket != NULL || ipcon_p->replay != NULL) {
+		return IPCON_CONNECTION_STATE_CONNECTED;
+	} else if (ipcon_p->auto_reconnect_pending) {
+		return IPCON_CONNECTION_STATE_PENDING;
+	} else {
+		return IPCON_CONNECTION_STATE_DISCONNECTED;
 	}
-
-	device_release(device_p);
-
-	// response seems to be OK, but can't be handled
 }
 
-// NOTE: the receive loop is now allowed to hold the socket_mutex at any time
-//       because it is created and joined while the socket_mutex is locked
-static void ipcon_receive_loop(void *opaque) {
-	IPConnectionPrivate *ipcon_p = (IPConnectionPrivate *)opaque;
-	uint64_t socket_id = ipcon_p->socket_id;
-	Packet pending_data[10];
-	int pending_length = 0;
-	int length;
-	uint8_t disconnect_reason;
+void ipcon_set_auto_reconnect(IPConnection *ipcon, bool auto_reconnect) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
 
-	while (ipcon_p->receive_flag) {
-		length = socket_receive(ipcon_p->socket, (uint8_t *)pending_data + pending_length,
-		                        sizeof(pending_data) - pending_length);
+	ipcon_p->auto_reconnect = auto_reconnect;
 
-		if (!ipcon_p->receive_flag) {
-			return;
-		}
+	if (!ipcon_p->auto_reconnect) {
+		// abort potentially pending auto reconnect
+		ipcon_p->auto_reconnect_allowed = false;
+	}
+}
 
-		if (length <= 0) {
-			if (length < 0 && errno == EINTR) {
-				continue;
-			}
+bool ipcon_get_auto_reconnect(IPConnection *ipcon) {
+	return ipcon->p->auto_reconnect;
+}
 
-			if (length == 0) {
-				disconnect_reason = IPCON_DISCONNECT_REASON_SHUTDOWN;
-			} else {
-				disconnect_reason = IPCON_DISCONNECT_REASON_ERROR;
-			}
+void ipcon_set_timeout(IPConnection *ipcon, uint32_t timeout) { // in msec
+	ipcon->p->timeout = timeout;
+}
 
-			ipcon_handle_disconnect_by_peer(ipcon_p, disconnect_reason, socket_id, false);
-			return;
-		}
+uint32_t ipcon_get_timeout(IPConnection *ipcon) { // in msec
+	return ipcon->p->timeout;
+}
+
+int ipcon_set_reactor(IPConnection *ipcon, bool reactor) {
+#ifdef IPCON_HAVE_REACTOR
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	int ret = E_OK;
 
-		pending_length += length;
+	mutex_lock(&ipcon_p->socket_mutex);
 
-		while (ipcon_p->receive_flag) {
-			if (pending_length < (int)sizeof(PacketHeader)) {
-				// wait for complete header
-				break;
-			}
+	if (ipcon_p->socket != NULL || ipcon_p->auto_reconnect_pending) {
+		ret = E_ALREADY_CONNECTED;
+	} else {
+		ipcon_p->reactor = reactor;
+	}
 
-			length = pending_data[0].header.length;
+	mutex_unlock(&ipcon_p->socket_mutex);
 
-			if (pending_length < length) {
-				// wait for complete packet
-				break;
-			}
+	return ret;
+#else
+	(void)ipcon;
 
-			ipcon_handle_response(ipcon_p, pending_data);
+	return reactor ? E_NOT_SUPPORTED : E_OK;
+#endif
+}
 
-			memmove(pending_data, (uint8_t *)pending_data + length,
-			        pending_length - length);
-			pending_length -= length;
-		}
-	}
+bool ipcon_get_reactor(IPConnection *ipcon) {
+	return ipcon->p->reactor;
 }
 
-// NOTE: assumes that socket is NULL and socket_mutex is locked
-static int ipcon_connect_unlocked(IPConnectionPrivate *ipcon_p, bool is_auto_reconnect) {
-	char service[32];
-	struct addrinfo hints;
-	struct addrinfo *resolved = NULL;
-	Socket *tmp;
-	uint8_t connect_reason;
-	Meta *meta;
+int ipcon_set_send_batching(IPConnection *ipcon, bool send_batching) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	int ret = E_OK;
 
-	// create callback queue and thread
-	if (ipcon_p->callback == NULL) {
-		ipcon_p->callback = (CallbackContext *)malloc(sizeof(CallbackContext));
+	mutex_lock(&ipcon_p->send_mutex);
 
-		ipcon_p->callback->ipcon_p = ipcon_p;
-		ipcon_p->callback->packet_dispatch_allowed = false;
+	ipcon_p->send_batching = send_batching;
 
-		queue_create(&ipcon_p->callback->queue);
-		mutex_create(&ipcon_p->callback->mutex);
+	if (!send_batching && !ipcon_p->send_flushing && ipcon_p->send_buffer_length > 0) {
+		ret = ipcon_flush_send_buffer(ipcon_p);
+	}
 
-		if (thread_create(&ipcon_p->callback->thread, ipcon_callback_loop,
-		                  ipcon_p->callback) < 0) {
-			mutex_destroy(&ipcon_p->callback->mutex);
-			queue_destroy(&ipcon_p->callback->queue);
+	mutex_unlock(&ipcon_p->send_mutex);
 
-			free(ipcon_p->callback);
-			ipcon_p->callback = NULL;
+	// let the disconnect probe thread or the reactor pick up the new tick. the
+	// send_mutex is not held here, because flushing takes the socket_mutex
+	mutex_lock(&ipcon_p->socket_mutex);
 
-			return E_NO_THREAD;
+	if (ipcon_p->socket != NULL) {
+#ifdef IPCON_HAVE_REACTOR
+		if (ipcon_p->reactor_slot >= 0) {
+			mutex_lock(&shared_reactor.mutex);
+			reactor_arm_timer(shared_reactor.slots[ipcon_p->reactor_slot].timer_handle,
+			                  ipcon_p->send_batching);
+			mutex_unlock(&shared_reactor.mutex);
+		} else
+#endif
+		if (send_batching) {
+			event_set(&ipcon_p->disconnect_probe_event);
 		}
 	}
 
-	// create and connect socket
-	snprintf(service, sizeof(service), "%u", ipcon_p->port);
-
-	memset(&hints, 0, sizeof(hints));
+	mutex_unlock(&ipcon_p->socket_mutex);
 
-	hints.ai_flags = AI_PASSIVE;
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
+	return ret;
+}
 
-	if (getaddrinfo(ipcon_p->host, service, &hints, &resolved) != 0) {
-		// destroy callback thread
-		if (!is_auto_reconnect) {
-			ipcon_exit_callback_thread(ipcon_p->callback);
-			ipcon_p->callback = NULL;
-		}
+bool ipcon_get_send_batching(IPConnection *ipcon) {
+	return ipcon->p->send_batching;
+}
 
-		return E_HOSTNAME_INVALID;
-	}
+int ipcon_set_low_latency(IPConnection *ipcon, bool low_latency) {
+#ifdef IPCON_HAVE_FUTEX
+	IPConnectionPrivate *ipcon_p = ipcon->p;
 
-	tmp = (Socket *)malloc(sizeof(Socket));
+	// pending requests keep the mode they were started with
+	mutex_lock(&ipcon_p->pending_request_mutex);
 
-	if (socket_create(tmp, resolved->ai_family, resolved->ai_socktype,
-	                  resolved->ai_protocol) < 0) {
-		// destroy callback thread
-		if (!is_auto_reconnect) {
-			ipcon_exit_callback_thread(ipcon_p->callback);
-			ipcon_p->callback = NULL;
-		}
+	ipcon_p->low_latency = low_latency;
+	ipcon_p->completion_spin_max = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? IPCON_MAX_COMPLETION_SPIN : 0;
 
-		// destroy socket
-		free(tmp);
-		freeaddrinfo(resolved);
+	mutex_unlock(&ipcon_p->pending_request_mutex);
 
-		return E_NO_STREAM_SOCKET;
-	}
+	return E_OK;
+#else
+	(void)ipcon;
 
-	if (socket_connect(tmp, resolved->ai_addr, resolved->ai_addrlen) < 0) {
-		// destroy callback thread
-		if (!is_auto_reconnect) {
-			ipcon_exit_callback_thread(ipcon_p->callback);
-			ipcon_p->callback = NULL;
-		}
+	return low_latency ? E_NOT_SUPPORTED : E_OK;
+#endif
+}
 
-		// destroy socket
-		socket_destroy(tmp);
-		free(tmp);
-		freeaddrinfo(resolved);
+bool ipcon_get_low_latency(IPConnection *ipcon) {
+	return ipcon->p->low_latency;
+}
 
-		return E_NO_CONNECT;
-	}
+void ipcon_get_send_statistics(IPConnection *ipcon, uint64_t *ret_packets,
+                               uint64_t *ret_send_calls) {
+	*ret_packets = atomic_load_uint64(&ipcon->p->send_packet_count);
+	*ret_send_calls = atomic_load_uint64(&ipcon->p->send_call_count);
+}
 
-	freeaddrinfo(resolved);
+int ipcon_get_queue_statistics(IPConnection *ipcon, uint32_t *ret_depth,
+                               uint32_t *ret_high_water, uint64_t *ret_overflows,
+                               uint64_t *ret_drops) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	Queue *queue;
+	int ret = E_OK;
+	int i;
 
-	ipcon_p->socket = tmp;
-	++ipcon_p->socket_id;
+	mutex_lock(&ipcon_p->socket_mutex);
 
-	// create disconnect probe thread
-	ipcon_p->disconnect_probe_flag = true;
+	if (ipcon_p->callback == NULL) {
+		ret = E_NOT_CONNECTED;
+	} else {
+		*ret_depth = 0;
+		*ret_high_water = 0;
+		*ret_overflows = 0;
+		*ret_drops = 0;
+
+		for (i = 0; i < ipcon_p->callback->worker_count; ++i) {
+			queue = &ipcon_p->callback->workers[i].queue;
+
+			*ret_depth += queue_get_depth(queue);
+			*ret_high_water += atomic_load_uint32(&queue->high_water);
+			*ret_overflows += atomic_load_uint64(&queue->overflows);
+			*ret_drops += atomic_load_uint64(&queue->drops);
+		}
+	}
 
-	event_reset(&ipcon_p->disconnect_probe_event);
+	mutex_unlock(&ipcon_p->socket_mutex);
 
-	if (thread_create(&ipcon_p->disconnect_probe_thread,
-	                  ipcon_disconnect_probe_loop, ipcon_p) < 0) {
-		// destroy callback thread
-		if (!is_auto_reconnect) {
-			ipcon_exit_callback_thread(ipcon_p->callback);
-			ipcon_p->callback = NULL;
-		}
+	return ret;
+}
 
-		// destroy socket
-		socket_destroy(ipcon_p->socket);
-		free(ipcon_p->socket);
-		ipcon_p->socket = NULL;
+void ipcon_set_callback_workers(IPConnection *ipcon, uint8_t workers) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
 
-		return E_NO_THREAD;
+	if (workers < 1) {
+		workers = 1;
+	} else if (workers > IPCON_MAX_CALLBACK_WORKERS) {
+		workers = IPCON_MAX_CALLBACK_WORKERS;
 	}
 
-	// create receive thread
-	ipcon_p->receive_flag = true;
-	ipcon_p->callback->packet_dispatch_allowed = true;
+	mutex_lock(&ipcon_p->socket_mutex);
 
-	if (thread_create(&ipcon_p->receive_thread, ipcon_receive_loop, ipcon_p) < 0) {
-		ipcon_p->receive_flag = false;
+	ipcon_p->callback_worker_count = workers;
 
-		// destroy socket
-		ipcon_disconnect_unlocked(ipcon_p);
+	mutex_unlock(&ipcon_p->socket_mutex);
+}
 
-		// destroy callback thread
-		if (!is_auto_reconnect) {
-			ipcon_exit_callback_thread(ipcon_p->callback);
-			ipcon_p->callback = NULL;
-		}
+uint8_t ipcon_get_callback_workers(IPConnection *ipcon) {
+	return (uint8_t)ipcon->p->callback_worker_count;
+}
 
-		return E_NO_THREAD;
-	}
+void ipcon_set_callback_queue_capacity(IPConnection *ipcon, uint32_t capacity,
+                                       uint8_t policy) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
 
-	ipcon_p->auto_reconnect_allowed = false;
-	ipcon_p->auto_reconnect_pending = false;
+	if (capacity > IPCON_MAX_CALLBACK_QUEUE_CAPACITY) {
+		capacity = IPCON_MAX_CALLBACK_QUEUE_CAPACITY;
+	}
 
-	// trigger connected callback
-	if (is_auto_reconnect) {
-		connect_reason = IPCON_CONNECT_REASON_AUTO_RECONNECT;
-	} else {
-		connect_reason = IPCON_CONNECT_REASON_REQUEST;
+	if (policy > IPCON_QUEUE_POLICY_KEEP_LATEST) {
+		policy = IPCON_QUEUE_POLICY_BLOCK;
 	}
 
-	meta = (Meta *)malloc(sizeof(Meta));
-	meta->function_id = IPCON_CALLBACK_CONNECTED;
-	meta->parameter = connect_reason;
-	meta->socket_id = 0;
+	mutex_lock(&ipcon_p->socket_mutex);
 
-	queue_put(&ipcon_p->callback->queue, QUEUE_KIND_META, meta);
+	ipcon_p->callback_queue_capacity = capacity;
+	ipcon_p->callback_queue_policy = policy;
 
-	return E_OK;
+	mutex_unlock(&ipcon_p->socket_mutex);
 }
 
-// NOTE: assumes that socket is not NULL and socket_mutex is locked
-static void ipcon_disconnect_unlocked(IPConnectionPrivate *ipcon_p) {
-	// destroy disconnect probe thread
-	event_set(&ipcon_p->disconnect_probe_event);
-	thread_join(&ipcon_p->disconnect_probe_thread);
-	thread_destroy(&ipcon_p->disconnect_probe_thread);
+void ipcon_get_callback_queue_capacity(IPConnection *ipcon, uint32_t *ret_capacity,
+                                       uint8_t *ret_policy) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+
+	mutex_lock(&ipcon_p->socket_mutex);
+
+	*ret_capacity = ipcon_p->callback_queue_capacity;
+	*ret_policy = ipcon_p->callback_queue_policy;
 
-	// stop dispatching packet callbacks before ending the receive
-	// thread to avoid timeout exceptions due to callback functions
-	// trying to call getters
-	if (!thread_is_current(&ipcon_p->callback->thread)) {
-		// FIXME: cannot lock callback mutex here because this can
-		//        deadlock due to an ordering problem with the socket mutex
-		//mutex_lock(&ipcon->callback->mutex);
+	mutex_unlock(&ipcon_p->socket_mutex);
+}
 
-		ipcon_p->callback->packet_dispatch_allowed = false;
+int ipcon_get_callback_timestamp(IPConnection *ipcon, uint64_t *ret_monotonic,
+                                 uint64_t *ret_realtime) {
+	// no locking, while the calling thread runs a callback the callback
+	// context cannot be destroyed
+	CallbackContext *callback = ipcon->p->callback;
+	uint64_t timestamp;
+	int i;
 
-		//mutex_unlock(&ipcon->callback->mutex);
-	} else {
-		ipcon_p->callback->packet_dispatch_allowed = false;
+	if (callback == NULL) {
+		return E_INVALID_PARAMETER;
 	}
 
-	// destroy receive thread
-	if (ipcon_p->receive_flag) {
-		ipcon_p->receive_flag = false;
+	for (i = 0; i < callback->worker_count; ++i) {
+		if (thread_is_current(&callback->workers[i].thread)) {
+			timestamp = callback->workers[i].dispatch_timestamp;
 
-		socket_shutdown(ipcon_p->socket);
+			*ret_monotonic = timestamp;
+			*ret_realtime = get_realtime_usec() - (get_monotonic_usec() - timestamp);
 
-		thread_join(&ipcon_p->receive_thread);
-		thread_destroy(&ipcon_p->receive_thread);
+			return E_OK;
+		}
 	}
 
-	// destroy socket
-	socket_destroy(ipcon_p->socket);
-	free(ipcon_p->socket);
-	ipcon_p->socket = NULL;
+	return E_INVALID_PARAMETER;
 }
 
-static int ipcon_send_request(IPConnectionPrivate *ipcon_p, Packet *request) {
+int ipcon_get_callback_worker_statistics(IPConnection *ipcon, uint8_t worker,
+                                         uint32_t *ret_depth, uint64_t *ret_dispatched,
+                                         uint32_t *ret_average_latency,
+                                         uint32_t *ret_maximum_latency) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	CallbackWorker *callback_worker;
 	int ret = E_OK;
 
 	mutex_lock(&ipcon_p->socket_mutex);
 
-	if (ipcon_p->socket == NULL) {
+	if (ipcon_p->callback == NULL) {
 		ret = E_NOT_CONNECTED;
-	}
-
-	if (ret == E_OK) {
-		if (socket_send(ipcon_p->socket, request, request->header.length) < 0) {
-			ipcon_handle_disconnect_by_peer(ipcon_p, IPCON_DISCONNECT_REASON_ERROR,
-			                                0, true);
+	} else if (worker >= ipcon_p->callback->worker_count) {
+		ret = E_INVALID_PARAMETER;
+	} else {
+		callback_worker = &ipcon_p->callback->workers[worker];
 
-			ret = E_NOT_CONNECTED;
-		} else {
-			ipcon_p->disconnect_probe_flag = false;
-		}
+		*ret_depth = queue_get_depth(&callback_worker->queue);
+		*ret_dispatched = atomic_load_uint64(&callback_worker->dispatch_count);
+		*ret_average_latency = *ret_dispatched > 0 ? (uint32_t)(atomic_load_uint64(&callback_worker->latency_sum) / *ret_dispatched) : 0;
+		*ret_maximum_latency = atomic_load_uint32(&callback_worker->latency_max);
 	}
 
 	mutex_unlock(&ipcon_p->socket_mutex);
@@ -2062,233 +5014,352 @@ static int ipcon_send_request(IPConnectionPrivate *ipcon_p, Packet *request) {
 	return ret;
 }
 
-void ipcon_create(IPConnection *ipcon) {
-	IPConnectionPrivate *ipcon_p;
-	int i;
+void ipcon_get_io_statistics(uint32_t *ret_threads, uint64_t *ret_wakeups) {
+	*ret_threads = atomic_load_uint32(&io_thread_count);
+	*ret_wakeups = atomic_load_uint64(&io_wakeup_count);
+}
 
-	ipcon_p = (IPConnectionPrivate *)malloc(sizeof(IPConnectionPrivate));
-	ipcon->p = ipcon_p;
+void ipcon_set_latency_tracking(IPConnection *ipcon, bool latency_tracking) {
+	ipcon->p->latency_tracking = latency_tracking;
+}
 
-#ifdef _WIN32
-	ipcon_p->wsa_startup_done = false;
-#endif
+bool ipcon_get_latency_tracking(IPConnection *ipcon) {
+	return ipcon->p->latency_tracking;
+}
 
-	ipcon_p->host = NULL;
-	ipcon_p->port = 0;
+void ipcon_get_latency_histograms(IPConnection *ipcon,
+                                  LatencyHistogramFunction function,
+                                  void *user_data) {
+	DevicePrivate **devices;
+	int device_count;
+	LatencyHistogram **histograms;
+	LatencyHistogram *histogram;
+	LatencyHistogram copy;
+	char uid_str[BASE58_MAX_STR_SIZE];
+	int i;
+	int k;
 
-	ipcon_p->timeout = 2500;
+	devices = ipcon_acquire_devices(ipcon->p, &device_count);
 
-	ipcon_p->auto_reconnect = true;
-	ipcon_p->auto_reconnect_allowed = false;
-	ipcon_p->auto_reconnect_pending = false;
+	for (i = 0; i < device_count; ++i) {
+		histograms = (LatencyHistogram **)atomic_load_pointer((void *volatile *)&devices[i]->latency_histograms);
 
-	mutex_create(&ipcon_p->sequence_number_mutex);
-	ipcon_p->next_sequence_number = 0;
+		if (histograms != NULL) {
+			base58_encode(devices[i]->uid, uid_str);
 
-	mutex_create(&ipcon_p->authentication_mutex);
-	ipcon_p->next_authentication_nonce = 0;
+			for (k = 0; k < DEVICE_NUM_FUNCTION_IDS * IPCON_NUM_LATENCY_KINDS; ++k) {
+				histogram = (LatencyHistogram *)atomic_load_pointer((void *volatile *)&histograms[k]);
 
-	mutex_create(&ipcon_p->devices_ref_mutex);
-	table_create(&ipcon_p->devices);
+				if (histogram != NULL) {
+					latency_histogram_copy(&copy, histogram);
 
-	for (i = 0; i < IPCON_NUM_CALLBACK_IDS; ++i) {
-		ipcon_p->registered_callbacks[i] = NULL;
-		ipcon_p->registered_callback_user_data[i] = NULL;
+					function(uid_str, (uint8_t)(k / IPCON_NUM_LATENCY_KINDS),
+					         (uint8_t)(k % IPCON_NUM_LATENCY_KINDS), &copy, user_data);
+				}
+			}
+		}
+
+		device_release(devices[i]);
 	}
 
-	mutex_create(&ipcon_p->socket_mutex);
-	ipcon_p->socket = NULL;
-	ipcon_p->socket_id = 0;
+	free(devices);
+}
 
-	ipcon_p->receive_flag = false;
+void ipcon_reset_latency_histograms(IPConnection *ipcon) {
+	DevicePrivate **devices;
+	int device_count;
+	LatencyHistogram **histograms;
+	LatencyHistogram *histogram;
+	int i;
+	int k;
 
-	ipcon_p->callback = NULL;
+	devices = ipcon_acquire_devices(ipcon->p, &device_count);
 
-	ipcon_p->disconnect_probe_flag = false;
-	event_create(&ipcon_p->disconnect_probe_event);
+	for (i = 0; i < device_count; ++i) {
+		histograms = (LatencyHistogram **)atomic_load_pointer((void *volatile *)&devices[i]->latency_histograms);
 
-	semaphore_create(&ipcon_p->wait);
+		if (histograms != NULL) {
+			for (k = 0; k < DEVICE_NUM_FUNCTION_IDS * IPCON_NUM_LATENCY_KINDS; ++k) {
+				histogram = (LatencyHistogram *)atomic_load_pointer((void *volatile *)&histograms[k]);
 
-	brickd_create(&ipcon_p->brickd, "2", ipcon);
+				if (histogram != NULL) {
+					latency_histogram_reset(histogram);
+				}
+			}
+		}
+
+		device_release(devices[i]);
+	}
+
+	free(devices);
 }
 
-void ipcon_destroy(IPConnection *ipcon) {
-	IPConnectionPrivate *ipcon_p = ipcon->p;
+uint32_t ipcon_get_latency_bucket_limit(int bucket) {
+	int octave;
+	int sub_bucket;
+	int shift;
+	uint32_t lower;
 
-	ipcon_disconnect(ipcon); // FIXME: disable disconnected callback before?
+	if (bucket < LATENCY_LINEAR_BUCKETS) {
+		return bucket < 0 ? 0 : (uint32_t)bucket;
+	}
 
-	brickd_destroy(&ipcon_p->brickd);
+	if (bucket >= IPCON_LATENCY_HISTOGRAM_BUCKETS) {
+		return UINT32_MAX;
+	}
 
-	mutex_destroy(&ipcon_p->authentication_mutex);
+	octave = (bucket - LATENCY_LINEAR_BUCKETS) >> LATENCY_SUB_BUCKET_BITS;
+	sub_bucket = (bucket - LATENCY_LINEAR_BUCKETS) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+	shift = octave + LATENCY_LINEAR_BITS - LATENCY_SUB_BUCKET_BITS;
+	lower = (uint32_t)((1 << LATENCY_SUB_BUCKET_BITS) + sub_bucket) << shift;
 
-	mutex_destroy(&ipcon_p->sequence_number_mutex);
+	return lower + (((uint32_t)1 << shift) - 1);
+}
 
-	table_destroy(&ipcon_p->devices); // FIXME: destroy all devices?
-	mutex_destroy(&ipcon_p->devices_ref_mutex);
+uint32_t ipcon_get_latency_percentile(const LatencyHistogram *histogram,
+                                      double percentile) {
+	uint64_t total = 0;
+	uint64_t seen = 0;
+	double exact;
+	uint64_t rank;
+	uint32_t limit;
+	int i;
 
-	mutex_destroy(&ipcon_p->socket_mutex);
+	for (i = 0; i < IPCON_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		total += histogram->buckets[i];
+	}
 
-	event_destroy(&ipcon_p->disconnect_probe_event);
+	if (total == 0) {
+		return 0;
+	}
 
-	semaphore_destroy(&ipcon_p->wait);
+	if (percentile < 0.0) {
+		percentile = 0.0;
+	} else if (percentile > 100.0) {
+		percentile = 100.0;
+	}
 
-	free(ipcon_p->host);
+	// the smallest number of latencies that covers the percentile, at least one
+	exact = percentile * (double)total / 100.0;
+	rank = (uint64_t)exact;
 
-	free(ipcon_p);
-}
+	if ((double)rank < exact) {
+		++rank;
+	}
 
-int ipcon_connect(IPConnection *ipcon, const char *host, uint16_t port) {
-	IPConnectionPrivate *ipcon_p = ipcon->p;
-	int ret;
-#ifdef _WIN32
-	WSADATA wsa_data;
-#endif
+	if (rank == 0) {
+		rank = 1;
+	}
 
-	mutex_lock(&ipcon_p->socket_mutex);
+	for (i = 0; i < IPCON_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		seen += histogram->buckets[i];
 
-#ifdef _WIN32
-	if (!ipcon_p->wsa_startup_done) {
-		if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
-			mutex_unlock(&ipcon_p->socket_mutex);
+		if (seen >= rank) {
+			limit = ipcon_get_latency_bucket_limit(i);
 
-			return E_NO_STREAM_SOCKET;
+			return limit < histogram->max ? limit : histogram->max;
 		}
-
-		ipcon_p->wsa_startup_done = true;
 	}
-#endif
 
-	if (ipcon_p->socket != NULL) {
-		mutex_unlock(&ipcon_p->socket_mutex);
+	return histogram->max;
+}
+
+int ipcon_start_capture(IPConnection *ipcon, const char *filename) {
+	IPConnectionPrivate *ipcon_p = ipcon->p;
+	Capture *capture;
+
+	mutex_lock(&ipcon_p->capture_mutex);
+
+	if (ipcon_p->capture != NULL) {
+		mutex_unlock(&ipcon_p->capture_mutex);
 
 		return E_ALREADY_CONNECTED;
 	}
 
-	free(ipcon_p->host);
+	capture = capture_create(filename);
 
-	ipcon_p->host = strdup(host);
-	ipcon_p->port = port;
+	if (capture == NULL) {
+		mutex_unlock(&ipcon_p->capture_mutex);
 
-	ret = ipcon_connect_unlocked(ipcon_p, false);
+		return E_CAPTURE_FILE;
+	}
 
-	mutex_unlock(&ipcon_p->socket_mutex);
+	atomic_store_pointer((void *volatile *)&ipcon_p->capture, capture);
 
-	return ret;
+	mutex_unlock(&ipcon_p->capture_mutex);
+
+	return E_OK;
 }
 
-int ipcon_disconnect(IPConnection *ipcon) {
+int ipcon_stop_capture(IPConnection *ipcon) {
 	IPConnectionPrivate *ipcon_p = ipcon->p;
-	CallbackContext *callback;
-	Meta *meta;
+	Capture *capture;
 
-	mutex_lock(&ipcon_p->socket_mutex);
+	mutex_lock(&ipcon_p->capture_mutex);
 
-	ipcon_p->auto_reconnect_allowed = false;
+	capture = ipcon_p->capture;
 
-	if (ipcon_p->auto_reconnect_pending) {
-		// abort pending auto-reconnect
-		ipcon_p->auto_reconnect_pending = false;
-	} else {
-		if (ipcon_p->socket == NULL) {
-			mutex_unlock(&ipcon_p->socket_mutex);
+	atomic_store_pointer((void *volatile *)&ipcon_p->capture, NULL);
 
-			return E_NOT_CONNECTED;
-		}
+	mutex_unlock(&ipcon_p->capture_mutex);
 
-		ipcon_disconnect_unlocked(ipcon_p);
+	if (capture == NULL) {
+		return E_NOT_CONNECTED;
 	}
 
-	// destroy callback thread
-	callback = ipcon_p->callback;
-	ipcon_p->callback = NULL;
+	return capture_destroy(capture);
+}
 
-	mutex_unlock(&ipcon_p->socket_mutex);
+enum {
+	IPCON_REPLAY_MAX_SLEEP = 100 // in msec, bounds the reaction to ipcon_disconnect
+};
 
-	// do this outside of socket_mutex to allow calling (dis-)connect from
-	// the callbacks while blocking on the join call here
-	meta = (Meta *)malloc(sizeof(Meta));
-	meta->function_id = IPCON_CALLBACK_DISCONNECTED;
-	meta->parameter = IPCON_DISCONNECT_REASON_REQUEST;
+// NOTE: waits until the given callback thread returned from all callbacks that
+//       were queued before. this can't be given up, the barrier refers to the
+//       replay
+static void ipcon_replay_barrier(IPConnectionPrivate *ipcon_p, Replay *replay,
+                                 int worker) {
+	Meta *meta = (Meta *)malloc(sizeof(Meta));
+
+	meta->function_id = IPCON_META_REPLAY_BARRIER;
+	meta->parameter = 0;
 	meta->socket_id = 0;
 
-	queue_put(&callback->queue, QUEUE_KIND_META, meta);
+	event_reset(&replay->barrier);
 
-	ipcon_exit_callback_thread(callback);
+	queue_put(&ipcon_p->callback->workers[worker].queue, QUEUE_KIND_META, meta);
 
-	return E_OK;
+	while (event_wait(&replay->barrier, IPCON_REPLAY_MAX_SLEEP) < 0) {
+		// keep waiting
+	}
 }
 
-int ipcon_authenticate(IPConnection *ipcon, const char secret[64]) {
+int ipcon_replay(IPConnection *ipcon, const char *filename, double speed) {
 	IPConnectionPrivate *ipcon_p = ipcon->p;
-	int ret;
-	uint32_t nonces[2]; // server, client
-	uint8_t digest[SHA1_DIGEST_LENGTH];
+	Replay *replay = replay_create(filename);
+	ReplayResponse *replay_response;
+	int64_t offset;
+	uint64_t delta;
+	uint64_t capture_time = 0; // in usec since the start of the capture
+	uint64_t start;
+	uint64_t target;
+	uint64_t now;
+	int direction;
+	Packet *record;
+	Packet packet;
+	Meta *meta;
+	bool stopped;
+	int i;
 
-	mutex_lock(&ipcon_p->authentication_mutex);
+	if (replay == NULL) {
+		return E_CAPTURE_FILE;
+	}
 
-	if (ipcon_p->next_authentication_nonce == 0) {
-		ipcon_p->next_authentication_nonce = get_random_uint32();
+	mutex_lock(&ipcon_p->socket_mutex);
+
+	if (ipcon_p->socket != NULL || ipcon_p->replay != NULL ||
+	    ipcon_p->auto_reconnect_pending) {
+		mutex_unlock(&ipcon_p->socket_mutex);
+		replay_destroy(replay);
+
+		return E_ALREADY_CONNECTED;
 	}
 
-	ret = brickd_get_authentication_nonce(&ipcon_p->brickd, (uint8_t *)nonces);
+	if (ipcon_p->callback == NULL) {
+		ipcon_p->callback = ipcon_create_callback_context(ipcon_p);
 
-	if (ret < 0) {
-		mutex_unlock(&ipcon_p->authentication_mutex);
+		if (ipcon_p->callback == NULL) {
+			mutex_unlock(&ipcon_p->socket_mutex);
+			replay_destroy(replay);
 
-		return ret;
+			return E_NO_THREAD;
+		}
 	}
 
-	nonces[1] = ipcon_p->next_authentication_nonce++;
+	// the replay takes the place of the receive thread
+	ipcon_p->replay = replay;
+	ipcon_p->auto_reconnect_allowed = false;
+	ipcon_p->receive_flag = true;
+	ipcon_p->callback->packet_dispatch_allowed = true;
 
-	hmac_sha1((uint8_t *)secret, string_length(secret, IPCON_MAX_SECRET_LENGTH),
-	          (uint8_t *)nonces, sizeof(nonces), digest);
+	meta = (Meta *)malloc(sizeof(Meta));
+	meta->function_id = IPCON_CALLBACK_CONNECTED;
+	meta->parameter = IPCON_CONNECT_REASON_REQUEST;
+	meta->socket_id = 0;
 
-	ret = brickd_authenticate(&ipcon_p->brickd, (uint8_t *)&nonces[1], digest);
+	queue_put(&ipcon_p->callback->workers[0].queue, QUEUE_KIND_META, meta);
 
-	if (ret < 0) {
-		mutex_unlock(&ipcon_p->authentication_mutex);
+	mutex_unlock(&ipcon_p->socket_mutex);
 
-		return ret;
-	}
+	start = get_monotonic_usec();
 
-	mutex_unlock(&ipcon_p->authentication_mutex);
+	for (offset = replay_read_record(replay, 16, &delta, &direction, &record);
+	     offset > 0 && !replay->stop;
+	     offset = replay_read_record(replay, offset, &delta, &direction, &record)) {
+		capture_time += delta;
 
-	return E_OK;
-}
+		if (speed > 0) {
+			target = start + (uint64_t)((double)capture_time / speed);
 
-int ipcon_get_connection_state(IPConnection *ipcon) {
-	IPConnectionPrivate *ipcon_p = ipcon->p;
+			while (!replay->stop && (now = get_monotonic_usec()) + 1000 <= target) {
+				millisleep((uint32_t)((target - now) / 1000 < IPCON_REPLAY_MAX_SLEEP ?
+				                      (target - now) / 1000 : IPCON_REPLAY_MAX_SLEEP));
+			}
+		}
 
-	if (ipcon_p->socket != NULL) {
-		return IPCON_CONNECTION_STATE_CONNECTED;
-	} else if (ipcon_p->auto_reconnect_pending) {
-		return IPCON_CONNECTION_STATE_PENDING;
-	} else {
-		return IPCON_CONNECTION_STATE_DISCONNECTED;
-	}
-}
+		if (direction != CAPTURE_DIRECTION_RECEIVED) {
+			continue;
+		}
 
-void ipcon_set_auto_reconnect(IPConnection *ipcon, bool auto_reconnect) {
-	IPConnectionPrivate *ipcon_p = ipcon->p;
+		if (replay_is_response(record, direction)) {
+			// the responses of the capture can't belong to any request of
+			// this replay, they only update the answers to new requests
+			replay_response = replay_find_response(replay, record);
 
-	ipcon_p->auto_reconnect = auto_reconnect;
+			atomic_store_pointer((void *volatile *)&replay_response->response, record);
+		} else {
+			// ipcon_handle_response converts the packet in place
+			memcpy(&packet, record, record->header.length);
+
+			ipcon_handle_response(ipcon_p, &packet, get_monotonic_usec());
+
+			// the application brings up its devices in the enumerate
+			// callback. continue after it returned, otherwise it depends
+			// on the replay speed which callbacks find their device
+			if (packet.header.function_id == IPCON_CALLBACK_ENUMERATE &&
+			    packet_header_get_sequence_number(&packet.header) == 0 &&
+			    ipcon_p->registered_callbacks[IPCON_CALLBACK_ENUMERATE] != NULL) {
+				ipcon_replay_barrier(ipcon_p, replay, 0);
+			}
+		}
+	}
 
-	if (!ipcon_p->auto_reconnect) {
-		// abort potentially pending auto reconnect
-		ipcon_p->auto_reconnect_allowed = false;
+	// let the callback threads dispatch all replayed callbacks before they
+	// stop, otherwise the end of the replay would be lost
+	for (i = 0; i < ipcon_p->callback->worker_count; ++i) {
+		ipcon_replay_barrier(ipcon_p, replay, i);
 	}
-}
 
-bool ipcon_get_auto_reconnect(IPConnection *ipcon) {
-	return ipcon->p->auto_reconnect;
-}
+	mutex_lock(&ipcon_p->socket_mutex);
 
-void ipcon_set_timeout(IPConnection *ipcon, uint32_t timeout) { // in msec
-	ipcon->p->timeout = timeout;
-}
+	stopped = replay->stop;
 
-uint32_t ipcon_get_timeout(IPConnection *ipcon) { // in msec
-	return ipcon->p->timeout;
+	ipcon_p->callback->packet_dispatch_allowed = false;
+	ipcon_p->receive_flag = false;
+	ipcon_p->replay = NULL;
+
+	meta = (Meta *)malloc(sizeof(Meta));
+	meta->function_id = IPCON_CALLBACK_DISCONNECTED;
+	meta->parameter = stopped ? IPCON_DISCONNECT_REASON_REQUEST : IPCON_DISCONNECT_REASON_SHUTDOWN;
+	meta->socket_id = 0;
+
+	queue_put(&ipcon_p->callback->workers[0].queue, QUEUE_KIND_META, meta);
+
+	mutex_unlock(&ipcon_p->socket_mutex);
+
+	replay_destroy(replay);
+
+	return E_OK;
 }
 
 int ipcon_enumerate(IPConnection *ipcon) {
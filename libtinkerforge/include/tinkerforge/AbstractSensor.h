@@ -21,9 +21,15 @@
 #define ABSTRACTSENSOR_H_
 
 #include "ConnectionHandler.h"
+#include "DeviceLink.h"
+#include "SampleHistory.h"
+#include "SensorEvent.h"
+#include "Uid.h"
 
 #include <functional>
 #include <array>
+#include <chrono>
+#include <memory>
 
 struct Device_;
 
@@ -33,28 +39,74 @@ namespace tinkerforge {
   {
 
   public:
-      using ValueChangedCallback = std::function<void(const std::string type, int32_t value)>;
-
-      class UID : public std::array<char,3> {
-      public:
-          UID(const char* uid)
-          {
-              operator[](0) = uid[0];
-              operator[](1) = uid[1];
-              operator[](2) = uid[2];
-          }
-      };
-
-    AbstractSensor (const char* uid);
+      using SampleTime = tinkerforge::SampleTime;
+
+      using EventCallback             = SensorEventCallback;
+      using ValueChangedCallback      = std::function<void(const std::string type, int32_t value)>;
+      using TimedValueChangedCallback = std::function<void(const std::string& type, int32_t value, const SampleTime& time)>;
+      using ValueReadCallback         = std::function<void(int errorCode, int32_t value)>;
+
+      using UID = tinkerforge::UID;
+
+    AbstractSensor (const char* uid, ConnectionHandler& connection);
     virtual ~AbstractSensor () = default;
 
     const UID& getUid() const;
+    uint32_t numericUid() const;
+    virtual SensorKind kind() const = 0;
     virtual const std::string& type() const = 0;
 
-    virtual void registerCallback(ValueChangedCallback callback) = 0;
+    // the callback is called for every changed value from the callback thread
+    // of the device, the initial one possibly from the thread enabling the
+    // sensor, but never concurrently; delivering an event neither allocates
+    // nor copies the type string
+    void registerEventCallback(EventCallback callback);
+
+    // sets up the value callbacks of the device again, for a device that was
+    // restarted and lost them; the event callback stays registered
+    void rearm();
+
+    // keeps the last capacity reported values and aggregates them over the
+    // window, must be called before the event callback is registered
+    void enableHistory(size_t capacity, std::chrono::milliseconds window);
+
+    // nullptr unless the history is enabled, reading it doesn't lock
+    const SampleHistory* history() const;
+
+    // adapters for callbacks taking the type string
+    void registerCallback(ValueChangedCallback callback);
+    void registerTimedCallback(TimedValueChangedCallback callback);
+
+    // requests the current value without blocking, the callback is called from the
+    // callback thread of the device. returns false if the request could not be sent
+    virtual bool readValueAsync(ValueReadCallback callback) = 0;
+
+  protected:
+    // the receive time of the value callback that is currently called by the
+    // calling thread, the current time if called outside of a value callback
+    SampleTime sampleTime() const;
+
+    // starts the value callbacks of the device, called after the event
+    // callback is registered and on every rearm()
+    virtual void enableValueCallback() = 0;
+
+    // passes a changed value to the history and the event callback
+    void valueChanged(const SensorEvent& event) const;
+
+    template<typename F>
+    static bool requestValue(DeviceLink& device, ValueReadCallback callback)
+    {
+        return device.getAsync<F>([callback = std::move(callback)](int errorCode, typename F::Result value) {
+            callback(errorCode, value);
+        }) == E_OK;
+    }
 
   private:
-    UID m_uid;
+    UID           m_uid;
+    IPConnection* m_ipcon;
+    EventCallback m_callback;
+
+    std::unique_ptr<SampleHistory> m_history; // written by valueChanged()
   };
 
   bool operator==(const AbstractSensor& bricket, const AbstractSensor::UID& uid);
@@ -21,7 +21,7 @@
 #define BRICKLET_H_
 
 #include "ConnectionHandler.h"
-#include <array>
+#include "Uid.h"
 
 struct Device_;
 
@@ -31,15 +31,7 @@ namespace tinkerforge {
   {
 
   public:
-      class UID : public std::array<char,3> {
-      public:
-          UID(const char* uid)
-          {
-              operator[](0) = uid[0];
-              operator[](1) = uid[1];
-              operator[](2) = uid[2];
-          }
-      };
+      using UID = tinkerforge::UID;
 
     Bricklet (const char* uid);
     virtual ~Bricklet () = default;
@@ -20,31 +20,53 @@
 #ifndef BRICKLETAMBIENTLIGHT_H_
 #define BRICKLETAMBIENTLIGHT_H_
 
-#include "AbstractSensor.h"
+#include "Sensor.h"
 
 namespace tinkerforge {
 
-class BrickletAmbientLight: public AbstractSensor {
+  // Ambient Light Bricklet, API version 2.0.1
+  struct AmbientLightTraits
+  {
+      static constexpr uint16_t   DEVICE_IDENTIFIER = 21;
+      static constexpr SensorKind KIND = SensorKind::AmbientLight;
+      static constexpr uint16_t   SCALE = 10; // 1/10 lx
 
-public:
-    BrickletAmbientLight(const char* uid, ConnectionHandler &connection);
-    virtual ~BrickletAmbientLight();
+      static constexpr std::array<uint8_t, 3> apiVersion () { return {{2, 0, 1}}; }
 
-    static uint32_t DeviceIdentifier();
+      using GetIlluminance                    = codec::Function<1, uint16_t()>;
+      using GetAnalogValue                    = codec::Function<2, uint16_t()>;
+      using SetIlluminanceCallbackPeriod      = codec::Function<3, void(uint32_t)>;
+      using GetIlluminanceCallbackPeriod      = codec::Function<4, uint32_t()>;
+      using SetAnalogValueCallbackPeriod      = codec::Function<5, void(uint32_t)>;
+      using GetAnalogValueCallbackPeriod      = codec::Function<6, uint32_t()>;
+      using SetIlluminanceCallbackThreshold   = codec::Function<7, void(char, uint16_t, uint16_t), false>;
+      using GetIlluminanceCallbackThreshold   = codec::Function<8, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetAnalogValueCallbackThreshold   = codec::Function<9, void(char, uint16_t, uint16_t)>;
+      using GetAnalogValueCallbackThreshold   = codec::Function<10, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetDebouncePeriod                 = codec::Function<11, void(uint32_t)>;
+      using GetDebouncePeriod                 = codec::Function<12, uint32_t()>;
 
-    const std::string& type() const override;
+      using IlluminanceCallback = codec::Callback<13, uint16_t>;
+      using AnalogCallback      = codec::Callback<14, uint16_t>;
+      using IlluminanceReached  = codec::Callback<15, uint16_t>;
+      using AnalogReached       = codec::Callback<16, uint16_t>;
 
-    uint16_t getAmbientLight();
-    void registerCallback(ValueChangedCallback callback) override;
+      using Functions = codec::FunctionList<GetIlluminance, GetAnalogValue,
+                                            SetIlluminanceCallbackPeriod, GetIlluminanceCallbackPeriod,
+                                            SetAnalogValueCallbackPeriod, GetAnalogValueCallbackPeriod,
+                                            SetIlluminanceCallbackThreshold, GetIlluminanceCallbackThreshold,
+                                            SetAnalogValueCallbackThreshold, GetAnalogValueCallbackThreshold,
+                                            SetDebouncePeriod, GetDebouncePeriod, codec::GetIdentity>;
 
-private:
-    friend void ambientLightCallback(uint16_t, void*);
-    void valueUpdated(uint16_t newValue);
+      using Value         = uint16_t;
+      using GetValue      = GetIlluminance;
+      using ValueCallback = IlluminanceReached;
+      using Trigger       = ThresholdTrigger<SetIlluminanceCallbackThreshold, uint16_t, 10>;
+  };
 
-    Device                        m_bricklet;
-    uint8_t                       m_tolerance;
-    ValueChangedCallback          m_callback;
-};
+  using BrickletAmbientLight = Sensor<AmbientLightTraits>;
+
+  extern template class Sensor<AmbientLightTraits>;
 
 } /* namespace tinkerforge */
 
@@ -20,34 +20,56 @@
 #ifndef BRICKLETDISTANCEIR_H_
 #define BRICKLETDISTANCEIR_H_
 
-#include "AbstractSensor.h"
+#include "Sensor.h"
 
 namespace tinkerforge {
 
-class BrickletDistanceIr : public AbstractSensor
-{
-public:
-    BrickletDistanceIr (const char* uid, ConnectionHandler &connection);
-	virtual ~BrickletDistanceIr ();
+  // Distance IR Bricklet, API version 2.0.1
+  struct DistanceIrTraits
+  {
+      static constexpr uint16_t   DEVICE_IDENTIFIER = 25;
+      static constexpr SensorKind KIND = SensorKind::Distance;
+      static constexpr uint16_t   SCALE = 1; // mm
 
-    static uint32_t DeviceIdentifier();
-    const std::string& type() const override;
+      static constexpr std::array<uint8_t, 3> apiVersion () { return {{2, 0, 1}}; }
 
-    uint16_t getDistance ();
-    void registerCallback(ValueChangedCallback callback) override;
+      using GetDistance                     = codec::Function<1, uint16_t()>;
+      using GetAnalogValue                  = codec::Function<2, uint16_t()>;
+      using SetSamplingPoint                = codec::Function<3, void(uint8_t, uint16_t), false>;
+      using GetSamplingPoint                = codec::Function<4, uint16_t(uint8_t)>;
+      using SetDistanceCallbackPeriod       = codec::Function<5, void(uint32_t)>;
+      using GetDistanceCallbackPeriod       = codec::Function<6, uint32_t()>;
+      using SetAnalogValueCallbackPeriod    = codec::Function<7, void(uint32_t)>;
+      using GetAnalogValueCallbackPeriod    = codec::Function<8, uint32_t()>;
+      using SetDistanceCallbackThreshold    = codec::Function<9, void(char, uint16_t, uint16_t)>;
+      using GetDistanceCallbackThreshold    = codec::Function<10, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetAnalogValueCallbackThreshold = codec::Function<11, void(char, uint16_t, uint16_t)>;
+      using GetAnalogValueCallbackThreshold = codec::Function<12, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetDebouncePeriod               = codec::Function<13, void(uint32_t)>;
+      using GetDebouncePeriod               = codec::Function<14, uint32_t()>;
 
-private:
-    static constexpr auto CALLBACK_PERIOD {1000u}; // the minimal interval for value callbacks in ms
-    static constexpr auto MAXIMUM_VALUE   {650u};  // the maximum distance value for the sensor
+      using DistanceCallback = codec::Callback<15, uint16_t>;
+      using AnalogCallback   = codec::Callback<16, uint16_t>;
+      using DistanceReached  = codec::Callback<17, uint16_t>;
+      using AnalogReached    = codec::Callback<18, uint16_t>;
 
-    friend void distanceIrCallback(uint16_t, void*);
-    void valueUpdated(uint16_t newValue);
+      using Functions = codec::FunctionList<GetDistance, GetAnalogValue, SetSamplingPoint, GetSamplingPoint,
+                                            SetDistanceCallbackPeriod, GetDistanceCallbackPeriod,
+                                            SetAnalogValueCallbackPeriod, GetAnalogValueCallbackPeriod,
+                                            SetDistanceCallbackThreshold, GetDistanceCallbackThreshold,
+                                            SetAnalogValueCallbackThreshold, GetAnalogValueCallbackThreshold,
+                                            SetDebouncePeriod, GetDebouncePeriod, codec::GetIdentity>;
 
-    Device                  m_bricklet;
-    uint8_t                 m_tolerance;
-    ValueChangedCallback    m_callback;
-    uint16_t                m_lastValue{0};
-};
+      using Value         = uint16_t;
+      using GetValue      = GetDistance;
+      using ValueCallback = DistanceCallback;
+      // reported every second at most, the sensor isn't reliable above 650 mm
+      using Trigger       = PeriodTrigger<SetDistanceCallbackPeriod, 1000, uint16_t, 650>;
+  };
+
+  using BrickletDistanceIr = Sensor<DistanceIrTraits>;
+
+  extern template class Sensor<DistanceIrTraits>;
 
 } /* namespace tinkerforge */
 
@@ -20,30 +20,54 @@
 #ifndef BRICKLETHUMIDITY_H_
 #define BRICKLETHUMIDITY_H_
 
-#include "AbstractSensor.h"
+#include "Sensor.h"
 
 namespace tinkerforge {
 
-class BrickletHumidity: public tinkerforge::AbstractSensor {
+  // Humidity Bricklet, API version 2.0.1
+  struct HumidityTraits
+  {
+      static constexpr uint16_t   DEVICE_IDENTIFIER = 27;
+      static constexpr SensorKind KIND = SensorKind::Humidity;
+      static constexpr uint16_t   SCALE = 10; // 1/10 %RH
 
-public:
-    BrickletHumidity(const char* uid, ConnectionHandler &connection);
-	virtual ~BrickletHumidity();
+      static constexpr std::array<uint8_t, 3> apiVersion () { return {{2, 0, 1}}; }
 
-    static uint32_t DeviceIdentifier();
-    const std::string& type() const override;
+      using GetHumidity                       = codec::Function<1, uint16_t()>;
+      using GetAnalogValue                    = codec::Function<2, uint16_t()>;
+      using SetHumidityCallbackPeriod         = codec::Function<3, void(uint32_t)>;
+      using GetHumidityCallbackPeriod         = codec::Function<4, uint32_t()>;
+      using SetAnalogValueCallbackPeriod      = codec::Function<5, void(uint32_t)>;
+      using GetAnalogValueCallbackPeriod      = codec::Function<6, uint32_t()>;
+      using SetHumidityCallbackThreshold      = codec::Function<7, void(char, uint16_t, uint16_t), false>;
+      using GetHumidityCallbackThreshold      = codec::Function<8, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetAnalogValueCallbackThreshold   = codec::Function<9, void(char, uint16_t, uint16_t)>;
+      using GetAnalogValueCallbackThreshold   = codec::Function<10, std::tuple<char, uint16_t, uint16_t>()>;
+      using SetDebouncePeriod                 = codec::Function<11, void(uint32_t)>;
+      using GetDebouncePeriod                 = codec::Function<12, uint32_t()>;
 
-	uint16_t getHumidity();
-    void registerCallback(ValueChangedCallback callback) override;
+      using HumidityCallback = codec::Callback<13, uint16_t>;
+      using AnalogCallback   = codec::Callback<14, uint16_t>;
+      using HumidityReached  = codec::Callback<15, uint16_t>;
+      using AnalogReached    = codec::Callback<16, uint16_t>;
 
-private:
-    friend void humidityCallback(uint16_t, void*);
-    void humidityUpdated(uint16_t newHumidity);
+      using Functions = codec::FunctionList<GetHumidity, GetAnalogValue,
+                                            SetHumidityCallbackPeriod, GetHumidityCallbackPeriod,
+                                            SetAnalogValueCallbackPeriod, GetAnalogValueCallbackPeriod,
+                                            SetHumidityCallbackThreshold, GetHumidityCallbackThreshold,
+                                            SetAnalogValueCallbackThreshold, GetAnalogValueCallbackThreshold,
+                                            SetDebouncePeriod, GetDebouncePeriod, codec::GetIdentity>;
 
-    Device                        m_bricklet;
-    uint8_t                       m_tolerance;
-    ValueChangedCallback          m_callback;
-};
+      using Value         = uint16_t;
+      using GetValue      = GetHumidity;
+      using ValueCallback = HumidityReached;
+      using Trigger       = ThresholdTrigger<SetHumidityCallbackThreshold, uint16_t, 3>;
+  };
+
+  using BrickletHumidity = Sensor<HumidityTraits>;
+
+  extern template class Sensor<HumidityTraits>;
 
 } /* namespace tinkerforge */
+
 #endif /* BRICKLETHUMIDITY_H_ */
@@ -20,32 +20,47 @@
 #ifndef BRICKLETTEMPERATURE_H_
 #define BRICKLETTEMPERATURE_H_
 
-#include "AbstractSensor.h"
+#include "Sensor.h"
 
 namespace tinkerforge {
 
-  class BrickletTemperature: public AbstractSensor {
+  // Temperature Bricklet, API version 2.0.0
+  struct TemperatureTraits
+  {
+      static constexpr uint16_t   DEVICE_IDENTIFIER = 216;
+      static constexpr SensorKind KIND = SensorKind::Temperature;
+      static constexpr uint16_t   SCALE = 100; // 1/100 °C
 
-  public:
-    BrickletTemperature (const char* uid, ConnectionHandler &connection);
-    virtual ~BrickletTemperature ();
+      static constexpr std::array<uint8_t, 3> apiVersion () { return {{2, 0, 0}}; }
 
-    static uint32_t DeviceIdentifier();
+      using GetTemperature                  = codec::Function<1, int16_t()>;
+      using SetTemperatureCallbackPeriod    = codec::Function<2, void(uint32_t)>;
+      using GetTemperatureCallbackPeriod    = codec::Function<3, uint32_t()>;
+      using SetTemperatureCallbackThreshold = codec::Function<4, void(char, int16_t, int16_t), false>;
+      using GetTemperatureCallbackThreshold = codec::Function<5, std::tuple<char, int16_t, int16_t>()>;
+      using SetDebouncePeriod               = codec::Function<6, void(uint32_t)>;
+      using GetDebouncePeriod               = codec::Function<7, uint32_t()>;
+      using SetI2CMode                      = codec::Function<10, void(uint8_t), false>;
+      using GetI2CMode                      = codec::Function<11, uint8_t()>;
 
-    const std::string& type() const override;
+      using TemperatureCallback = codec::Callback<8, int16_t>;
+      using TemperatureReached  = codec::Callback<9, int16_t>;
 
-    int16_t getTemperature ();
-    void registerCallback(ValueChangedCallback callback) override;
+      using Functions = codec::FunctionList<GetTemperature, SetTemperatureCallbackPeriod, GetTemperatureCallbackPeriod,
+                                            SetTemperatureCallbackThreshold, GetTemperatureCallbackThreshold,
+                                            SetDebouncePeriod, GetDebouncePeriod, SetI2CMode, GetI2CMode,
+                                            codec::GetIdentity>;
 
-  private:
-    friend void temperatureCallback (int16_t temperature, void* object);
-    void temperatureUpdated(int16_t newTemperature);
-
-    Device                       m_temperature;
-    int8_t                       m_tolerance;
-    ValueChangedCallback         m_callback;
+      using Value         = int16_t;
+      using GetValue      = GetTemperature;
+      using ValueCallback = TemperatureReached;
+      using Trigger       = ThresholdTrigger<SetTemperatureCallbackThreshold, int16_t, 10>;
   };
 
+  using BrickletTemperature = Sensor<TemperatureTraits>;
+
+  extern template class Sensor<TemperatureTraits>;
+
 } /* namespace tinkerforge */
 
 #endif /* BRICKLETTEMPERATURE_H_ */
@@ -0,0 +1,231 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COALESCEDSETTER_H_
+#define COALESCEDSETTER_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "DeviceLink.h"
+
+namespace tinkerforge {
+
+  // Sends a setter of which only the newest arguments matter, like a callback
+  // threshold, without blocking the calling thread. At most one request is in
+  // flight, arguments set meanwhile replace each other and the newest of them
+  // is sent as soon as the request completes.
+  //
+  // Unconfirmed requests are sent as the function is declared, for setters
+  // without response expected that completes them right away. Confirmed
+  // requests complete with their response on the callback thread and are
+  // retried with the newest arguments if they timed out. If all request
+  // slots are taken the calling thread waits for one, like a setter does.
+  template<typename... Ts>
+  class CoalescedSetter
+  {
+  public:
+    static constexpr unsigned MAX_RETRIES = 3;
+
+    template<typename F>
+    CoalescedSetter (DeviceLink& device, F, bool confirmed)
+        : m_state(std::make_shared<State>(device, confirmed, &send<F>))
+    {
+        static_assert(!F::isGetter, "only functions without result can be coalesced");
+        static_assert(std::is_same<typename F::Arguments, Arguments>::value, "the arguments don't match the function");
+    }
+
+    CoalescedSetter (const CoalescedSetter&) = delete;
+    CoalescedSetter& operator= (const CoalescedSetter&) = delete;
+
+    // A confirmation can still arrive afterwards, but it doesn't use the
+    // device anymore.
+    ~CoalescedSetter ()
+    {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+
+        m_state->device = nullptr;
+        m_state->condition.wait(lock, [this] { return m_state->sending == 0; });
+    }
+
+    void set (const Ts&... arguments)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+
+            m_state->arguments = Arguments(arguments...);
+            m_state->retries = 0;
+            m_state->pending = true;
+
+            if (m_state->inFlight) { return; }
+
+            m_state->inFlight = true;
+        }
+
+        transmit(m_state);
+    }
+
+    // Sends the pending arguments, if they could not be sent because there
+    // was no connection.
+    void retry ()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+
+            if (!m_state->pending || m_state->inFlight) { return; }
+
+            m_state->inFlight = true;
+        }
+
+        transmit(m_state);
+    }
+
+  private:
+    using Arguments = std::tuple<Ts...>;
+
+    struct State;
+    using Send = int (*)(DeviceLink&, const Arguments&, const std::shared_ptr<State>&, bool async);
+
+    struct State
+    {
+        State (DeviceLink& device, bool confirmed, Send send)
+            : device(&device)
+            , confirmed(confirmed)
+            , send(send)
+        {
+
+        }
+
+        std::mutex              mutex;
+        std::condition_variable condition;
+        DeviceLink*             device;
+        const bool              confirmed;
+        const Send              send;
+        Arguments               arguments;
+        bool                    inFlight {false}; // a request is sent and not completed yet
+        bool                    pending  {false}; // the arguments are newer than the request in flight
+        unsigned                sending  {0};     // threads using the device outside of the lock
+        unsigned                retries  {0};
+    };
+
+    // Sends the pending arguments until a request is waiting for its
+    // confirmation or nothing is pending anymore. Arguments that could not
+    // be sent because there is no connection stay pending for retry().
+    static void transmit (const std::shared_ptr<State>& state)
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        while (state->pending && state->device != nullptr)
+        {
+            const Arguments arguments = state->arguments;
+            DeviceLink* device = state->device;
+
+            state->pending = false;
+            ++state->sending;
+            lock.unlock();
+
+            bool waiting = state->confirmed;
+            int ret = state->send(*device, arguments, state, waiting);
+
+            // all request slots are taken, wait for one like a setter does,
+            // the call returns with the confirmation
+            if (ret == E_WOULD_BLOCK)
+            {
+                waiting = false;
+                ret = state->send(*device, arguments, state, false);
+            }
+
+            lock.lock();
+            --state->sending;
+            state->condition.notify_all();
+
+            if (waiting && ret == E_OK) { return; }
+
+            if (ret == E_NOT_CONNECTED)
+            {
+                // newer arguments set meanwhile are kept, they replaced these
+                state->pending = true;
+                break;
+            }
+
+            if (state->confirmed) { retryTimedOut(*state, ret); }
+        }
+
+        state->inFlight = false;
+    }
+
+    // NOTE: assumes that the mutex of the state is locked
+    static void retryTimedOut (State& state, int errorCode)
+    {
+        if (errorCode == E_TIMEOUT && !state.pending && state.retries < MAX_RETRIES)
+        {
+            ++state.retries;
+            state.pending = true;
+        }
+    }
+
+    template<typename F>
+    static int send (DeviceLink& device, const Arguments& arguments, const std::shared_ptr<State>& state, bool async)
+    {
+        return sendArguments<F>(device, arguments, state, async, std::index_sequence_for<Ts...>());
+    }
+
+    template<typename F, std::size_t... I>
+    static int sendArguments (DeviceLink& device, const Arguments& arguments, const std::shared_ptr<State>& state,
+                              bool async, std::index_sequence<I...>)
+    {
+        if (!state->confirmed)
+        {
+            return device.call<F>(std::get<I>(arguments)...);
+        }
+
+        if (!async)
+        {
+            return device.callConfirmed<F>(std::get<I>(arguments)...);
+        }
+
+        // the callback keeps the state alive, because it can be called
+        // after the setter is gone
+        std::shared_ptr<State> callbackState = state;
+        return device.callAsync<F>([callbackState](int errorCode) { confirmed(callbackState, errorCode); },
+                                   std::get<I>(arguments)...);
+    }
+
+    // called from the callback thread of the device, which may send and wait
+    static void confirmed (const std::shared_ptr<State>& state, int errorCode)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            retryTimedOut(*state, errorCode);
+        }
+
+        transmit(state);
+    }
+
+    std::shared_ptr<State> m_state;
+  };
+
+} /* namespace tinkerforge */
+
+#endif /* COALESCEDSETTER_H_ */
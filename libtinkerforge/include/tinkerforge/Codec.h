@@ -0,0 +1,313 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "InplaceFunction.h"
+
+namespace tinkerforge {
+namespace codec {
+
+  // A function of a device is declared once by its id and signature, e.g.
+  //
+  //   using GetTemperature = Function<1, int16_t()>;
+  //   using SetTemperatureCallbackThreshold = Function<4, void(char, int16_t, int16_t)>;
+  //   using TemperatureReached = Callback<9, int16_t>;
+  //
+  // and the packet layout, its length and the little endian encoding and
+  // decoding of every value are generated from that at compile time. The
+  // offsets are constants, so encoding a request is a sequence of stores.
+
+  constexpr std::size_t HEADER_SIZE = 8;
+  constexpr std::size_t MAX_PACKET_SIZE = 80;
+
+  // Fixed length string, zero padded on the wire and not necessarily zero
+  // terminated.
+  template<std::size_t N>
+  struct String {
+      std::array<char, N> chars {};
+
+      String () = default;
+
+      String (const char* text)
+      {
+          for (std::size_t i = 0; i < N && text[i] != '\0'; ++i) { chars[i] = text[i]; }
+      }
+
+      String (const std::string& text)
+          : String(text.c_str())
+      {
+
+      }
+
+      std::string str () const
+      {
+          std::size_t length = 0;
+          while (length < N && chars[length] != '\0') { ++length; }
+          return std::string(chars.data(), length);
+      }
+  };
+
+  // Wire representation of a single value.
+  template<typename T, typename Enable = void>
+  struct Wire;
+
+  template<typename T>
+  struct Wire<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+  {
+      using Bits = typename std::make_unsigned<T>::type;
+
+      static constexpr std::size_t size = sizeof(T);
+
+      static void encode (uint8_t* buffer, T value)
+      {
+          const Bits bits = static_cast<Bits>(value);
+          for (std::size_t i = 0; i < size; ++i) { buffer[i] = static_cast<uint8_t>(bits >> (8 * i)); }
+      }
+
+      static T decode (const uint8_t* buffer)
+      {
+          Bits bits = 0;
+          for (std::size_t i = 0; i < size; ++i) { bits = static_cast<Bits>(bits | static_cast<Bits>(buffer[i]) << (8 * i)); }
+          return static_cast<T>(bits);
+      }
+  };
+
+  template<>
+  struct Wire<bool>
+  {
+      static constexpr std::size_t size = 1;
+
+      static void encode (uint8_t* buffer, bool value) { buffer[0] = value ? 1 : 0; }
+      static bool decode (const uint8_t* buffer) { return buffer[0] != 0; }
+  };
+
+  template<>
+  struct Wire<float>
+  {
+      static constexpr std::size_t size = 4;
+
+      static void encode (uint8_t* buffer, float value)
+      {
+          uint32_t bits;
+          std::memcpy(&bits, &value, sizeof(bits));
+          Wire<uint32_t>::encode(buffer, bits);
+      }
+
+      static float decode (const uint8_t* buffer)
+      {
+          const uint32_t bits = Wire<uint32_t>::decode(buffer);
+          float value;
+          std::memcpy(&value, &bits, sizeof(value));
+          return value;
+      }
+  };
+
+  template<typename T, std::size_t N>
+  struct Wire<std::array<T, N>>
+  {
+      static constexpr std::size_t size = N * Wire<T>::size;
+
+      static void encode (uint8_t* buffer, const std::array<T, N>& values)
+      {
+          for (std::size_t i = 0; i < N; ++i) { Wire<T>::encode(buffer + i * Wire<T>::size, values[i]); }
+      }
+
+      static std::array<T, N> decode (const uint8_t* buffer)
+      {
+          std::array<T, N> values;
+          for (std::size_t i = 0; i < N; ++i) { values[i] = Wire<T>::decode(buffer + i * Wire<T>::size); }
+          return values;
+      }
+  };
+
+  template<std::size_t N>
+  struct Wire<String<N>>
+  {
+      static constexpr std::size_t size = N;
+
+      static void encode (uint8_t* buffer, const String<N>& value) { std::memcpy(buffer, value.chars.data(), N); }
+
+      static String<N> decode (const uint8_t* buffer)
+      {
+          String<N> value;
+          std::memcpy(value.chars.data(), buffer, N);
+          return value;
+      }
+  };
+
+  // Size of a sequence of values and the offset of the I-th value.
+  template<typename... Ts>
+  struct Size : std::integral_constant<std::size_t, 0> {};
+
+  template<typename T, typename... Ts>
+  struct Size<T, Ts...> : std::integral_constant<std::size_t, Wire<T>::size + Size<Ts...>::value> {};
+
+  template<std::size_t I, typename... Ts>
+  struct Offset;
+
+  template<typename T, typename... Ts>
+  struct Offset<0, T, Ts...> : std::integral_constant<std::size_t, 0> {};
+
+  template<std::size_t I, typename T, typename... Ts>
+  struct Offset<I, T, Ts...> : std::integral_constant<std::size_t, Wire<T>::size + Offset<I - 1, Ts...>::value> {};
+
+  template<typename... Ts>
+  struct Values
+  {
+      using Tuple = std::tuple<Ts...>;
+
+      static constexpr std::size_t size = Size<Ts...>::value;
+
+      static void encode (uint8_t* payload, const Ts&... values)
+      {
+          encode(payload, std::index_sequence_for<Ts...>(), values...);
+      }
+
+      static Tuple decode (const uint8_t* payload)
+      {
+          return decode(payload, std::index_sequence_for<Ts...>());
+      }
+
+      template<typename Function>
+      static void apply (const uint8_t* payload, const Function& function)
+      {
+          apply(payload, function, std::index_sequence_for<Ts...>());
+      }
+
+  private:
+      template<std::size_t... I>
+      static void encode (uint8_t* payload, std::index_sequence<I...>, const Ts&... values)
+      {
+          using Expand = int[];
+          (void)Expand{0, (Wire<Ts>::encode(payload + Offset<I, Ts...>::value, values), 0)...};
+          (void)payload;
+      }
+
+      template<std::size_t... I>
+      static Tuple decode (const uint8_t* payload, std::index_sequence<I...>)
+      {
+          (void)payload;
+          return Tuple(Wire<Ts>::decode(payload + Offset<I, Ts...>::value)...);
+      }
+
+      template<typename Function, std::size_t... I>
+      static void apply (const uint8_t* payload, const Function& function, std::index_sequence<I...>)
+      {
+          (void)payload;
+          function(Wire<Ts>::decode(payload + Offset<I, Ts...>::value)...);
+      }
+  };
+
+  // Result of a function: nothing, a single value or a tuple of values.
+  template<typename R>
+  struct Returns
+  {
+      static constexpr std::size_t size = Wire<R>::size;
+
+      static R decode (const uint8_t* payload) { return Wire<R>::decode(payload); }
+  };
+
+  template<>
+  struct Returns<void>
+  {
+      static constexpr std::size_t size = 0;
+
+      static void decode (const uint8_t*) {}
+  };
+
+  template<typename... Ts>
+  struct Returns<std::tuple<Ts...>>
+  {
+      static constexpr std::size_t size = Values<Ts...>::size;
+
+      static std::tuple<Ts...> decode (const uint8_t* payload) { return Values<Ts...>::decode(payload); }
+  };
+
+  // Setters can be declared with ResponseExpected = false, like the C
+  // bindings do for setters that cannot fail. Getters always expect their
+  // response.
+  template<uint8_t Id, typename Signature, bool ResponseExpected = true>
+  struct Function;
+
+  template<uint8_t Id, typename R, typename... Parameters, bool ResponseExpected>
+  struct Function<Id, R(Parameters...), ResponseExpected>
+  {
+      using Result = R;
+      using Arguments = std::tuple<Parameters...>;
+
+      static constexpr uint8_t id = Id;
+      static constexpr bool isGetter = !std::is_void<R>::value;
+      static constexpr bool responseExpected = isGetter || ResponseExpected;
+      static constexpr uint8_t requestLength = HEADER_SIZE + Values<Parameters...>::size;
+      static constexpr uint8_t responseLength = HEADER_SIZE + Returns<R>::size;
+
+      static_assert(HEADER_SIZE + Values<Parameters...>::size <= MAX_PACKET_SIZE, "request does not fit into a packet");
+      static_assert(HEADER_SIZE + Returns<R>::size <= MAX_PACKET_SIZE, "response does not fit into a packet");
+
+      static void encode (uint8_t* packet, const Parameters&... parameters)
+      {
+          Values<Parameters...>::encode(packet + HEADER_SIZE, parameters...);
+      }
+
+      static R decode (const uint8_t* packet)
+      {
+          return Returns<R>::decode(packet + HEADER_SIZE);
+      }
+  };
+
+  template<uint8_t Id, typename... Ts>
+  struct Callback
+  {
+      using Function = InplaceFunction<void(Ts...)>;
+
+      static constexpr uint8_t id = Id;
+      static constexpr uint8_t length = HEADER_SIZE + Values<Ts...>::size;
+
+      static_assert(HEADER_SIZE + Values<Ts...>::size <= MAX_PACKET_SIZE, "callback does not fit into a packet");
+
+      static void dispatch (const uint8_t* packet, const Function& function)
+      {
+          Values<Ts...>::apply(packet + HEADER_SIZE, function);
+      }
+  };
+
+  // The functions a device understands, requests for any other function
+  // id are rejected with E_INVALID_PARAMETER like by the C bindings.
+  template<typename... Functions>
+  struct FunctionList {};
+
+  // Every device has the identity function.
+  using GetIdentity = Function<255, std::tuple<String<8>, String<8>, char, std::array<uint8_t, 3>,
+                                               std::array<uint8_t, 3>, uint16_t>()>;
+
+} /* namespace codec */
+} /* namespace tinkerforge */
+
+#endif /* CODEC_H_ */
@@ -20,7 +20,13 @@
 #ifndef CONNECTIONHANDLER_H_
 #define CONNECTIONHANDLER_H_
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <tinkerforge/bindings/ip_connection.h>
 
 #include "Bricklet.h"
@@ -30,22 +36,105 @@ namespace tinkerforge {
 class ConnectionHandler
 {
     using EnumerateCallback = std::function<void(const char*, uint16_t, uint8_t)>;
+    using ConnectionCallback = std::function<void(bool)>;
 
     typedef void (*EnumerateCallbackFunction)(const char*, const char*, char, uint8_t*, uint8_t*, uint16_t, uint8_t, void*);
 
 public:
+    struct Configuration {
+        std::string host    {"localhost"};
+        uint16_t    port    {4223};
+        bool        reactor {false}; // service the connection by the shared epoll event loop
+        bool        sendBatching {false}; // hold back setters without response for up to 20 ms to send them together
+        unsigned    callbackWorkers {1}; // threads dispatching device callbacks, sharded by uid, see setEnumerateCallback()
+        uint32_t    queueCapacity {0}; // queued device callbacks per thread, 0 for unbounded
+        uint8_t     queuePolicy {IPCON_QUEUE_POLICY_BLOCK}; // applied if queueCapacity is reached
+        bool        asyncConnect {false}; // (re)connect in the background instead of blocking the constructor
+        std::chrono::milliseconds reconnectDelay    {500};   // first delay between connection attempts
+        std::chrono::milliseconds reconnectMaxDelay {60000}; // the delay doubles up to this value
+        std::string captureFile; // record the brick daemon traffic to this file, if set
+        std::string replayFile;  // replay this capture by replay() instead of connecting
+        double      replaySpeed {1.0}; // pace of the replay, 0 for as fast as possible
+        bool        latencyTracking {false}; // record latency histograms per device and function id
+        std::chrono::seconds latencyReportInterval {0}; // log the slowest functions and the send statistics periodically, 0 to disable
+        size_t      latencyReportLimit {10}; // number of functions per report
+        bool        confirmThresholds {false}; // wait for the sensors to confirm re-armed thresholds and retry on failure
+        double      adaptiveDeadband {0.0}; // report values beyond this multiple of each sensor's learned noise, 0 for fixed tolerances
+    };
+
+    struct LatencyStatistics {
+        enum class Kind : uint8_t {
+            RoundTrip = IPCON_LATENCY_ROUND_TRIP, // request until response, counts timeouts too
+            QueueWait = IPCON_LATENCY_QUEUE_WAIT, // callback received until dispatched
+            Execution = IPCON_LATENCY_EXECUTION   // callback function runtime
+        };
+
+        std::string      uid;
+        uint8_t          functionId;
+        Kind             kind;
+        LatencyHistogram histogram;
+
+        std::chrono::microseconds percentile(double percentile) const;
+        std::chrono::microseconds mean() const;
+        std::chrono::microseconds max() const;
+        const char* kindName() const;
+    };
+
+    struct SendStatistics {
+        uint64_t requests;  // request packets written to the socket
+        uint64_t sendCalls; // send syscalls needed for them
+
+        double sendCallsPerRequest() const;
+    };
+
     ConnectionHandler(const char* host = "localhost", uint16_t port = 4223);
+    explicit ConnectionHandler(const Configuration& configuration);
     virtual ~ConnectionHandler();
     IPConnection* getConnection();
+    const Configuration& getConfiguration() const;
 
+    bool isConnected();
+    bool isReplay() const;
+    bool replay();
+
+    std::vector<LatencyStatistics> latencyStatistics();
+    void resetLatencyStatistics();
+    void logLatencyStatistics(size_t limit);
+
+    SendStatistics sendStatistics();
+    void logSendStatistics();
+
+    // The enumerate and connection callbacks are called by the first callback
+    // thread. With more than one callbackWorkers the callbacks of a device are
+    // called by the thread its uid is sharded to, concurrently with the
+    // enumerate callback and with the callbacks of other devices, so state
+    // they share has to be locked. A sensor can be destroyed in the enumerate
+    // callback, its destructor waits for a callback of it that is running.
     void setEnumerateCallback(EnumerateCallback callback);
+    void setConnectionCallback(ConnectionCallback callback);
     void joinThread();
 
 private:
     friend void enumerateCallback(const char*, const char*, char, uint8_t*, uint8_t*, uint16_t, uint8_t, void*);
+    friend void connectedCallback(uint8_t, void*);
+    friend void disconnectedCallback(uint8_t, void*);
+
+    void connectionChanged(bool connected, bool reconnect);
+    void connectLoop();
+    void reportLoop();
+
+    IPConnection       m_ipcon;
+    Configuration      m_configuration;
+    EnumerateCallback  m_callback;
+    ConnectionCallback m_connectionCallback;
 
-    IPConnection      m_ipcon;
-    EnumerateCallback m_callback;
+    std::mutex              m_mutex; // protects the callbacks and the connection state below
+    std::condition_variable m_condition;
+    std::thread             m_connectThread;
+    std::thread             m_reportThread;
+    bool                    m_connected {false};
+    bool                    m_connectRequested {false};
+    bool                    m_stopping {false};
 };
 
 } /* namespace tinkerforge */
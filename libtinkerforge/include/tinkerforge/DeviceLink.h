@@ -0,0 +1,168 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DEVICELINK_H_
+#define DEVICELINK_H_
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <tinkerforge/bindings/ip_connection.h>
+
+#include "Codec.h"
+#include "InplaceFunction.h"
+
+namespace tinkerforge {
+
+  // A device of the ip connection that is driven by the packet layouts of
+  // codec instead of a C binding. Only the functions given on construction
+  // can be called.
+  class DeviceLink
+  {
+  public:
+    // big enough for a std::function and a pointer
+    using RawCallback = InplaceFunction<void(const uint8_t* packet), 6 * sizeof(void*)>;
+    using RawResponse = InplaceFunction<void(int errorCode, const uint8_t* packet), 6 * sizeof(void*)>;
+
+    template<typename... Functions>
+    DeviceLink (const char* uid, IPConnection* ipcon, std::array<uint8_t, 3> apiVersion,
+                codec::FunctionList<Functions...>)
+        : DeviceLink(uid, ipcon, apiVersion)
+    {
+        using Expand = int[];
+        (void)Expand{0, (declareFunction(Functions::id, Functions::isGetter, Functions::responseExpected), 0)...};
+    }
+
+    DeviceLink (const DeviceLink&) = delete;
+    DeviceLink& operator= (const DeviceLink&) = delete;
+    ~DeviceLink ();
+
+    Device* getDevice ();
+
+    // Callbacks and responses of asynchronous requests that arrive afterwards
+    // are dropped, waits for the ones that are handled right now. Must not be
+    // called from a callback or response callback of this device.
+    void detach ();
+
+    // Calls a function without result, returns an E_* error code.
+    template<typename F, typename... Arguments>
+    int call (const Arguments&... arguments)
+    {
+        static_assert(!F::isGetter, "use get() for functions with a result");
+
+        uint8_t request[F::requestLength];
+        F::encode(request, arguments...);
+        return send(request, F::id, F::requestLength, nullptr, 0);
+    }
+
+    // Calls a function without result and waits for its response, also if
+    // the function is declared without one. Returns the error code the
+    // response carries.
+    template<typename F, typename... Arguments>
+    int callConfirmed (const Arguments&... arguments)
+    {
+        static_assert(!F::isGetter, "use get() for functions with a result");
+
+        uint8_t request[F::requestLength];
+        F::encode(request, arguments...);
+        return sendConfirmed(request, F::id, F::requestLength);
+    }
+
+    // Sends a function without result and without waiting for its response.
+    // The callback is called from the callback thread of the device with the
+    // error code the response carries, or with E_TIMEOUT if there was none.
+    // It is kept in place until then, see RawResponse for its size.
+    template<typename F, typename Callback, typename... Arguments>
+    int callAsync (Callback callback, const Arguments&... arguments)
+    {
+        static_assert(!F::isGetter, "use getAsync() for functions with a result");
+
+        uint8_t request[F::requestLength];
+        F::encode(request, arguments...);
+
+        return sendAsync(request, F::id, F::requestLength, [callback = std::move(callback)](int errorCode, const uint8_t*) {
+            callback(errorCode);
+        });
+    }
+
+    // Calls a function and stores its result, returns an E_* error code.
+    template<typename F, typename... Arguments>
+    int get (typename F::Result& result, const Arguments&... arguments)
+    {
+        static_assert(F::isGetter, "use call() for functions without result");
+
+        uint8_t request[F::requestLength];
+        uint8_t response[F::responseLength];
+        F::encode(request, arguments...);
+
+        const int ret = send(request, F::id, F::requestLength, response, F::responseLength);
+        if (ret == E_OK) { result = F::decode(response); }
+        return ret;
+    }
+
+    // Sends the request without waiting for the response. The callback is
+    // called from the callback thread of the device with the result, or with
+    // a default constructed result and the error code if the request failed.
+    template<typename F, typename Callback, typename... Arguments>
+    int getAsync (Callback callback, const Arguments&... arguments)
+    {
+        static_assert(F::isGetter, "only functions with a result can be called asynchronously");
+
+        uint8_t request[F::requestLength];
+        F::encode(request, arguments...);
+
+        return sendAsync(request, F::id, F::requestLength, [callback = std::move(callback)](int errorCode, const uint8_t* response) {
+            callback(errorCode, errorCode == E_OK ? F::decode(response) : typename F::Result{});
+        });
+    }
+
+    template<typename C>
+    void registerCallback (typename C::Function function)
+    {
+        registerRawCallback(C::id, [function](const uint8_t* packet) { C::dispatch(packet, function); });
+    }
+
+  private:
+    friend void completeResponse(void* completion, int errorCode, const uint8_t* packet);
+
+    DeviceLink (const char* uid, IPConnection* ipcon, std::array<uint8_t, 3> apiVersion);
+
+    void declareFunction (uint8_t functionId, bool isGetter, bool responseExpected);
+    int send (uint8_t* request, uint8_t functionId, uint8_t length, uint8_t* response, uint8_t responseLength);
+    int sendConfirmed (uint8_t* request, uint8_t functionId, uint8_t length);
+    int sendAsync (uint8_t* request, uint8_t functionId, uint8_t length, RawResponse response);
+    void registerRawCallback (uint8_t callbackId, RawCallback callback);
+
+    struct Completion;
+    struct Liveness; // shared with the asynchronous requests in flight
+
+    Device                    m_device;
+    std::shared_ptr<Liveness> m_liveness;
+
+    // A replaced callback might still be running on a callback thread, so
+    // all of them are kept until the device is destroyed.
+    std::mutex                                m_callbackMutex;
+    std::vector<std::unique_ptr<RawCallback>> m_callbacks;
+  };
+
+} /* namespace tinkerforge */
+
+#endif /* DEVICELINK_H_ */
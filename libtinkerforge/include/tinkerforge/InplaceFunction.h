@@ -0,0 +1,186 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INPLACEFUNCTION_H_
+#define INPLACEFUNCTION_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace tinkerforge {
+
+  // A std::function that keeps the callable in a fixed inline buffer instead
+  // of the heap. A callable that doesn't fit is rejected at compile time, so
+  // constructing, copying and calling it never allocates.
+  template<typename Signature, std::size_t Capacity = 4 * sizeof(void*)>
+  class InplaceFunction;
+
+  template<typename R, typename... Arguments, std::size_t Capacity>
+  class InplaceFunction<R(Arguments...), Capacity>
+  {
+  public:
+    InplaceFunction () noexcept = default;
+
+    InplaceFunction (std::nullptr_t) noexcept
+    {
+
+    }
+
+    template<typename F, typename = typename std::enable_if<
+                 !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+    InplaceFunction (F&& function)
+    {
+        using Callable = typename std::decay<F>::type;
+
+        static_assert(sizeof(Callable) <= Capacity, "the callable doesn't fit into the inline buffer");
+        static_assert(alignof(Callable) <= alignof(Storage), "the callable is over-aligned for the inline buffer");
+        static_assert(std::is_nothrow_move_constructible<Callable>::value, "the callable must be nothrow movable");
+
+        new (&m_storage) Callable(std::forward<F>(function));
+        m_operations = &Table<Callable>::operations;
+    }
+
+    InplaceFunction (const InplaceFunction& other)
+        : m_operations(other.m_operations)
+    {
+        if (m_operations) { m_operations->copy(&m_storage, &other.m_storage); }
+    }
+
+    InplaceFunction (InplaceFunction&& other) noexcept
+        : m_operations(other.m_operations)
+    {
+        if (m_operations) { m_operations->move(&m_storage, &other.m_storage); }
+        other.m_operations = nullptr;
+    }
+
+    ~InplaceFunction ()
+    {
+        reset();
+    }
+
+    InplaceFunction& operator= (const InplaceFunction& other)
+    {
+        if (this != &other)
+        {
+            reset();
+
+            if (other.m_operations)
+            {
+                other.m_operations->copy(&m_storage, &other.m_storage);
+                m_operations = other.m_operations;
+            }
+        }
+
+        return *this;
+    }
+
+    InplaceFunction& operator= (InplaceFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+
+            if (other.m_operations)
+            {
+                other.m_operations->move(&m_storage, &other.m_storage);
+                m_operations = other.m_operations;
+                other.m_operations = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    InplaceFunction& operator= (std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    explicit operator bool () const noexcept
+    {
+        return m_operations != nullptr;
+    }
+
+    R operator() (Arguments... arguments) const
+    {
+        return m_operations->invoke(const_cast<Storage*>(&m_storage), std::forward<Arguments>(arguments)...);
+    }
+
+  private:
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    struct Operations
+    {
+        R    (*invoke) (void* callable, Arguments&&... arguments);
+        void (*copy) (void* to, const void* from);
+        void (*move) (void* to, void* from); // destroys from
+        void (*destroy) (void* callable);
+    };
+
+    template<typename Callable>
+    struct Table
+    {
+        static R invoke (void* callable, Arguments&&... arguments)
+        {
+            return (*static_cast<Callable*>(callable))(std::forward<Arguments>(arguments)...);
+        }
+
+        static void copy (void* to, const void* from)
+        {
+            new (to) Callable(*static_cast<const Callable*>(from));
+        }
+
+        static void move (void* to, void* from)
+        {
+            new (to) Callable(std::move(*static_cast<Callable*>(from)));
+            static_cast<Callable*>(from)->~Callable();
+        }
+
+        static void destroy (void* callable)
+        {
+            static_cast<Callable*>(callable)->~Callable();
+        }
+
+        static constexpr Operations operations {&invoke, &copy, &move, &destroy};
+    };
+
+    void reset () noexcept
+    {
+        if (m_operations)
+        {
+            m_operations->destroy(&m_storage);
+            m_operations = nullptr;
+        }
+    }
+
+    Storage           m_storage;
+    const Operations* m_operations {nullptr};
+  };
+
+  template<typename R, typename... Arguments, std::size_t Capacity>
+  template<typename Callable>
+  constexpr typename InplaceFunction<R(Arguments...), Capacity>::Operations
+      InplaceFunction<R(Arguments...), Capacity>::Table<Callable>::operations;
+
+} /* namespace tinkerforge */
+
+#endif /* INPLACEFUNCTION_H_ */
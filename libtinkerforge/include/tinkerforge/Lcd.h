@@ -20,18 +20,15 @@
 #ifndef LCD_H_
 #define LCD_H_
 
-extern "C" {
-#include <tinkerforge/bindings/bricklet_lcd_20x4.h>
-}
-
 #include "Bricklet.h"
+#include "DeviceLink.h"
 
 #include <string>
 
 namespace tinkerforge {
 
 class Lcd: public tinkerforge::Bricklet {
-	LCD20x4*	m_lcd;
+	DeviceLink*	m_lcd;
 	char*		m_statusbar;
 	uint8_t		m_linewidth;
 public:
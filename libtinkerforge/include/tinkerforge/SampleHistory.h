@@ -0,0 +1,120 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SAMPLEHISTORY_H_
+#define SAMPLEHISTORY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "SensorEvent.h"
+
+namespace tinkerforge {
+
+  // The newest values of a sensor in a ring of fixed capacity, and their
+  // minimum, maximum and mean over a sliding window. One thread writes, any
+  // number of threads read. Readers never lock and never allocate, a sample
+  // that is overwritten while it is read is detected and left out.
+  //
+  // The aggregate covers the window that ends at the newest sample. The
+  // writer updates it with every sample in amortized constant time, so
+  // reading it is constant time as well.
+  class SampleHistory
+  {
+  public:
+    struct Sample {
+        SampleTime time;
+        int32_t    value;
+    };
+
+    struct Aggregate {
+        std::size_t count {0};
+        int32_t     minimum {0};
+        int32_t     maximum {0};
+        double      mean {0.0};
+        SampleTime  newest; // time of the newest sample, the window ends there
+    };
+
+    SampleHistory (std::size_t capacity, std::chrono::milliseconds window);
+
+    SampleHistory (const SampleHistory&) = delete;
+    SampleHistory& operator= (const SampleHistory&) = delete;
+
+    std::size_t capacity () const;
+    std::chrono::milliseconds window () const;
+
+    // only called by the writer
+    void push (const SampleTime& time, int32_t value);
+
+    // copies up to maximum samples, newest first, returns their number
+    std::size_t snapshot (Sample* samples, std::size_t maximum) const;
+
+    // returns false if there is no sample yet
+    bool aggregate (Aggregate& aggregate) const;
+
+  private:
+    // a sample n is complete while its sequence is 2n + 2
+    struct Slot {
+        std::atomic<uint64_t> sequence  {0};
+        std::atomic<int64_t>  received  {0}; // ns of the steady clock
+        std::atomic<int64_t>  wallClock {0}; // ns of the system clock
+        std::atomic<int32_t>  value     {0};
+    };
+
+    // indices of the samples that can still become the minimum or maximum
+    // of the window, see evict()
+    struct Candidates {
+        std::unique_ptr<uint64_t[]> indices;
+        uint64_t                    front {0};
+        uint64_t                    back  {0};
+    };
+
+    Slot& slot (uint64_t index) const;
+    int32_t writtenValue (uint64_t index) const;
+    void add (Candidates& candidates, uint64_t index, int32_t value, bool minimum);
+    void evict (uint64_t index);
+    void publishAggregate (const SampleTime& newest);
+
+    const std::size_t               m_capacity;
+    const std::chrono::nanoseconds  m_window;
+    std::unique_ptr<Slot[]>         m_slots;
+    std::atomic<uint64_t>           m_written {0}; // number of samples pushed
+
+    // window state of the writer
+    uint64_t   m_windowBegin {0}; // index of the oldest sample in the window
+    int64_t    m_windowSum {0};
+    Candidates m_minimum;
+    Candidates m_maximum;
+
+    // the aggregate published to readers, its sequence is odd while it changes
+    std::atomic<uint64_t> m_aggregateSequence {0};
+    std::atomic<uint64_t> m_aggregateCount {0};
+    std::atomic<int32_t>  m_aggregateMinimum {0};
+    std::atomic<int32_t>  m_aggregateMaximum {0};
+    std::atomic<int64_t>  m_aggregateSum {0};
+    std::atomic<int64_t>  m_aggregateReceived {0};
+    std::atomic<int64_t>  m_aggregateWallClock {0};
+  };
+
+} /* namespace tinkerforge */
+
+#endif /* SAMPLEHISTORY_H_ */
@@ -0,0 +1,315 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SENSOR_H_
+#define SENSOR_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <string>
+
+#include "AbstractSensor.h"
+#include "CoalescedSetter.h"
+
+namespace tinkerforge {
+
+  // Deadband learned from the noise of the values a sensor reports, it is
+  // kept at the configured multiple of their standard deviation. It starts
+  // at its minimum of 1 and grows with the noise, so quiet sensors keep
+  // reporting small changes and noisy ones stop reporting their noise.
+  class Deadband
+  {
+  public:
+    Deadband (double factor, int32_t maximum)
+        : m_factor(factor)
+        , m_maximum(maximum)
+    {
+
+    }
+
+    bool isAdaptive () const
+    {
+        return m_factor > 0.0;
+    }
+
+    int32_t width () const
+    {
+        return m_width;
+    }
+
+    // A device-side threshold only reports values that left the band, so
+    // the noise is estimated from how far they went past it: for noise of
+    // deviation s the mean excess over a band u is about s^2 / u.
+    void crossed (int32_t distance)
+    {
+        if (distance > m_width) { learn(static_cast<double>(m_width) * (distance - m_width)); }
+    }
+
+    // Periodic values show the noise in the difference of successive ones,
+    // its variance is twice the variance of the noise.
+    void sampled (int32_t difference)
+    {
+        learn(static_cast<double>(difference) * difference / 2);
+    }
+
+  private:
+    void learn (double variance)
+    {
+        m_variance += (variance - m_variance) / 8;
+        m_width = static_cast<int32_t>(std::min<double>(std::max(1.0, std::round(m_factor * std::sqrt(m_variance))), m_maximum));
+    }
+
+    const double  m_factor;
+    const int32_t m_maximum;
+    double        m_variance {0.0};
+    int32_t       m_width {1};
+  };
+
+  // The sensor reports a value when it leaves the threshold of +/- Tolerance
+  // around the last reported value, or of the adaptive deadband if that is
+  // configured. The threshold is re-armed with every value, see
+  // CoalescedSetter.
+  template<typename SetThreshold, typename Value, Value Tolerance>
+  class ThresholdTrigger
+  {
+  public:
+    static constexpr bool READ_INITIAL_VALUE = true; // nothing is reported until the threshold is armed once
+    static constexpr int32_t MAX_DEADBAND = 16 * Tolerance;
+
+    ThresholdTrigger (DeviceLink& device, const ConnectionHandler::Configuration& configuration)
+        : m_threshold(device, SetThreshold(), configuration.confirmThresholds)
+        , m_deadband(configuration.adaptiveDeadband, MAX_DEADBAND)
+    {
+
+    }
+
+    void enable (DeviceLink&)
+    {
+        // a threshold that was set while the connection was down
+        m_threshold.retry();
+    }
+
+    // returns false if the value is not to be reported. learn is false for
+    // values that were read instead of reported by the threshold, they say
+    // nothing about the noise
+    bool update (Value& value, bool learn)
+    {
+        using Limits = std::numeric_limits<Value>;
+
+        const int32_t current = value;
+        int32_t tolerance = Tolerance;
+
+        if (m_deadband.isAdaptive())
+        {
+            if (m_hasValue && learn) { m_deadband.crossed(std::abs(current - m_lastValue)); }
+            tolerance = m_deadband.width();
+        }
+        m_lastValue = current;
+        m_hasValue = true;
+
+        m_threshold.set('o',
+                        static_cast<Value>(std::max<int32_t>(current - tolerance, Limits::min())),
+                        static_cast<Value>(std::min<int32_t>(current + tolerance, Limits::max())));
+        return true;
+    }
+
+  private:
+    CoalescedSetter<char, Value, Value> m_threshold;
+    Deadband                            m_deadband;
+    int32_t                             m_lastValue {0};
+    bool                                m_hasValue {false};
+  };
+
+  // The sensor reports its value every Period ms. Values are limited to
+  // Maximum and only reported if they changed, or if they left the adaptive
+  // deadband around the last reported value if that is configured.
+  template<typename SetPeriod, uint32_t Period, typename Value, Value Maximum>
+  class PeriodTrigger
+  {
+  public:
+    static constexpr bool READ_INITIAL_VALUE = false;
+    static constexpr int32_t MAX_DEADBAND = Maximum / 16;
+
+    PeriodTrigger (DeviceLink&, const ConnectionHandler::Configuration& configuration)
+        : m_deadband(configuration.adaptiveDeadband, MAX_DEADBAND)
+    {
+
+    }
+
+    void enable (DeviceLink& device)
+    {
+        // all request slots are taken, wait for one like a setter does
+        if (device.callAsync<SetPeriod>([](int) {}, Period) == E_WOULD_BLOCK) { device.call<SetPeriod>(Period); }
+    }
+
+    bool update (Value& value, bool learn)
+    {
+        value = std::min(value, Maximum);
+
+        if (m_deadband.isAdaptive())
+        {
+            if (m_hasSample && learn) { m_deadband.sampled(static_cast<int32_t>(value) - m_lastSample); }
+            m_lastSample = value;
+            m_hasSample = true;
+
+            if (std::abs(static_cast<int32_t>(value) - m_lastValue) <= m_deadband.width()) { return false; }
+        }
+        else if (value == m_lastValue) { return false; }
+
+        m_lastValue = value;
+
+        return true;
+    }
+
+  private:
+    Deadband m_deadband;
+    Value    m_lastValue {0};
+    Value    m_lastSample {0};
+    bool     m_hasSample {false};
+  };
+
+  // A sensor bricklet generated from a traits struct:
+  //
+  //   struct Traits {
+  //       static constexpr uint16_t   DEVICE_IDENTIFIER = ...;
+  //       static constexpr SensorKind KIND = ...;
+  //       static constexpr uint16_t   SCALE = ...;   // see SensorEvent
+  //       static constexpr std::array<uint8_t, 3> apiVersion() { ... }
+  //
+  //       using Value         = ...;                 // as read from the device
+  //       using GetValue      = codec::Function<...>;
+  //       using ValueCallback = codec::Callback<...>;
+  //       using Trigger       = ThresholdTrigger<...> or PeriodTrigger<...>;
+  //       using Functions     = codec::FunctionList<...>;
+  //   };
+  //
+  // Everything on the path from a value callback to the event callback is
+  // resolved at compile time.
+  //
+  // Enabling the sensor only sends its requests, so many sensors can be
+  // brought up at once without waiting for a round trip each. Values are
+  // reported from the callback thread of the device, only an initial value
+  // read while all request slots were taken is reported from the enabling
+  // thread.
+  template<typename Traits>
+  class Sensor final : public AbstractSensor
+  {
+  public:
+    using Value = typename Traits::Value;
+
+    Sensor (const char* uid, ConnectionHandler& connection)
+        : AbstractSensor(uid, connection)
+        , m_device(uid, connection.getConnection(), Traits::apiVersion(), typename Traits::Functions())
+        , m_trigger(m_device, connection.getConfiguration())
+    {
+        // registered once, enabling the sensor again only sets up the device
+        m_device.registerCallback<typename Traits::ValueCallback>([this](Value value) {
+            valueUpdated(value, sampleTime(), true);
+        });
+    }
+
+    ~Sensor ()
+    {
+        // the initial value might still arrive and needs the trigger
+        m_device.detach();
+    }
+
+    static uint32_t DeviceIdentifier ()
+    {
+        return Traits::DEVICE_IDENTIFIER;
+    }
+
+    SensorKind kind () const override
+    {
+        return Traits::KIND;
+    }
+
+    const std::string& type () const override
+    {
+        static const std::string type(sensorKindName(Traits::KIND));
+        return type;
+    }
+
+    Value getValue ()
+    {
+        Value value {};
+        m_device.get<typename Traits::GetValue>(value);
+        return value;
+    }
+
+    bool readValueAsync (ValueReadCallback callback) override
+    {
+        return requestValue<typename Traits::GetValue>(m_device, std::move(callback));
+    }
+
+  private:
+    using Trigger = typename Traits::Trigger;
+
+    void enableValueCallback () override
+    {
+        m_trigger.enable(m_device);
+
+        if (Trigger::READ_INITIAL_VALUE) { readInitialValue(); }
+    }
+
+    // Called from the enabling thread and from the callback thread that
+    // completes the request, neither of them services the connection, so
+    // both can wait. A timed out read is retried a few times from its
+    // completion only, a sensor that vanished must not keep a request slot
+    // or the enabling thread busy. Otherwise a failed read reports nothing,
+    // the sensor is read again when it is rearmed. The value read is no
+    // crossing of the threshold, so the deadband doesn't learn from it.
+    void readInitialValue (unsigned retries = 0)
+    {
+        const int ret = m_device.getAsync<typename Traits::GetValue>([this, retries](int errorCode, Value value) {
+            if (errorCode == E_OK) { valueUpdated(value, SampleTime::now(), false); }
+            else if (errorCode == E_TIMEOUT && retries < CoalescedSetter<>::MAX_RETRIES) { readInitialValue(retries + 1); }
+        });
+
+        if (ret != E_WOULD_BLOCK) { return; }
+
+        // all request slots are taken, wait for one like a getter does
+        Value value {};
+
+        if (m_device.get<typename Traits::GetValue>(value) == E_OK) { valueUpdated(value, SampleTime::now(), false); }
+    }
+
+    void valueUpdated (Value value, const SampleTime& time, bool learn)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_trigger.update(value, learn))
+        {
+            valueChanged(SensorEvent{Traits::KIND, numericUid(), value, Traits::SCALE, time});
+        }
+    }
+
+    DeviceLink m_device;
+    Trigger    m_trigger;
+    std::mutex m_mutex; // the initial value can be read on another thread than the callbacks
+  };
+
+} /* namespace tinkerforge */
+
+#endif /* SENSOR_H_ */
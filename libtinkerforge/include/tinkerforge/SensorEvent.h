@@ -0,0 +1,71 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SENSOREVENT_H_
+#define SENSOREVENT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "InplaceFunction.h"
+
+namespace tinkerforge {
+
+  // time a value was read from the brick daemon connection
+  struct SampleTime {
+      std::chrono::steady_clock::time_point received;  // for measuring delays
+      std::chrono::system_clock::time_point wallClock; // for publishing
+
+      static SampleTime now();
+  };
+
+  enum class SensorKind : uint8_t {
+      Temperature,
+      Humidity,
+      AmbientLight,
+      Distance
+  };
+
+  constexpr std::size_t SENSOR_KIND_COUNT = 4;
+
+  // e.g. "ambient-light", the same as the type() of the sensor
+  const char* sensorKindName(SensorKind kind);
+
+  // unit of the scaled value, e.g. "°C"
+  const char* sensorKindUnit(SensorKind kind);
+
+  // A value of a sensor. It is small and trivially copyable, so it is passed
+  // around without touching the heap.
+  struct SensorEvent {
+      SensorKind kind;
+      uint32_t   uid;   // numeric uid, see ipcon_uid_from_string
+      int32_t    value; // as read from the sensor, in 1/scale of the unit
+      uint16_t   scale; // e.g. 100 for a temperature in 1/100 °C
+      SampleTime time;
+
+      double scaledValue() const { return static_cast<double>(value) / scale; }
+  };
+
+  // big enough for a std::function and a pointer
+  using SensorEventCallback = InplaceFunction<void(const SensorEvent&), 6 * sizeof(void*)>;
+
+} /* namespace tinkerforge */
+
+#endif /* SENSOREVENT_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Libtinkerforge - Object oriented library for tinkerforge c binings
+ * Copyright (C) 2013 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UID_H_
+#define UID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <tinkerforge/bindings/ip_connection.h>
+
+namespace tinkerforge {
+
+  // The 32 bit id of a device as it is used on the wire, decoded once from
+  // the Base58 string. Comparing and hashing it is a single integer operation.
+  class UID
+  {
+  public:
+    UID (const char* uid)
+        : m_value(ipcon_uid_from_string(uid))
+    {
+
+    }
+
+    explicit UID (uint32_t value)
+        : m_value(value)
+    {
+
+    }
+
+    uint32_t value () const { return m_value; }
+
+    // the Base58 string, as the devices are enumerated with
+    std::string toString () const
+    {
+        char uid[8];
+        ipcon_uid_to_string(m_value, uid);
+        return uid;
+    }
+
+    bool operator== (const UID& other) const { return m_value == other.m_value; }
+    bool operator!= (const UID& other) const { return m_value != other.m_value; }
+
+  private:
+    uint32_t m_value;
+  };
+
+} /* namespace tinkerforge */
+
+namespace std {
+
+  template<>
+  struct hash<tinkerforge::UID>
+  {
+    size_t operator() (const tinkerforge::UID& uid) const noexcept
+    {
+        return uid.value();
+    }
+  };
+
+} /* namespace std */
+
+#endif /* UID_H_ */
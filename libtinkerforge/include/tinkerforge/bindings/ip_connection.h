@@ -52,7 +52,9 @@ enum {
 	E_INVALID_PARAMETER = -9, // error response from device
 	E_NOT_SUPPORTED = -10, // error response from device
 	E_UNKNOWN_ERROR_CODE = -11, // error response from device
-	E_STREAM_OUT_OF_SYNC = -12
+	E_STREAM_OUT_OF_SYNC = -12,
+	E_WOULD_BLOCK = -13, // all sequence numbers are in flight
+	E_CAPTURE_FILE = -14 // capture file could not be opened, written or parsed
 };
 
 #ifdef IPCON_EXPOSE_MILLISLEEP
@@ -114,24 +116,57 @@ typedef struct {
 } Thread;
 
 typedef struct {
-	Mutex mutex;
-	int used;
-	int allocated;
-	uint32_t *keys;
-	void **values;
+	uint32_t key;
+	uint32_t state; // 0 = empty, 1 = used (removed if value is NULL)
+	void *value;
+} TableSlot;
+
+typedef struct {
+	uint32_t mask; // slot count - 1, slot count is a power of two
+	TableSlot slots[1];
+} TableSlots;
+
+typedef struct {
+	Mutex mutex; // serializes writers, readers don't lock
+	TableSlots *slots;
+	uint32_t used; // slots in state used, protected by mutex
+	uint32_t count; // slots with a value, protected by mutex
+	uint32_t epoch;
+	uint32_t readers[2]; // readers per epoch parity
 } Table;
 
 typedef struct _QueueItem {
 	struct _QueueItem *next;
 	int kind;
 	void *data;
+	uint32_t ticket; // ring write index at the time the item was put
+	uint64_t timestamp; // in usec, only for packets
 } QueueItem;
 
+typedef struct _Packet Packet;
+
 typedef struct {
-	Mutex mutex;
-	Semaphore semaphore;
+	Mutex mutex; // protects the item list
+	Semaphore semaphore; // counts ring packets and list items
 	QueueItem *head;
 	QueueItem *tail;
+	uint32_t item_count; // number of list items, written under mutex
+	uint32_t overflow_count; // number of packets in the item list
+	Packet *ring; // single-producer/single-consumer ring of packets
+	uint64_t *ring_timestamps; // in usec, parallel to ring
+	uint32_t ring_length; // power of two
+	uint32_t ring_read; // written by the consumer, and by the producer to drop packets
+	uint32_t ring_write; // only written by the producer
+	uint32_t capacity; // maximum number of queued packets, 0 for unbounded
+	uint8_t policy; // what to do if capacity is reached, IPCON_QUEUE_POLICY_*
+	uint64_t *latest; // (uid, function_id, ring index) of the latest packet per key
+	uint64_t *delivered; // same for packets delivered early, only used by the consumer
+	bool *producer_running; // blocking stops if this becomes false
+	uint32_t producer_waiting; // set while the producer waits for space
+	Event space_event; // set by the consumer if the producer waits for space
+	uint32_t high_water; // only written by the producer
+	uint64_t overflows; // only written by the producer
+	uint64_t drops; // packets dropped due to the capacity limit
 } Queue;
 
 #if defined _MSC_VER || defined __BORLANDC__
@@ -158,11 +193,11 @@ typedef struct {
 	uint8_t error_code_and_future_use;
 } ATTRIBUTE_PACKED PacketHeader;
 
-typedef struct {
+struct _Packet {
 	PacketHeader header;
 	uint8_t payload[64];
 	uint8_t optional_data[8];
-} ATTRIBUTE_PACKED Packet;
+} ATTRIBUTE_PACKED;
 
 #if defined _MSC_VER || defined __BORLANDC__
 	#pragma pack(pop)
@@ -179,6 +214,8 @@ typedef struct _DevicePrivate DevicePrivate;
 #ifdef IPCON_EXPOSE_INTERNALS
 
 typedef struct _CallbackContext CallbackContext;
+typedef struct _Capture Capture;
+typedef struct _Replay Replay;
 typedef struct _HighLevelCallback HighLevelCallback;
 
 /**
@@ -205,9 +242,34 @@ typedef void (*ConnectedCallbackFunction)(uint8_t connect_reason,
 typedef void (*DisconnectedCallbackFunction)(uint8_t disconnect_reason,
                                              void *user_data);
 
+#define IPCON_LATENCY_HISTOGRAM_BUCKETS 240
+
+/**
+ * \ingroup IPConnection
+ *
+ * Latencies in microseconds as returned by ipcon_get_latency_histograms.
+ * Below 16us every bucket covers one microsecond, above that every power of
+ * two is split into 8 buckets, so a bucket is at most 12.5% wide. Use
+ * ipcon_get_latency_bucket_limit to get the upper limit of a bucket.
+ */
+typedef struct {
+	uint64_t count;
+	uint64_t sum; // in usec
+	uint32_t max; // in usec
+	uint32_t timeouts; // requests that ran into E_TIMEOUT, not part of count
+	uint32_t buckets[IPCON_LATENCY_HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+typedef void (*LatencyHistogramFunction)(const char *uid,
+                                         uint8_t function_id,
+                                         uint8_t kind,
+                                         const LatencyHistogram *histogram,
+                                         void *user_data);
+
 #ifdef IPCON_EXPOSE_INTERNALS
 
 typedef void (*CallbackWrapperFunction)(DevicePrivate *device_p, Packet *packet);
+typedef void (*ResponseWrapperFunction)(int error_code, Packet *response, void *function, void *user_data);
 
 #endif
 
@@ -226,7 +288,7 @@ struct _Device {
  * \internal
  */
 struct _DevicePrivate {
-	int ref_count;
+	uint32_t ref_count; // atomic
 
 	uint32_t uid; // always host endian
 
@@ -234,13 +296,6 @@ struct _DevicePrivate {
 
 	uint8_t api_version[3];
 
-	Mutex request_mutex;
-
-	uint8_t expected_response_function_id; // protected by request_mutex
-	uint8_t expected_response_sequence_number; // protected by request_mutex
-	Mutex response_mutex;
-	Packet response_packet; // protected by response_mutex
-	Event response_event;
 	int response_expected[DEVICE_NUM_FUNCTION_IDS];
 
 	Mutex stream_mutex;
@@ -249,6 +304,10 @@ struct _DevicePrivate {
 	void *registered_callback_user_data[DEVICE_NUM_FUNCTION_IDS * 2];
 	CallbackWrapperFunction callback_wrappers[DEVICE_NUM_FUNCTION_IDS];
 	HighLevelCallback high_level_callbacks[DEVICE_NUM_FUNCTION_IDS];
+	uint32_t callbacks_stopped; // atomic, see device_stop_callbacks
+	uint32_t dispatch_count; // callbacks that are called right now, atomic
+
+	LatencyHistogram **latency_histograms; // DEVICE_NUM_FUNCTION_IDS * IPCON_NUM_LATENCY_KINDS, allocated on first use, atomic
 };
 
 /**
@@ -273,6 +332,17 @@ void device_create(Device *device, const char *uid,
  */
 void device_release(DevicePrivate *device_p);
 
+/**
+ * \internal
+ *
+ * Stops calling the callbacks of the device and waits for the ones that are
+ * called right now to return, so the callback functions and their user data
+ * can be freed afterwards. The callbacks of a device are called by one of the
+ * callback threads, but the device can be destroyed from any other one. Must
+ * not be called from a callback of the device itself.
+ */
+void device_stop_callbacks(DevicePrivate *device_p);
+
 /**
  * \internal
  */
@@ -306,6 +376,18 @@ int device_get_api_version(DevicePrivate *device_p, uint8_t ret_api_version[3]);
  */
 int device_send_request(DevicePrivate *device_p, Packet *request, Packet *response);
 
+/**
+ * \internal
+ *
+ * Sends the request without waiting for the response. The response wrapper
+ * is called from the callback thread of the device once the response
+ * arrived, or with E_TIMEOUT and a NULL response if no response arrived in
+ * time. Returns E_WOULD_BLOCK if all sequence numbers are in flight.
+ */
+int device_send_request_async(DevicePrivate *device_p, Packet *request,
+                              ResponseWrapperFunction response_wrapper,
+                              void *response_function, void *response_user_data);
+
 #endif // IPCON_EXPOSE_INTERNALS
 
 /**
@@ -362,6 +444,29 @@ enum {
 	IPCON_CONNECTION_STATE_PENDING = 2 // auto-reconnect in progress
 };
 
+/**
+ * \ingroup IPConnection
+ *
+ * Possible values for the policy parameter of ipcon_set_callback_queue_capacity.
+ */
+enum {
+	IPCON_QUEUE_POLICY_BLOCK = 0,
+	IPCON_QUEUE_POLICY_DROP_OLDEST = 1,
+	IPCON_QUEUE_POLICY_DROP_NEWEST = 2,
+	IPCON_QUEUE_POLICY_KEEP_LATEST = 3
+};
+
+/**
+ * \ingroup IPConnection
+ *
+ * Possible values for the kind parameter of LatencyHistogramFunction.
+ */
+enum {
+	IPCON_LATENCY_ROUND_TRIP = 0, // from sending a request to receiving its response
+	IPCON_LATENCY_QUEUE_WAIT = 1, // from receiving a callback to calling its function
+	IPCON_LATENCY_EXECUTION = 2 // from calling a callback function to its return
+};
+
 /**
  * \internal
  */
@@ -373,12 +478,39 @@ struct _IPConnection {
 
 #define IPCON_NUM_CALLBACK_IDS 256
 #define IPCON_MAX_SECRET_LENGTH 64
+#define IPCON_NUM_SEQUENCE_NUMBERS 16
+#define IPCON_SEND_BUFFER_SIZE 1400 // fits into one TCP segment on Ethernet
+#define IPCON_RECEIVE_BUFFER_SIZE 8192
+#define IPCON_MAX_CALLBACK_WORKERS 16
+#define IPCON_MAX_CALLBACK_QUEUE_CAPACITY 65536
+#define IPCON_MAX_COMPLETION_SPIN 200 // in usec
+#define IPCON_NUM_LATENCY_KINDS 3
 
 /**
  * \internal
  */
 typedef Device BrickDaemon;
 
+/**
+ * \internal
+ */
+typedef struct {
+	bool in_use;
+	bool done;
+	uint32_t uid; // always host endian
+	uint8_t function_id;
+	Event event;
+	uint32_t completion; // futex word, used instead of event in low latency mode
+	bool low_latency;
+	Packet response;
+	ResponseWrapperFunction response_wrapper; // NULL for blocking requests
+	void *response_function;
+	void *response_user_data;
+	uint64_t deadline; // in msec
+	uint64_t send_timestamp; // in usec, 0 if latency tracking is disabled
+	uint32_t serial; // tells the requests apart that reuse the sequence number
+} PendingRequest;
+
 /**
  * \internal
  */
@@ -399,12 +531,24 @@ struct _IPConnectionPrivate {
 	Mutex sequence_number_mutex;
 	uint8_t next_sequence_number; // protected by sequence_number_mutex
 
+	Mutex pending_request_mutex;
+	Semaphore pending_request_semaphore; // counts unused pending requests
+	PendingRequest pending_requests[IPCON_NUM_SEQUENCE_NUMBERS]; // indexed by sequence number, protected by pending_request_mutex
+	uint32_t pending_async_request_count; // protected by pending_request_mutex, read atomic
+	uint32_t next_request_serial; // protected by pending_request_mutex
+	bool low_latency; // protected by pending_request_mutex
+	uint32_t completion_wait_average; // in usec, atomic
+	uint32_t completion_spin; // in usec, atomic
+	uint32_t completion_spin_max; // in usec, 0 on single CPU systems
+
 	Mutex authentication_mutex; // protects authentication handshake
 	uint32_t next_authentication_nonce; // protected by authentication_mutex
 
-	Mutex devices_ref_mutex; // protects DevicePrivate.ref_count
 	Table devices;
 
+	bool latency_tracking; // read without locking
+	Mutex latency_mutex; // serializes the allocation of latency histograms
+
 	void *registered_callbacks[IPCON_NUM_CALLBACK_IDS];
 	void *registered_callback_user_data[IPCON_NUM_CALLBACK_IDS];
 
@@ -412,12 +556,38 @@ struct _IPConnectionPrivate {
 	Socket *socket; // protected by socket_mutex
 	uint64_t socket_id; // protected by socket_mutex
 
+	Mutex send_mutex; // never held while sending
+	uint8_t send_buffer[IPCON_SEND_BUFFER_SIZE]; // protected by send_mutex
+	int send_buffer_length; // protected by send_mutex
+	bool send_flushing; // protected by send_mutex
+	Event send_flushed_event; // reset while a thread is flushing
+	uint32_t send_round; // protected by send_mutex, counts the send buffer contents taken for sending
+	uint64_t send_round_failures; // protected by send_mutex, bit n is set if round send_round - n failed
+	bool send_batching; // protected by send_mutex
+	uint64_t send_packet_count; // atomic
+	uint64_t send_call_count; // atomic
+
 	bool receive_flag;
 	Thread receive_thread; // protected by socket_mutex
+	uint8_t receive_buffer[IPCON_RECEIVE_BUFFER_SIZE]; // only accessed by the receive thread or reactor
+	int receive_buffer_start; // offset of the first unparsed byte, only accessed by the receive thread or reactor
+	int receive_buffer_end; // offset after the last received byte, only accessed by the receive thread or reactor
+
+	bool reactor; // protected by socket_mutex
+	int reactor_slot; // protected by socket_mutex
 
 	CallbackContext *callback;
+	int callback_worker_count; // used for the next callback context, protected by socket_mutex
+	uint32_t callback_queue_capacity; // used for the next callback context, protected by socket_mutex
+	uint8_t callback_queue_policy; // used for the next callback context, protected by socket_mutex
+
+	Mutex capture_mutex;
+	Capture *capture; // protected by capture_mutex
+	Replay *replay; // protected by socket_mutex
 
 	bool disconnect_probe_flag;
+	bool disconnect_probe_stop; // protected by socket_mutex, checked after disconnect_probe_event was set
+	uint64_t disconnect_probe_time; // in usec, only accessed by the disconnect probe thread or reactor
 	Thread disconnect_probe_thread; // protected by socket_mutex
 	Event disconnect_probe_event;
 
@@ -531,6 +701,338 @@ void ipcon_set_timeout(IPConnection *ipcon, uint32_t timeout);
  */
 uint32_t ipcon_get_timeout(IPConnection *ipcon);
 
+/**
+ * \ingroup IPConnection
+ *
+ * Enables or disables the reactor mode. In reactor mode the socket and the
+ * disconnect probe of the IP Connection are serviced by a single epoll event
+ * loop thread that is shared by all IP Connections in reactor mode, instead
+ * of a receive thread and a disconnect probe thread per IP Connection. The
+ * callbacks are still dispatched by a callback thread per IP Connection,
+ * because they are allowed to call blocking getters.
+ *
+ * The mode can only be changed while the IP Connection is disconnected and
+ * takes effect with the next call to ipcon_connect. Returns E_NOT_SUPPORTED
+ * on platforms without epoll.
+ *
+ * Default value is *false*.
+ */
+int ipcon_set_reactor(IPConnection *ipcon, bool reactor);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns *true* if the reactor mode is enabled, *false* otherwise.
+ */
+bool ipcon_get_reactor(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Enables or disables send batching. Requests are always coalesced while
+ * another thread is sending, so that requests issued concurrently are written
+ * to the socket in a single send call. With send batching enabled requests
+ * that don't expect a response are additionally held back until the send
+ * buffer is full, a request that expects a response is sent, send batching
+ * is disabled again or the batch deadline of 20ms has passed. This allows to
+ * push many setters with a few send calls, for example while configuring
+ * devices after (re-)connecting, without delaying a lone setter for longer
+ * than the batch deadline. The held back requests are sent by the disconnect
+ * probe thread or the reactor, which wake up every batch deadline while send
+ * batching is enabled.
+ *
+ * Disabling send batching sends all held back requests, the result of this is
+ * returned.
+ */
+int ipcon_set_send_batching(IPConnection *ipcon, bool send_batching);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns *true* if send batching is enabled, *false* otherwise.
+ */
+bool ipcon_get_send_batching(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the number of request packets and the number of send calls that
+ * were needed to write them to the socket since the IP Connection was
+ * created. The ratio shows how well requests were coalesced.
+ */
+void ipcon_get_send_statistics(IPConnection *ipcon, uint64_t *ret_packets,
+                               uint64_t *ret_send_calls);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Enables or disables low latency completion of getter calls. If enabled a
+ * thread calling a getter first spins for a short time and then sleeps on a
+ * futex until the response arrives, instead of sleeping on a condition
+ * variable right away. The spin time adapts to the recently observed
+ * response times and is zero if responses take longer than 200 microseconds,
+ * so a slow connection doesn't waste CPU time. On single CPU systems it never
+ * spins, because that would only delay the thread receiving the response.
+ *
+ * Returns E_NOT_SUPPORTED on platforms other than Linux.
+ */
+int ipcon_set_low_latency(IPConnection *ipcon, bool low_latency);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns *true* if low latency completion is enabled, *false* otherwise.
+ */
+bool ipcon_get_low_latency(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the number of threads that currently service the sockets and
+ * disconnect probes of all IP Connections and the number of times these
+ * threads were woken up since the library was loaded.
+ */
+void ipcon_get_io_statistics(uint32_t *ret_threads, uint64_t *ret_wakeups);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the number of callbacks that are currently queued for dispatch,
+ * the highest number of queued callbacks seen so far, how often the
+ * callback ring was full so that a callback had to be stored in the
+ * (allocating) overflow list instead and how many callbacks were dropped
+ * due to the callback queue capacity. With several callback threads the
+ * values of their queues are summed up.
+ *
+ * Returns E_NOT_CONNECTED if the callback queue doesn't exist, because the
+ * IP Connection was never connected or got disconnected.
+ */
+int ipcon_get_queue_statistics(IPConnection *ipcon, uint32_t *ret_depth,
+                               uint32_t *ret_high_water, uint64_t *ret_overflows,
+                               uint64_t *ret_drops);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Limits the number of device callbacks that can be queued per callback
+ * thread to \c capacity (at most 65536). The default capacity 0 means
+ * unbounded. If a callback arrives while the queue is full the \c policy
+ * decides what happens:
+ *
+ * - IPCON_QUEUE_POLICY_BLOCK: The receive thread waits until there is
+ *   space, this pushes back on the TCP connection. Responses to getters are
+ *   not received meanwhile, so callback functions calling getters can run
+ *   into timeouts. In reactor mode this also stalls the other connections.
+ * - IPCON_QUEUE_POLICY_DROP_OLDEST: The oldest queued callback is dropped.
+ * - IPCON_QUEUE_POLICY_DROP_NEWEST: The arriving callback is dropped.
+ * - IPCON_QUEUE_POLICY_KEEP_LATEST: Like DROP_OLDEST, additionally if a newer
+ *   callback with the same UID and function ID is queued behind a callback,
+ *   then the newer value is delivered in place of the older one. So only the
+ *   latest value per callback is delivered and the callbacks keep their turn.
+ *
+ * Enumerate, connected and disconnected callbacks are never dropped or
+ * coalesced. Takes
+ * effect the next time the callback threads are started by ipcon_connect.
+ */
+void ipcon_set_callback_queue_capacity(IPConnection *ipcon, uint32_t capacity,
+                                       uint8_t policy);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the capacity and policy as set by ipcon_set_callback_queue_capacity.
+ */
+void ipcon_get_callback_queue_capacity(IPConnection *ipcon, uint32_t *ret_capacity,
+                                       uint8_t *ret_policy);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Sets the number of callback threads (1 to 16, default 1). With more than one
+ * thread the device callbacks are distributed by UID, so the callbacks of one
+ * device are still called in order, but a slow callback of one device doesn't
+ * delay the callbacks of devices handled by other threads. The connected,
+ * disconnected and enumerate callbacks are always called by the first thread.
+ *
+ * A device callback can therefore run concurrently with the enumerate
+ * callback and with the callbacks of other devices. Anything they share has
+ * to be synchronized, and a device destroyed from the enumerate callback can
+ * still be in a callback on its own thread.
+ *
+ * Takes effect the next time the callback threads are started by
+ * ipcon_connect.
+ */
+void ipcon_set_callback_workers(IPConnection *ipcon, uint8_t workers);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the number of callback threads as set by ipcon_set_callback_workers.
+ */
+uint8_t ipcon_get_callback_workers(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the time the packet of the device callback that is currently called
+ * by the calling thread was read from the socket, so it doesn't include the
+ * time the callback was queued. The monotonic time is in microseconds since an
+ * unspecified point (CLOCK_MONOTONIC on Linux, QueryPerformanceCounter on
+ * Windows), the realtime is in microseconds since the Unix epoch.
+ *
+ * Returns E_INVALID_PARAMETER if not called from a callback function of the
+ * given IP Connection.
+ */
+int ipcon_get_callback_timestamp(IPConnection *ipcon, uint64_t *ret_monotonic,
+                                 uint64_t *ret_realtime);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the number of callbacks that are currently queued for the given
+ * callback thread, the number of device callbacks it dispatched and the
+ * average and maximum latency in microseconds from receiving a callback to
+ * returning from its callback function.
+ *
+ * Returns E_NOT_CONNECTED if the callback threads don't exist and
+ * E_INVALID_PARAMETER if there is no callback thread with the given index.
+ */
+int ipcon_get_callback_worker_statistics(IPConnection *ipcon, uint8_t worker,
+                                         uint32_t *ret_depth, uint64_t *ret_dispatched,
+                                         uint32_t *ret_average_latency,
+                                         uint32_t *ret_maximum_latency);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Starts appending every packet received from and sent to the Brick Daemon to
+ * the given file, replacing its content. Each packet is stored as is, preceded
+ * by a variable length integer holding the microseconds since the previous
+ * packet and the direction. Only one capture can be active at a time.
+ *
+ * Returns E_ALREADY_CONNECTED if a capture is active already and
+ * E_CAPTURE_FILE if the file could not be opened.
+ */
+int ipcon_start_capture(IPConnection *ipcon, const char *filename);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Stops the capture started by ipcon_start_capture and closes the file.
+ *
+ * Returns E_NOT_CONNECTED if there is no active capture and E_CAPTURE_FILE if
+ * writing the file failed at any point.
+ */
+int ipcon_stop_capture(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Replays a file recorded by ipcon_start_capture in place of a connection to
+ * the Brick Daemon. The received callbacks and enumerate callbacks are
+ * dispatched like live ones, their timestamps are the time of the replay.
+ * Requests sent meanwhile are answered with the latest response to the same
+ * function of the same device in the capture, or with E_NOT_SUPPORTED if it
+ * contains none. Sent packets in the capture are not replayed.
+ *
+ * The \c speed scales the pace of the capture, 1.0 replays it in real time,
+ * 0.0 as fast as the callback threads consume it. Packets less than a
+ * millisecond apart are replayed in one go.
+ *
+ * The connected and disconnected callbacks are called at the start and the
+ * end of the replay. Blocks until all packets were replayed and all callbacks
+ * were taken by the callback threads, or until ipcon_disconnect is called.
+ * The callback threads are kept afterwards, so that their statistics can be
+ * read.
+ *
+ * Returns E_ALREADY_CONNECTED if the IP Connection is connected or replaying
+ * already and E_CAPTURE_FILE if the file could not be read or is malformed.
+ */
+int ipcon_replay(IPConnection *ipcon, const char *filename, double speed);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Enables or disables latency tracking. If enabled the IP Connection records
+ * a latency histogram per device and function ID for the time a getter or
+ * setter waits for its response (including asynchronous getters), the time a
+ * callback waits in the callback queue and the time its callback function
+ * runs. Requests that run into E_TIMEOUT are counted separately.
+ *
+ * The histograms of a device are allocated on its first recorded latency and
+ * are freed with the device. Disabling latency tracking keeps the recorded
+ * histograms.
+ *
+ * Default value is *false*.
+ */
+void ipcon_set_latency_tracking(IPConnection *ipcon, bool latency_tracking);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns *true* if latency tracking is enabled, *false* otherwise.
+ */
+bool ipcon_get_latency_tracking(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Calls \c function with a copy of every latency histogram recorded so far,
+ * together with the UID and function ID of the device and the kind of the
+ * latency (see IPCON_LATENCY_ROUND_TRIP, IPCON_LATENCY_QUEUE_WAIT and
+ * IPCON_LATENCY_EXECUTION). The copy is taken while recording continues, so
+ * its count can differ slightly from the sum of its buckets.
+ *
+ * The \c function is called from the calling thread and is allowed to call
+ * other functions of the IP Connection and its devices.
+ */
+void ipcon_get_latency_histograms(IPConnection *ipcon,
+                                  LatencyHistogramFunction function,
+                                  void *user_data);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Clears all latency histograms recorded so far.
+ */
+void ipcon_reset_latency_histograms(IPConnection *ipcon);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the highest latency in microseconds that is counted in the bucket
+ * with the given index of a LatencyHistogram.
+ */
+uint32_t ipcon_get_latency_bucket_limit(int bucket);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the latency in microseconds below or at which the given
+ * \c percentile (0.0 to 100.0) of the latencies in \c histogram are. The
+ * result is the upper limit of the bucket that contains the percentile, but
+ * never more than the maximum latency. Returns 0 for an empty histogram.
+ */
+uint32_t ipcon_get_latency_percentile(const LatencyHistogram *histogram,
+                                      double percentile);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Returns the numeric UID of a device as it is used on the wire for its
+ * Base58 encoded \c uid, e.g. to look up devices without comparing strings.
+ * UIDs of more than 32 bits are folded to 32 bits like the Brick Daemon does.
+ */
+uint32_t ipcon_uid_from_string(const char *uid);
+
+/**
+ * \ingroup IPConnection
+ *
+ * Writes the Base58 encoded string of the numeric \c uid to \c uid_str,
+ * which needs space for 8 characters. The reverse of ipcon_uid_from_string.
+ */
+void ipcon_uid_to_string(uint32_t uid, char *uid_str);
+
 /**
  * \ingroup IPConnection
  *
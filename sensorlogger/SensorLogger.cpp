@@ -19,7 +19,8 @@
 
 #include "SensorLogger.h"
 
-#include <algorithm>
+#include <chrono>
+#include <sstream>
 #include <spdlog/spdlog.h>
 
 #include <tinkerforge/BrickletTemperature.h>
@@ -30,72 +31,283 @@
 using namespace tinkerforge;
 using namespace std::placeholders;
 
-SensorLogger::SensorLogger(std::string topic, std::unique_ptr<MqttClient> mqttClient)
+namespace {
+
+// The brick daemon answers an enumeration within milliseconds, devices
+// behind a master brick can take a while longer.
+constexpr std::chrono::seconds ENUMERATION_SETTLE_TIME {2};
+
+}
+
+SensorLogger::SensorLogger(std::string topic, std::unique_ptr<MqttClient> mqttClient,
+                           const ConnectionHandler::Configuration& connectionConfig,
+                           const WindowAggregator::Configuration& aggregationConfig,
+                           bool publishSampleTime)
     : m_topic(std::move(topic))
+    , m_publishSampleTime(publishSampleTime)
     , m_mqttClient(std::move(mqttClient))
+    , m_sensorsConnection(connectionConfig)
 {
+    if (m_topic.back() != '/') { m_topic.push_back('/'); }
+
+    // The topics are built once, so publishing a value doesn't concatenate strings.
+    for (size_t kind = 0; kind < m_topics.size(); ++kind)
+    {
+        m_topics[kind].value = m_topic + sensorKindName(static_cast<SensorKind>(kind));
+        m_topics[kind].sample = m_topics[kind].value + "/sample";
+    }
+
+    if (aggregationConfig.window.count() > 0)
+    {
+        m_aggregator = std::make_unique<WindowAggregator>(aggregationConfig,
+                                                          [this](const WindowAggregator::Summary& summary) { publishSummary(summary); });
+    }
+
+    // Sensors publish as soon as they are enumerated, so everything above is
+    // set up first.
+    m_sensorsConnection.setConnectionCallback([this](bool connected) {
+        if (spdlog::get("main")) { spdlog::get("main")->info("Connection to brick daemon {}.", connected ? "established" : "lost"); }
+
+        // Devices enumerated after this might have been restarted meanwhile.
+        if (!connected) { ++m_generation; return; }
+
+        // The connection enumerates the sensors again, the ones that don't
+        // answer until it settled were removed while the connection was lost.
+        if (m_generation > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reconcileTime = std::chrono::steady_clock::now() + ENUMERATION_SETTLE_TIME;
+            m_reconcileGeneration = m_generation;
+            m_reconcile = true;
+            m_condition.notify_all();
+        }
+    });
     m_sensorsConnection.setEnumerateCallback(
                 std::bind(&SensorLogger::enumerationCallback, this, _1, _2, _3));
 
-    if (m_topic.back() != '/') { m_topic.push_back('/'); }
+    m_reconcileThread = std::thread(&SensorLogger::reconcileLoop, this);
+}
+
+SensorLogger::~SensorLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+    m_reconcileThread.join();
 }
 
 void SensorLogger::run()
 {   
     m_mqttClient->run();
-    m_sensorsConnection.joinThread();
+
+    if (m_sensorsConnection.isReplay())
+    {
+        m_sensorsConnection.replay();
+    }
+    else
+    {
+        m_sensorsConnection.joinThread();
+    }
 }
 
 void SensorLogger::enumerationCallback(const char *uid, uint16_t device_identifier, uint8_t enumeration_type)
 {
-    // Workaround for a strange character at the end of the
-    // uid, when this is compiled for 32 bit.
-    std::string s = std::string(uid);
-    if (s.length() > 3)
-    {
-        s.erase(s.end()-1);
-        uid = const_cast<char*>(s.c_str());
-    }
+    const auto enumerated = std::chrono::steady_clock::now();
+    const UID sensorUid(uid);
+    const unsigned generation = m_generation;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_sensors.find(sensorUid);
 
-    if (enumeration_type >= 2)
+    if (enumeration_type == IPCON_ENUMERATION_TYPE_DISCONNECTED)
     {
         // Remove the entry from the container
-        const auto it = std::find_if(m_sensors.begin(), m_sensors.end(),
-                                     [&uid](const std::unique_ptr<AbstractSensor>& b) { return *b == AbstractSensor::UID(uid); });
         if (it != m_sensors.end()) {
-            if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was removed.", (*it)->type()); }
+            if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was removed.", it->second.sensor->type()); }
             m_sensors.erase(it);
+            if (m_aggregator) { m_aggregator->remove(sensorUid.value()); }
         }
+        return;
     }
-    else
+
+    if (it != m_sensors.end())
     {
-        std::unique_ptr<AbstractSensor> sensor = nullptr;
+        SensorEntry& entry = it->second;
 
-        if (device_identifier == BrickletTemperature::DeviceIdentifier())
+        if (entry.deviceIdentifier == device_identifier)
         {
-            sensor = std::make_unique<BrickletTemperature>(uid, m_sensorsConnection);
+            // Every (re)connection enumerates the sensors again, often more
+            // than once. The device only needs to be set up again if it was
+            // restarted, or if that might have happened while the connection
+            // was lost.
+            if (enumeration_type == IPCON_ENUMERATION_TYPE_CONNECTED || entry.generation != generation)
+            {
+                if (spdlog::get("main")) { spdlog::get("main")->debug("Sensor '{}' is set up again.", entry.sensor->type()); }
+                entry.generation = generation;
+                entry.sensor->rearm();
+            }
+            return;
         }
-        else if (device_identifier == BrickletHumidity::DeviceIdentifier())
+
+        // Another device took over the uid.
+        if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was replaced.", entry.sensor->type()); }
+        m_sensors.erase(it);
+        if (m_aggregator) { m_aggregator->remove(sensorUid.value()); }
+    }
+
+    std::unique_ptr<AbstractSensor> sensor = createSensor(uid, device_identifier);
+
+    if (sensor)
+    {
+        if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was added.", sensor->type()); }
+
+        // Enabling the sensor only sends its requests, the first value
+        // arrives later. The entry stays in place until the sensor is
+        // removed, so the callback can refer to it.
+        SensorEntry& entry = m_sensors[sensorUid];
+        entry.sensor = std::move(sensor);
+        entry.enumerated = enumerated;
+        entry.deviceIdentifier = device_identifier;
+        entry.generation = generation;
+        entry.sensor->registerEventCallback([this, &entry](const SensorEvent& event) { publish(entry, event); });
+    }
+}
+
+void SensorLogger::reconcileLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopping)
+    {
+        if (!m_reconcile)
         {
-            sensor = std::make_unique<BrickletHumidity>(uid, m_sensorsConnection);
+            m_condition.wait(lock);
+            continue;
         }
-        else if (device_identifier == BrickletAmbientLight::DeviceIdentifier())
+
+        // Another reconnect moves the time, so the time is checked again.
+        if (std::chrono::steady_clock::now() < m_reconcileTime)
         {
-            sensor = std::make_unique<BrickletAmbientLight>(uid, m_sensorsConnection);
+            m_condition.wait_until(lock, m_reconcileTime);
+            continue;
         }
-        else if (device_identifier == BrickletDistanceIr::DeviceIdentifier())
+
+        m_reconcile = false;
+
+        // Lost again meanwhile, the next connection reconciles.
+        if (m_generation != m_reconcileGeneration) { continue; }
+
+        for (auto it = m_sensors.begin(); it != m_sensors.end();)
         {
-            sensor = std::make_unique<BrickletDistanceIr>(uid, m_sensorsConnection);
+            if (it->second.generation == m_reconcileGeneration)
+            {
+                ++it;
+                continue;
+            }
+
+            if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was not enumerated again and was removed.", it->second.sensor->type()); }
+            const uint32_t uid = it->first.value();
+            it = m_sensors.erase(it);
+            if (m_aggregator) { m_aggregator->remove(uid); }
         }
+    }
+}
 
-        if (sensor)
-        {
-            sensor->registerCallback([this](const std::string& type, int32_t value){
-                m_mqttClient->publish(m_topic+type, value, 0, true);
-            });
+std::unique_ptr<AbstractSensor> SensorLogger::createSensor(const char *uid, uint16_t device_identifier)
+{
+    if (device_identifier == BrickletTemperature::DeviceIdentifier())
+    {
+        return std::make_unique<BrickletTemperature>(uid, m_sensorsConnection);
+    }
+    else if (device_identifier == BrickletHumidity::DeviceIdentifier())
+    {
+        return std::make_unique<BrickletHumidity>(uid, m_sensorsConnection);
+    }
+    else if (device_identifier == BrickletAmbientLight::DeviceIdentifier())
+    {
+        return std::make_unique<BrickletAmbientLight>(uid, m_sensorsConnection);
+    }
+    else if (device_identifier == BrickletDistanceIr::DeviceIdentifier())
+    {
+        return std::make_unique<BrickletDistanceIr>(uid, m_sensorsConnection);
+    }
+
+    return nullptr;
+}
 
-            if (spdlog::get("main")) { spdlog::get("main")->info("Sensor '{}' was added.", sensor->type()); }
-            m_sensors.push_back(std::move(sensor));
+void SensorLogger::publish(SensorEntry& entry, const SensorEvent& event)
+{
+    if (m_aggregator)
+    {
+        m_aggregator->add(event);
+    }
+    else
+    {
+        publishValue(event);
+    }
+
+    if (!entry.published)
+    {
+        entry.published = true;
+
+        if (spdlog::get("main"))
+        {
+            spdlog::get("main")->info("Sensor '{}' reported its first value {} ms after it was enumerated.", entry.sensor->type(),
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - entry.enumerated).count());
         }
     }
 }
+
+void SensorLogger::publishValue(const SensorEvent& event)
+{
+    const Topics& topics = m_topics[static_cast<size_t>(event.kind)];
+
+    m_mqttClient->publish(topics.value, event.value, 0, true);
+
+    // The value topic keeps its plain number for existing subscribers. The
+    // sample topic carries the value together with its sample time in
+    // milliseconds since the epoch, in one message, so the two can't get
+    // out of step.
+    if (m_publishSampleTime)
+    {
+        std::ostringstream payload;
+        payload << "{\"value\":" << event.value
+                << ",\"timestamp\":" << std::chrono::duration_cast<std::chrono::milliseconds>(event.time.wallClock.time_since_epoch()).count()
+                << "}";
+
+        m_mqttClient->publish(topics.sample, payload.str(), 0, true);
+    }
+
+    if (spdlog::get("main"))
+    {
+        spdlog::get("main")->debug("Published {} value {} after {} us.", sensorKindName(event.kind), event.value,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - event.time.received).count());
+    }
+}
+
+void SensorLogger::publishSummary(const WindowAggregator::Summary& summary)
+{
+    const Topics& topics = m_topics[static_cast<size_t>(summary.kind)];
+    const std::string uid = UID(summary.uid).toString();
+
+    // One retained message per sensor and window, the values are in the
+    // units of the sensor values and the timestamp is the end of the window.
+    std::ostringstream payload;
+    payload << "{\"uid\":\"" << uid << "\""
+            << ",\"count\":" << summary.count
+            << ",\"mean\":" << summary.mean
+            << ",\"min\":" << summary.minimum
+            << ",\"max\":" << summary.maximum
+            << ",\"timestamp\":" << std::chrono::duration_cast<std::chrono::milliseconds>(summary.end.time_since_epoch()).count()
+            << "}";
+
+    m_mqttClient->publish(topics.value + "/" + uid + "/summary", payload.str(), 0, true);
+
+    if (spdlog::get("main"))
+    {
+        spdlog::get("main")->debug("Published {} summary of sensor '{}' over {} values.", sensorKindName(summary.kind), uid, summary.count);
+    }
+}
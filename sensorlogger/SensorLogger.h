@@ -20,13 +20,20 @@
 #ifndef SENSORLOGGER_H
 #define SENSORLOGGER_H
 
-#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include <tinkerforge/AbstractSensor.h>
 #include <tinkerforge/ConnectionHandler.h>
 
 #include "MqttClient.h"
+#include "WindowAggregator.h"
 
 #ifndef __cpp_lib_make_unique
 namespace std {
@@ -41,18 +48,53 @@ std::unique_ptr<T> make_unique(Args&&... args)
 class SensorLogger
 {
 public:
-    SensorLogger(std::string topic, std::unique_ptr<MqttClient> mqttClient);
+    SensorLogger(std::string topic, std::unique_ptr<MqttClient> mqttClient,
+                 const tinkerforge::ConnectionHandler::Configuration& connectionConfig = {},
+                 const WindowAggregator::Configuration& aggregationConfig = {},
+                 bool publishSampleTime = false);
+    ~SensorLogger();
 
     void run();
 
 private:
+    struct SensorEntry {
+        std::unique_ptr<tinkerforge::AbstractSensor> sensor;
+        std::chrono::steady_clock::time_point        enumerated;
+        uint16_t                                     deviceIdentifier {0};
+        unsigned                                     generation {0}; // of the connection it was last enumerated on
+        bool                                         published {false}; // the first value was published
+    };
+
     void enumerationCallback(const char *uid, uint16_t device_identifier, uint8_t enumeration_type);
+    void reconcileLoop();
+    std::unique_ptr<tinkerforge::AbstractSensor> createSensor(const char *uid, uint16_t device_identifier);
+    void publish(SensorEntry& entry, const tinkerforge::SensorEvent& event);
+    void publishValue(const tinkerforge::SensorEvent& event);
+    void publishSummary(const WindowAggregator::Summary& summary);
+
+    struct Topics {
+        std::string value;
+        std::string sample;
+    };
 
     std::string                                               m_topic;
+    std::array<Topics, tinkerforge::SENSOR_KIND_COUNT>        m_topics; // per sensor kind
+    bool                                                      m_publishSampleTime;
 
-    tinkerforge::ConnectionHandler                            m_sensorsConnection;
-    std::vector<std::unique_ptr<tinkerforge::AbstractSensor>> m_sensors;
     std::unique_ptr<MqttClient>                               m_mqttClient;
+    std::unique_ptr<WindowAggregator>                         m_aggregator; // nullptr if every value is published
+
+    tinkerforge::ConnectionHandler                            m_sensorsConnection;
+    std::unordered_map<tinkerforge::UID, SensorEntry>          m_sensors;
+    std::atomic<unsigned>                                     m_generation {0}; // counts the lost connections
+
+    std::mutex                                                m_mutex; // protects the sensors and the reconciliation below
+    std::condition_variable                                   m_condition;
+    std::chrono::steady_clock::time_point                     m_reconcileTime; // when the enumeration after a reconnect settled
+    unsigned                                                  m_reconcileGeneration {0};
+    bool                                                      m_reconcile {false}; // sensors not enumerated again are removed at m_reconcileTime
+    bool                                                      m_stopping {false};
+    std::thread                                               m_reconcileThread;
 };
 
 #endif // SENSORLOGGER_H
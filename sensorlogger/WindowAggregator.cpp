@@ -0,0 +1,152 @@
+/*
+ * Tinkerforge Sensorlogger - Logging Tinkerforge sensor values via MQTT
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WindowAggregator.h"
+
+#include <algorithm>
+
+using namespace tinkerforge;
+
+WindowAggregator::WindowAggregator(const Configuration& configuration, SummaryCallback callback)
+    : m_step(configuration.step.count() > 0 ? std::min(configuration.step, configuration.window) : configuration.window)
+    , m_bucketCount(std::max<size_t>(1, static_cast<size_t>((configuration.window + m_step - std::chrono::milliseconds(1)) / m_step)))
+    , m_callback(std::move(callback))
+{
+    m_thread = std::thread(&WindowAggregator::run, this);
+}
+
+WindowAggregator::~WindowAggregator()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void WindowAggregator::add(const SensorEvent& event)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_series.find(event.uid);
+    if (it == m_series.end())
+    {
+        it = m_series.emplace(event.uid, Series{event.kind, std::vector<Bucket>(m_bucketCount), 0, event.value, event.time.received}).first;
+    }
+
+    Series& series = it->second;
+
+    // The previous value held until this one was sampled. A value read on
+    // another thread can arrive after a newer one, it doesn't replace that.
+    if (event.time.received >= series.since)
+    {
+        hold(series, event.time.received);
+        series.value = event.value;
+    }
+
+    Bucket& bucket = series.buckets[series.current];
+
+    if (!bucket.used)
+    {
+        bucket.minimum = event.value;
+        bucket.maximum = event.value;
+        bucket.used = true;
+    }
+    else
+    {
+        bucket.minimum = std::min(bucket.minimum, event.value);
+        bucket.maximum = std::max(bucket.maximum, event.value);
+    }
+
+    ++bucket.count;
+}
+
+void WindowAggregator::remove(uint32_t uid)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_series.erase(uid);
+}
+
+void WindowAggregator::hold(Series& series, std::chrono::steady_clock::time_point until)
+{
+    if (until <= series.since) { return; }
+
+    Bucket& bucket = series.buckets[series.current];
+    const double seconds = std::chrono::duration<double>(until - series.since).count();
+
+    bucket.weightedSum += series.value * seconds;
+    bucket.seconds += seconds;
+    series.since = until;
+}
+
+void WindowAggregator::run()
+{
+    auto next = std::chrono::steady_clock::now() + m_step;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_condition.wait_until(lock, next, [this] { return m_stopping; }))
+    {
+        next += m_step;
+        summarize(std::chrono::steady_clock::now(), std::chrono::system_clock::now());
+
+        // The summaries are published without blocking the sensors.
+        lock.unlock();
+        for (const Summary& summary : m_summaries) { m_callback(summary); }
+        lock.lock();
+    }
+}
+
+void WindowAggregator::summarize(std::chrono::steady_clock::time_point end, std::chrono::system_clock::time_point wallEnd)
+{
+    m_summaries.clear();
+
+    for (auto& entry : m_series)
+    {
+        Series& series = entry.second;
+        Summary summary {series.kind, entry.first, 0, series.value, series.value, 0.0, wallEnd};
+        double weightedSum = 0.0;
+        double seconds = 0.0;
+
+        hold(series, end);
+
+        // Every series has a value, at least the current bucket is used.
+        for (const Bucket& bucket : series.buckets)
+        {
+            if (!bucket.used) { continue; }
+
+            summary.minimum = std::min(summary.minimum, bucket.minimum);
+            summary.maximum = std::max(summary.maximum, bucket.maximum);
+            summary.count += bucket.count;
+            weightedSum += bucket.weightedSum;
+            seconds += bucket.seconds;
+        }
+
+        summary.mean = seconds > 0.0 ? weightedSum / seconds : series.value;
+        m_summaries.push_back(summary);
+
+        // The oldest step leaves the window, the last value carries over
+        // into the new one.
+        series.current = (series.current + 1) % series.buckets.size();
+        series.buckets[series.current] = Bucket{0, 0.0, 0.0, series.value, series.value, true};
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * Tinkerforge Sensorlogger - Logging Tinkerforge sensor values via MQTT
+ * Copyright (C) 2018 Adrian Winterstein
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef WINDOWAGGREGATOR_H
+#define WINDOWAGGREGATOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <tinkerforge/SensorEvent.h>
+
+// Summarizes the values of every sensor over windows of a fixed length and
+// emits one summary per sensor and step instead of every single value.
+// Tumbling windows are as long as the step, sliding windows are a multiple
+// of it. A sensor keeps one bucket per step of the window, so its memory is
+// bounded no matter how many values it reports.
+//
+// Sensors only report changed values, so a value holds until the next one:
+// the mean is weighted by how long each value held, and a window without
+// new values is summarized with the last value carried forward.
+class WindowAggregator
+{
+public:
+    struct Configuration {
+        std::chrono::milliseconds window {0}; // length of the summarized window, 0 to publish every value, rounded up to a multiple of the step
+        std::chrono::milliseconds step   {0}; // between two summaries, 0 for tumbling windows
+    };
+
+    struct Summary {
+        tinkerforge::SensorKind               kind;
+        uint32_t                              uid;
+        uint32_t                              count; // of values reported in the window, 0 if the last one held
+        int32_t                               minimum;
+        int32_t                               maximum;
+        double                                mean; // weighted by how long each value held
+        std::chrono::system_clock::time_point end; // of the window
+    };
+
+    using SummaryCallback = std::function<void(const Summary& summary)>;
+
+    // the callback is called from the thread of the aggregator
+    WindowAggregator(const Configuration& configuration, SummaryCallback callback);
+    ~WindowAggregator();
+
+    WindowAggregator(const WindowAggregator&) = delete;
+    WindowAggregator& operator=(const WindowAggregator&) = delete;
+
+    void add(const tinkerforge::SensorEvent& event);
+    void remove(uint32_t uid);
+
+private:
+    struct Bucket {
+        uint32_t count {0};
+        double   weightedSum {0.0}; // of the values times the seconds they held
+        double   seconds {0.0};     // covered by values
+        int32_t  minimum {0};
+        int32_t  maximum {0};
+        bool     used {false};      // minimum and maximum are valid
+    };
+
+    struct Series {
+        tinkerforge::SensorKind               kind;
+        std::vector<Bucket>                   buckets; // one per step, a ring ending at current
+        size_t                                current {0};
+        int32_t                               value;   // the last one, it holds until the next
+        std::chrono::steady_clock::time_point since;   // the value is accounted for until then
+    };
+
+    static void hold(Series& series, std::chrono::steady_clock::time_point until);
+
+    void run();
+    void summarize(std::chrono::steady_clock::time_point end, std::chrono::system_clock::time_point wallEnd);
+
+    const std::chrono::milliseconds      m_step;
+    const size_t                         m_bucketCount;
+    SummaryCallback                      m_callback;
+
+    std::mutex                           m_mutex; // protects the series and m_stopping
+    std::condition_variable              m_condition;
+    std::unordered_map<uint32_t, Series> m_series;
+    bool                                 m_stopping {false};
+
+    std::vector<Summary>                 m_summaries; // of the current step, only used by the thread
+    std::thread                          m_thread;
+};
+
+#endif // WINDOWAGGREGATOR_H
@@ -42,6 +42,33 @@ bool checkParameters(const MqttClient::Configuration& config, std::string& error
     return true;
 }
 
+bool parseQueuePolicy(const std::string& name, uint8_t& policy, std::string& errorMessage)
+{
+    if (name == "block")
+    {
+        policy = IPCON_QUEUE_POLICY_BLOCK;
+    }
+    else if (name == "drop-oldest")
+    {
+        policy = IPCON_QUEUE_POLICY_DROP_OLDEST;
+    }
+    else if (name == "drop-newest")
+    {
+        policy = IPCON_QUEUE_POLICY_DROP_NEWEST;
+    }
+    else if (name == "keep-latest")
+    {
+        policy = IPCON_QUEUE_POLICY_KEEP_LATEST;
+    }
+    else
+    {
+        errorMessage = "unknown queue policy '" + name + "'";
+        return false;
+    }
+
+    return true;
+}
+
 bool checkTopic(const std::string& topic, std::string& errorMessage)
 {
     if (topic.empty())
@@ -53,6 +80,17 @@ bool checkTopic(const std::string& topic, std::string& errorMessage)
     return true;
 }
 
+bool checkAggregation(unsigned window, unsigned step, std::string& errorMessage)
+{
+    if (step > 0 && window % step != 0)
+    {
+        errorMessage = "aggregation window is not a multiple of the step";
+        return false;
+    }
+
+    return true;
+}
+
 inline std::shared_ptr<spdlog::logger> createLogger(const std::string& logger_name, bool stdout)
 {
     if (stdout)
@@ -69,6 +107,13 @@ int main(int argc, char** argv)
 {
     MqttClient::Configuration mqttConfig;
     std::string mqttTopic;
+    std::string queuePolicy {"block"};
+    unsigned latencyReport {0};
+    unsigned aggregationWindow {0};
+    unsigned aggregationStep {0};
+    bool sampleTime {false};
+    tinkerforge::ConnectionHandler::Configuration connectionConfig;
+    connectionConfig.asyncConnect = true;
 
     // Declare the supported command line options.
     po::options_description desc("Command line options");
@@ -81,6 +126,20 @@ int main(int argc, char** argv)
         ("topic,t", po::value<std::string>(&mqttTopic), "MQTT topic")
         ("user,u", po::value<std::string>(&mqttConfig.user), "MQTT user name")
         ("password,P", po::value<std::string>(&mqttConfig.password), "MQTT password")
+        ("reactor,r", po::bool_switch(&connectionConfig.reactor), "Service the brick daemon connection by the shared event loop")
+        ("send-batching", po::bool_switch(&connectionConfig.sendBatching), "Hold back threshold updates for up to 20 ms to send them with fewer system calls")
+        ("workers,w", po::value<unsigned>(&connectionConfig.callbackWorkers), "Number of threads dispatching sensor callbacks")
+        ("queue-capacity", po::value<uint32_t>(&connectionConfig.queueCapacity), "Maximum number of queued sensor callbacks per thread (0 for unbounded, default)")
+        ("queue-policy", po::value<std::string>(&queuePolicy), "What to do with sensor callbacks if the queue is full: block (default), drop-oldest, drop-newest or keep-latest")
+        ("capture", po::value<std::string>(&connectionConfig.captureFile), "Record the brick daemon traffic to this file")
+        ("replay", po::value<std::string>(&connectionConfig.replayFile), "Replay a recorded file instead of connecting to the brick daemon, exits afterwards")
+        ("replay-speed", po::value<double>(&connectionConfig.replaySpeed), "Pace of the replay, 0 for as fast as possible (default 1)")
+        ("latency-report", po::value<unsigned>(&latencyReport), "Log the sensor functions with the highest latencies and the send calls per request every this many seconds, or at the end of a replay (0 disables latency tracking, default)")
+        ("confirm-thresholds", po::bool_switch(&connectionConfig.confirmThresholds), "Wait for the sensors to confirm their re-armed value thresholds and retry on timeouts")
+        ("adaptive-deadband", po::value<double>(&connectionConfig.adaptiveDeadband), "Learn the noise of every sensor and report values beyond this multiple of its standard deviation instead of the fixed tolerances (0 disables, default)")
+        ("sample-time", po::bool_switch(&sampleTime), "Also publish every value with its sample time as JSON on <topic>/<type>/sample")
+        ("aggregate-window", po::value<unsigned>(&aggregationWindow), "Publish the count, time weighted mean, minimum and maximum of the values of every sensor over windows of this many seconds to <topic>/<type>/<uid>/summary instead of every value, also for windows without new values (0 disables, default)")
+        ("aggregate-step", po::value<unsigned>(&aggregationStep), "Seconds between two published windows, a divisor of the window for sliding windows (default the window, tumbling)")
     ;
 
     po::variables_map vm;
@@ -93,7 +152,9 @@ int main(int argc, char** argv)
     }
 
     std::string errorMessage;
-    if (!checkParameters(mqttConfig, errorMessage) || !checkTopic(mqttTopic, errorMessage))
+    if (!checkParameters(mqttConfig, errorMessage) || !checkTopic(mqttTopic, errorMessage) ||
+        !parseQueuePolicy(queuePolicy, connectionConfig.queuePolicy, errorMessage) ||
+        !checkAggregation(aggregationWindow, aggregationStep, errorMessage))
     {
         std::cout << "Wrong command line parameters used (" << errorMessage << ").\n" << std::endl;
         std::cout << desc << std::endl;
@@ -101,10 +162,16 @@ int main(int argc, char** argv)
     }
 
 
+    connectionConfig.latencyReportInterval = std::chrono::seconds(latencyReport);
+
+    WindowAggregator::Configuration aggregationConfig;
+    aggregationConfig.window = std::chrono::seconds(aggregationWindow);
+    aggregationConfig.step = std::chrono::seconds(aggregationStep);
+
     createLogger("main", !vm.count("quiet"));
     createLogger("mqtt", !vm.count("quiet"));
 
     auto mqttClient = std::make_unique<MqttClient>(mqttConfig);
-    SensorLogger(mqttTopic, std::move(mqttClient)).run();
+    SensorLogger(mqttTopic, std::move(mqttClient), connectionConfig, aggregationConfig, sampleTime).run();
     return 0;
 }